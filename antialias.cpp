@@ -0,0 +1,152 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "antialias.h"
+#include "coverage.h"
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+InkCoverage::InkCoverage(SDL_PixelFormat *fmt,int w,int h)
+{
+ format=fmt;
+ width=w;
+ height=h;
+ cov.assign(size_t(w)*size_t(h),0);
+}
+
+void InkCoverage::Clear(void)
+{
+ std::fill(cov.begin(),cov.end(),0);
+}
+
+void InkCoverage::Scroll(SDL_Rect r,int dx,int dy)
+{
+ ScrollCoverage(&cov[0],width,height,r,dx,dy);
+}
+
+void InkCoverage::Line(SDL_Surface *ink,const unsigned char *vback,int xa,int ya,int xb,int yb,int size,int offset,Uint32 color)
+{
+ int bpp=format->BytesPerPixel;
+ // The bytes of the color, as they are in the surface
+ Uint8 bytes[4];
+ memcpy(bytes,&color,4);
+ if ((bpp==3) && (SDL_BYTEORDER==SDL_BIG_ENDIAN))
+  memcpy(bytes,(Uint8 *)&color+1,3);
+
+ // The line is centered where the square brush of the pen would be, and pixels are sampled at their centers
+ double r=size/2.0;
+ double ax=xa-offset+r,ay=ya-offset+r;
+ double bx=xb-offset+r,by=yb-offset+r;
+ double vx=bx-ax,vy=by-ay;
+ double len2=vx*vx+vy*vy;
+ int x1=std::max(int(floor(std::min(ax,bx)-r-1.0)),0);
+ int y1=std::max(int(floor(std::min(ay,by)-r-1.0)),0);
+ int x2=std::min(int(ceil(std::max(ax,bx)+r+1.0)),std::min(width,ink->w));
+ int y2=std::min(int(ceil(std::max(ay,by)+r+1.0)),std::min(height,ink->h));
+
+ SDL_LockSurface(ink);
+ for (int y=y1;y<y2;y++)
+ {
+  Uint8 *p=(Uint8 *)ink->pixels+y*ink->pitch+x1*bpp;
+  Uint8 *m=&cov[size_t(y)*size_t(width)];
+  for (int x=x1;x<x2;x++,p+=bpp)
+  {
+   double px=x+0.5-ax,py=y+0.5-ay;
+   double t=(len2>0.0) ? std::min(std::max((px*vx+py*vy)/len2,0.0),1.0) : 0.0;
+   double dx=px-t*vx,dy=py-t*vy;
+   double a=r+0.5-sqrt(dx*dx+dy*dy);
+   if (a<=0.0)
+    continue;
+   Uint8 c=(a>=1.0) ? 255 : Uint8(a*255.0+0.5);
+   // A pixel that is background (never traced, or erased) takes any coverage
+   if ((c>m[x]) || (memcmp(p,vback,bpp)==0))
+   {
+    m[x]=c;
+    memcpy(p,bytes,bpp);
+   }
+  }
+ }
+ SDL_UnlockSurface(ink);
+}
+
+void InkCoverage::Compose(SDL_Surface *dst,SDL_Surface *ink,const unsigned char *vback,SDL_Rect r)
+{
+ int x1=std::max(int(r.x),0);
+ int y1=std::max(int(r.y),0);
+ int x2=std::min(std::min(int(r.x)+int(r.w),width),std::min(dst->w,ink->w));
+ int y2=std::min(std::min(int(r.y)+int(r.h),height),std::min(dst->h,ink->h));
+ if ((x2<=x1) || (y2<=y1))
+  return;
+ int bpp=format->BytesPerPixel;
+ SDL_LockSurface(dst);
+ SDL_LockSurface(ink);
+ for (int y=y1;y<y2;y++)
+ {
+  const Uint8 *p=(const Uint8 *)ink->pixels+y*ink->pitch+x1*bpp;
+  Uint8 *q=(Uint8 *)dst->pixels+y*dst->pitch+x1*bpp;
+  const Uint8 *m=&cov[size_t(y)*size_t(width)];
+  for (int x=x1;x<x2;x++,p+=bpp,q+=bpp)
+  {
+   if (memcmp(p,vback,bpp)==0)
+    continue;
+   Uint32 a=m[x];
+   if ((a==0) || (a==255))
+    memcpy(q,p,bpp);
+   else
+    Blend(q,p,a);
+  }
+ }
+ SDL_UnlockSurface(ink);
+ SDL_UnlockSurface(dst);
+}
+
+void InkCoverage::Blend(Uint8 *d,const Uint8 *p,Uint32 a)
+{
+ const SDL_PixelFormat *f=format;
+ switch (f->BytesPerPixel)
+ {
+  case 4:
+  case 3:
+        // Each component is a byte
+        for (int k=0;k<f->BytesPerPixel;k++)
+         d[k]=Div255(d[k]*(255-a)+p[k]*a);
+        break;
+  case 2:
+        {
+         Uint16 s,i;
+         memcpy(&s,d,2);
+         memcpy(&i,p,2);
+         Uint32 rs=((s & f->Rmask)>>f->Rshift)<<f->Rloss,ri=((i & f->Rmask)>>f->Rshift)<<f->Rloss;
+         Uint32 gs=((s & f->Gmask)>>f->Gshift)<<f->Gloss,gi=((i & f->Gmask)>>f->Gshift)<<f->Gloss;
+         Uint32 bs=((s & f->Bmask)>>f->Bshift)<<f->Bloss,bi=((i & f->Bmask)>>f->Bshift)<<f->Bloss;
+         s=Uint16(((Div255(rs*(255-a)+ri*a)>>f->Rloss)<<f->Rshift) | ((Div255(gs*(255-a)+gi*a)>>f->Gloss)<<f->Gshift) |
+                  ((Div255(bs*(255-a)+bi*a)>>f->Bloss)<<f->Bshift));
+         memcpy(d,&s,2);
+        }
+        break;
+  default:
+        {
+         Uint8 rs,gs,bs,ri,gi,bi;
+         SDL_GetRGB(*d,format,&rs,&gs,&bs);
+         SDL_GetRGB(*p,format,&ri,&gi,&bi);
+         *d=Uint8(SDL_MapRGB(format,Div255(rs*(255-a)+ri*a),Div255(gs*(255-a)+gi*a),Div255(bs*(255-a)+bi*a)));
+        }
+        break;
+ }
+}
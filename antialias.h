@@ -0,0 +1,103 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef ANTIALIAS_H
+#define ANTIALIAS_H
+
+#include <vector>
+#include <SDL/SDL.h>
+
+/*! \brief Class to draw the lines of the pen with antialiasing, keeping how much of each pixel they cover
+ *
+ * The buffer of traces keeps the color of the ink of each pixel, and this class keeps, beside it, the part of the pixel
+ * covered by the ink (from 0 to 255). Lines are drawn as the area swept by a disc of the size of the brush along the segment,
+ * and each pixel takes the coverage of its center, softened over one pixel. Where two lines overlap, the largest coverage is kept,
+ * so joints and crossings do not become darker. Pixels with full coverage (the inside of the lines), or traced by other means
+ * (like the eraser, or a session stored as pixels), are copied over the slide as usual; the others are blended with it.
+ *
+ * Blending needs the slide as it is without traces, so the canvas must blend over a clean copy of the slide, not over
+ * pixels already blended.
+*/
+class InkCoverage
+{
+ public:
+    /**
+     * Constructor. Nothing is covered at first.
+     * \param fmt The pixel format of the canvas and of the buffer of traces
+     * \param w Width of the canvas
+     * \param h Height of the canvas
+     */
+    InkCoverage(SDL_PixelFormat *fmt,int w,int h);
+
+    /**
+     * Removes all the coverage, as when the traces are erased
+     */
+    void Clear(void);
+
+    /**
+     * Draws an antialiased line in the buffer of traces. Only the pixels whose coverage grows take the color of the line.
+     * \param ink The buffer of traces
+     * \param vback The bytes of a background pixel of the buffer
+     * \param xa Value of coordinate x of the start of the line
+     * \param ya Value of coordinate y of the start of the line
+     * \param xb Value of coordinate x of the end of the line
+     * \param yb Value of coordinate y of the end of the line
+     * \param size Width of the line, in pixels
+     * \param offset Distance from each point to the upper-left corner of the (square) brush of the pen, to center the line as it
+     * \param color The color of the line (a pixel value of the format of the buffer)
+     */
+    void Line(SDL_Surface *ink,const unsigned char *vback,int xa,int ya,int xb,int yb,int size,int offset,Uint32 color);
+
+    /**
+     * Puts the traces over the slide, blending the partially covered pixels
+     * \param dst The surface with the slide (the canvas), which receives the result
+     * \param ink The buffer of traces
+     * \param vback The bytes of a background pixel of the buffer
+     * \param r The area to compose, which is clipped to the surfaces
+     */
+    void Compose(SDL_Surface *dst,SDL_Surface *ink,const unsigned char *vback,SDL_Rect r);
+
+    /**
+     * Moves the coverage of an area, as the traces are moved when the board is panned. Pixels that enter the area are not covered
+     * (so their traces, if any, are copied as they are).
+     * \param r The area
+     * \param dx Pixels to the right (negative to the left)
+     * \param dy Pixels down (negative up)
+     */
+    void Scroll(SDL_Rect r,int dx,int dy);
+
+    /**
+     * Gets the coverage of the pixels, to keep it and to put it back when the board is panned
+     * \return The coverage of each pixel of the canvas, row by row
+     */
+    Uint8 *GetCoverage(void) { return &cov[0]; };
+
+    /**
+     * Gets the memory used by the coverage of the pixels
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void) { return cov.capacity(); };
+
+ private:
+    void Blend(Uint8 *d,const Uint8 *p,Uint32 a);
+
+    SDL_PixelFormat *format;
+    int width,height;
+    std::vector<Uint8> cov;
+};
+
+#endif
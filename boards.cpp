@@ -0,0 +1,145 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "boards.h"
+
+BoardStack::BoardStack(SessionStore &s) : ses(s)
+{
+ active=false;
+ current=0;
+ boards.resize(1);
+ tiles.resize(1,nullptr);
+ slide_changed=false;
+}
+
+BoardStack::~BoardStack()
+{
+ for (size_t i=0;i<tiles.size();i++)
+  delete tiles[i];
+}
+
+void BoardStack::Attach(Canvas &cnv)
+{
+ if (tiles[current]==nullptr)
+  tiles[current]=new TileBoard(cnv.GetInk()->format);
+ tiles[current]->Unpack(ses);
+ cnv.SetTileBoard(tiles[current]);
+}
+
+void BoardStack::Detach(Canvas &cnv)
+{
+ // What is out of the view is kept compressed too, as the traces of the board
+ ses.Pack(cnv,boards[current]);
+ tiles[current]->Pack(ses,cnv.GetInkBackground());
+}
+
+void BoardStack::Open(Canvas &cnv)
+{
+ if (active)
+  return;
+ slide_changed=cnv.GetInkChanged();
+ ses.Pack(cnv,slide_ink);
+ Attach(cnv);
+ ses.Unpack(boards[current],cnv);
+ active=true;
+}
+
+void BoardStack::Close(Canvas &cnv)
+{
+ if (!active)
+  return;
+ Detach(cnv);
+ // The slides cannot be panned
+ cnv.SetTileBoard(nullptr);
+ ses.Unpack(slide_ink,cnv);
+ std::vector<unsigned char>().swap(slide_ink);
+ // Traces drawn on the boards are not changes of the slide
+ cnv.SetInkChanged(slide_changed);
+ active=false;
+}
+
+void BoardStack::KeepSlide(int page)
+{
+ if (!active || !slide_changed)
+  return;
+ ses.KeepPacked(page,slide_ink);
+ slide_changed=false;
+}
+
+void BoardStack::RestoreSlide(int page)
+{
+ if (active && ses.GetPacked(page,slide_ink))
+  slide_changed=false;
+}
+
+bool BoardStack::Go(int b,Canvas &cnv)
+{
+ b=std::min(std::max(b,0),int(boards.size())-1);
+ if (b==current)
+  return false;
+ Detach(cnv);
+ current=b;
+ Attach(cnv);
+ ses.Unpack(boards[current],cnv);
+ // The traces are kept compressed only while they are not shown
+ std::vector<unsigned char>().swap(boards[current]);
+ return true;
+}
+
+bool BoardStack::ExecuteCommand(Config::Commands command,Canvas &cnv)
+{
+ if (!active)
+  return false;
+ switch (command)
+ {
+  case Config::Next:
+        // A new board is opened after the last one, unless it is empty
+        if ((current==int(boards.size())-1) && (int(boards.size())<MaxBoards))
+        {
+         std::vector<unsigned char> ink;
+         ses.Pack(cnv,ink);
+         if (ink.empty() && tiles[current]->Empty())
+          return false;
+         boards.resize(boards.size()+1);
+         tiles.resize(boards.size(),nullptr);
+        }
+        return Go(current+1,cnv);
+  case Config::Previous:
+        return Go(current-1,cnv);
+  case Config::FastForward:
+        return Go(current+FastJump,cnv);
+  case Config::FastBackwards:
+        return Go(current-FastJump,cnv);
+  case Config::ToFirstSlide:
+        return Go(0,cnv);
+  case Config::ToLastSlide:
+        return Go(int(boards.size())-1,cnv);
+  default:
+        return false;
+ }
+}
+
+Uint64 BoardStack::MemoryUse(void)
+{
+ Uint64 m=slide_ink.capacity();
+ for (size_t i=0;i<boards.size();i++)
+  m+=boards[i].capacity();
+ for (size_t i=0;i<tiles.size();i++)
+  if (tiles[i]!=nullptr)
+   m+=tiles[i]->MemoryUse();
+ return m;
+}
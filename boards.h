@@ -0,0 +1,136 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef BOARDS_H
+#define BOARDS_H
+
+#include "session.h"
+
+/*! \brief Class to keep a stack of blank blackboards, besides the slides
+ *
+ * Without a PDF file, the navigation keys go through the blank boards instead of through the slides: going forward from the
+ * last one opens a new one (unless the last one is still empty). With a PDF file, the boards are opened and closed with a key,
+ * and the traces of the slide are kept meanwhile.
+ *
+ * Only the board being shown is in the canvas. The others are kept compressed in memory, encoded as the session store does
+ * (strokes, or runs of traced pixels, since boards are mostly background), so many boards cost little memory and going from
+ * one to another is a decoding of its traces only.
+ *
+ * Each board is larger than the screen: it can be panned, and what is out of the view is kept in its TileBoard, which is created
+ * when the board is first shown and only has tiles where there are traces. The tiles of the boards that are not shown are packed
+ * as runs too.
+*/
+class BoardStack
+{
+ public:
+    /**
+     * Maximum number of boards
+     */
+    static const int MaxBoards = 100;
+
+    /**
+     * Number of boards that are skipped by the fast forward and fast backwards commands
+     */
+    static const int FastJump = 10;
+
+    /**
+     * Constructor. There is one empty board, which is not shown.
+     * \param s The session store, which encodes and decodes the traces
+     */
+    BoardStack(SessionStore &s);
+
+    /**
+     * Destructor. It frees the tiles of the boards.
+     */
+    ~BoardStack();
+
+    /**
+     * Tells if the boards are being shown instead of the slides
+     * \return true if they are shown
+     */
+    bool Active(void) { return active; };
+
+    /**
+     * Shows the boards, keeping the traces of the slide. The canvas gets those of the current board (it must be redrawn).
+     * \param cnv The canvas
+     */
+    void Open(Canvas &cnv);
+
+    /**
+     * Goes back to the slide, keeping the traces of the current board. The canvas gets those of the slide (it must be redrawn).
+     * \param cnv The canvas
+     */
+    void Close(Canvas &cnv);
+
+    /**
+     * Keeps in the session store the traces of the slide, which are in the stack while the boards are shown, if they have changed
+     * (as SessionStore::Keep does with the canvas, before the document is reloaded)
+     * \param page The slide to which they belong
+     */
+    void KeepSlide(int page);
+
+    /**
+     * Takes from the session store the traces of another slide, which the canvas gets when the boards are closed (when a reload
+     * changes the current slide while the boards are shown)
+     * \param page The slide whose traces are wanted
+     */
+    void RestoreSlide(int page);
+
+    /**
+     * Executes a navigation command on the boards
+     * \param command One of Next, Previous, FastForward, FastBackwards, ToFirstSlide or ToLastSlide
+     * \param cnv The canvas
+     * \return true if the current board has changed (so the canvas must be redrawn), false otherwise
+     */
+    bool ExecuteCommand(Config::Commands command,Canvas &cnv);
+
+    /**
+     * Gets the current board
+     * \return Its number, from 0
+     */
+    int GetCurrent(void) { return current; };
+
+    /**
+     * Gets the number of boards
+     * \return Number of boards, counting the current one
+     */
+    int GetCount(void) { return int(boards.size()); };
+
+    /**
+     * Gets the memory used by the boards that are not shown, by the tiles of all of them, and by the traces of the slide while the boards are shown
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void);
+
+ private:
+    bool Go(int b,Canvas &cnv);
+    void Attach(Canvas &cnv);
+    void Detach(Canvas &cnv);
+
+    SessionStore &ses;
+    bool active;
+    int current;
+    std::vector< std::vector<unsigned char> > boards;
+    // What is out of the view of each board (nullptr until it is shown)
+    std::vector<TileBoard *> tiles;
+
+    // The traces of the slide while the boards are shown, and if they had changed for the session store
+    std::vector<unsigned char> slide_ink;
+    bool slide_changed;
+};
+
+#endif
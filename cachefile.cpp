@@ -0,0 +1,79 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "cachefile.h"
+
+#include <iostream>
+#include <cstdio>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+bool CacheFile::Map(const std::string &fn,size_t min_len,unsigned char *&data,size_t &len)
+{
+ int fd=open(fn.c_str(),O_RDONLY);
+ if (fd<0)
+  return false;
+ struct stat st;
+ if ((fstat(fd,&st)!=0) || (size_t(st.st_size)<min_len))
+ {
+  close(fd);
+  return false;
+ }
+ void *m=mmap(nullptr,size_t(st.st_size),PROT_READ,MAP_PRIVATE,fd,0);
+ close(fd);
+ if (m==MAP_FAILED)
+  return false;
+ data=(unsigned char *)m;
+ len=size_t(st.st_size);
+ return true;
+}
+
+void CacheFile::Unmap(unsigned char *data,size_t len)
+{
+ if (data!=nullptr)
+  munmap(data,len);
+}
+
+bool CacheFile::Write(const std::string &dir,const std::string &fn,const char *what,const char *lost,std::function<void(std::ofstream &)> write)
+{
+ if ((mkdir(dir.c_str(),0700)!=0) && (errno!=EEXIST))
+ {
+  std::cerr << "Warning: cannot create directory " << dir << ". " << lost << " not saved.\n";
+  return false;
+ }
+
+ // The new file is written aside and then renamed, so that a failure when writing never destroys the former one.
+ std::string tmpname=fn+".tmp";
+ std::ofstream f(tmpname.c_str(),std::ios::binary);
+ if (!f.is_open())
+ {
+  std::cerr << "Warning: cannot write " << what << " " << tmpname << ". " << lost << " not saved.\n";
+  return false;
+ }
+ write(f);
+ f.close();
+ if (f.fail() || (rename(tmpname.c_str(),fn.c_str())!=0))
+ {
+  std::cerr << "Warning: error writing " << what << " " << fn << ". " << lost << " not saved.\n";
+  unlink(tmpname.c_str());
+  return false;
+ }
+ return true;
+}
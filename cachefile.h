@@ -0,0 +1,64 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef CACHEFILE_H
+#define CACHEFILE_H
+
+#include <string>
+#include <fstream>
+#include <functional>
+
+/*! \brief Functions to read and write the files of the cache directory (sessions, thumbnails and rendering times)
+ *
+ * The files are memory-mapped to be read, so that nothing is read until it is used. They are written whole: the new
+ * content goes to a file aside, which is renamed over the former one only when it has been written completely, so that
+ * a failure while writing never destroys what was stored in an earlier execution.
+*/
+class CacheFile
+{
+ public:
+    /**
+     * Maps a file to read it
+     * \param fn Name of the file
+     * \param min_len Minimum length of the file (that of its header)
+     * \param data Returns the first byte of the mapped file
+     * \param len Returns the length of the file
+     * \return false if the file does not exist, is shorter than min_len or cannot be mapped (data and len are not changed then)
+     */
+    static bool Map(const std::string &fn,size_t min_len,unsigned char *&data,size_t &len);
+
+    /**
+     * Unmaps a file mapped by Map
+     * \param data The first byte of the mapped file, or nullptr if no file is mapped
+     * \param len The length of the file
+     */
+    static void Unmap(unsigned char *data,size_t len);
+
+    /**
+     * Writes a file of the cache directory, creating the directory if it does not exist. If anything fails, a warning is written
+     * and the former file, if any, is kept.
+     * \param dir The cache directory
+     * \param fn Name of the file
+     * \param what What the file is, for the warnings (for instance, "session file")
+     * \param lost What is lost if the file is not written, for the warnings (for instance, "Session")
+     * \param write The function that writes the content on the stream it is given
+     * \return true if the file has been written
+     */
+    static bool Write(const std::string &dir,const std::string &fn,const char *what,const char *lost,std::function<void(std::ofstream &)> write);
+};
+
+#endif
@@ -16,61 +16,22 @@
  *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
  ***************************************************************************/
 #include "canvas.h"
+#include "linewalk.h"
 
 //using namespace std;
 
 Canvas::Canvas(Config &cfg)
 { 
  last_saved=0;
- if (SDL_Init(SDL_INIT_VIDEO)<0)
- {
-  std::cerr << "Error initializing SDL.\n";
-  exit(1);
- }
- const SDL_VideoInfo *inf=SDL_GetVideoInfo();
- 
- int flags=SDL_SWSURFACE;
- if (!cfg.GetInWin())
- {
-  flags|=SDL_FULLSCREEN;
-  scw=inf->current_w;
-  sch=inf->current_h;
-  cfg.SetRes(scw,sch);
- }
- else
- {
-  scw=cfg.GetXres();
-  sch=cfg.GetYres();
-  //window=SDL_CreateWindow("VBB",SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, scw, sch, SDL_WINDOW_RESIZABLE);  
- }
+ // The presenter initializes SDL and gives the surface where everything is drawn: a window, the full screen or just memory
+ presenter=Presenter::Create(cfg);
+ c=presenter->GetSurface();
+ scw=c->w;
+ sch=c->h;
  menu_height=cfg.GetMenuHeight();
 
- if ((c=SDL_SetVideoMode(scw,sch,inf->vfmt->BitsPerPixel,flags))==nullptr)
- {
-  std::cerr << "Error creating main SDL surface. Exiting.\n";
-  SDL_Quit();
-  exit(1);
- }
-
- // This code is just to set the window name, so that external programs can locate it for sending events, share it, etc. 
- SDL_SysWMinfo myinfo;
- SDL_VERSION(&myinfo.version);
- if (SDL_GetWMInfo(&myinfo))
- {
-  if (cfg.GetInWin())
-   XStoreName(myinfo.info.x11.display,myinfo.info.x11.wmwindow,"VirtualBlackboard");
-  else
-   XStoreName(myinfo.info.x11.display,myinfo.info.x11.fswindow,"VirtualBlackboard");
- 
- }
-
- if ((buf=SDL_CreateRGBSurface(SDL_SWSURFACE,scw,sch-menu_height,c->format->BitsPerPixel,
-                               c->format->Rmask,c->format->Gmask,c->format->Bmask,c->format->Amask))==nullptr)
- {
-  std::cerr << "Error creating secondary SDL surface. Exiting.\n";
-  SDL_Quit();
-  exit(1);
- }
+ // With 8 bits per pixel, the buffer needs the palette of the canvas. Otherwise white and black would be the same (empty) color.
+ buf=NewSurface(scw,sch-menu_height);
  
  lc[Red].r      =0xFF; lc[Red].g=      0x00; lc[Red].b=      0x00; lc[Red].unused      =0x00;
  lc[Green].r    =0x00; lc[Green].g=    0xFF; lc[Green].b=    0x00; lc[Green].unused    =0x00;
@@ -97,9 +58,17 @@ Canvas::Canvas(Config &cfg)
   SDL_Quit();
   exit(1);
  }
+
+ // The glyphs are rendered once, in the three colors used by the menu and the messages
+ atlas=new GlyphAtlas(tf,c->format);
+ atlas->AddColor(White,lc[White]);
+ atlas->AddColor(Green,lc[Green]);
+ atlas->AddColor(Black,lc[Black]);
+ menubar=nullptr;
  
  drawstate=Drawing;
  tracing=false;
+ ink_changed=false;
  line_width=2;
  er_size=2*cfg.GetEraserSize();
  
@@ -107,6 +76,8 @@ Canvas::Canvas(Config &cfg)
  
  save_message=cfg.GetSaveMessage();
  errorsave_message=cfg.GetErrorSaveMessage();
+ atlas->AddGlyphs(save_message);
+ atlas->AddGlyphs(errorsave_message);
  
  unsigned char *p=(unsigned char *)buf->pixels+(buf->pitch*menu_height);
  // We store the bytes that make a background pixel, to be used later by merge. 
@@ -120,6 +91,30 @@ Canvas::Canvas(Config &cfg)
  
  // This is not real. They will be changed when pen starts tracing.
  x0=y0=0;
+
+ overlay=NoOverlay;
+ under=nullptr;
+ sched=nullptr;
+ prof=nullptr;
+ hud=false;
+ frames=0;
+ last_merge=0;
+ predictor=(cfg.GetPenPrediction()>0) ? new StrokePredictor(cfg.GetPenPrediction()) : nullptr;
+ pred_under=nullptr;
+ predicted=false;
+ smoother=(cfg.GetStrokeSmoothing()) ? new StrokeSmoother() : nullptr;
+ last_x=last_y=0;
+ keep_strokes=false;
+ strokes_valid=true;
+ hl=nullptr;
+ back=nullptr;
+ aa=(cfg.GetInkAntialiasing()) ? new InkCoverage(c->format,scw,sch) : nullptr;
+ pointer=new PointerTrail(cfg.GetPointerTime(),scw,sch,lc[Red]);
+ tiles=nullptr;
+ panning=false;
+ pan_x=pan_y=0;
+ // Yellow, not lc[Yellow], which is cyan
+ hl_color.r=0xFF; hl_color.g=0xE0; hl_color.b=0x00; hl_color.unused=0x00;
  
  // This call initializes the variables used to draw the line characteristics selection box
  InitLC();
@@ -135,42 +130,142 @@ void Canvas::ShowSplash(SDL_Surface *splash_surface)
  r.y=(splash_surface->h>sch) ? 0 : (sch-splash_surface->h)/2;
  r.w=(splash_surface->w>scw) ? scw : splash_surface->w;
  r.h=(splash_surface->h>sch) ? sch : splash_surface->h;
+
+ // The whole screen is kept, since the splash is shown over a black background
+ SDL_Rect all;
+ all.x=all.y=0;
+ all.w=scw;
+ all.h=sch;
+ OpenOverlay(SplashOverlay,all);
+ SDL_FillRect(c,&all,SDL_MapRGB(c->format,lc[Black].r,lc[Black].g,lc[Black].b));
  SDL_BlitSurface(splash_surface,nullptr,c,&r);
- 
- SDL_Event ev;
+ SDL_FreeSurface(splash_surface);
 
  Update(Slide);
- do
+}
+
+void Canvas::OpenOverlay(Overlays o,SDL_Rect r)
+{
+ // Only one overlay at a time. If another one was open, it is closed (and what was under it restored) first.
+ if (overlay!=NoOverlay)
+  CloseOverlay();
+ RemovePrediction();
+
+ // The kept area must be inside the canvas, even if the box (for example, with a very long message) is not
+ int x1=(r.x<0) ? 0 : r.x;
+ int y1=(r.y<0) ? 0 : r.y;
+ int x2=(r.x+r.w>scw) ? scw : r.x+r.w;
+ int y2=(r.y+r.h>sch) ? sch : r.y+r.h;
+ r.x=x1;
+ r.y=y1;
+ r.w=(x2>x1) ? x2-x1 : 1;
+ r.h=(y2>y1) ? y2-y1 : 1;
+
+ // The copy is done byte by byte, so that it is valid for any pixel format (even palettized ones)
+ under=NewSurface(r.w,r.h);
+ int bpp=c->format->BytesPerPixel;
+ SDL_LockSurface(c);
+ for (int i=0;i<r.h;i++)
+  memcpy((Uint8 *)under->pixels+i*under->pitch,(Uint8 *)c->pixels+(r.y+i)*c->pitch+r.x*bpp,r.w*bpp);
+ SDL_UnlockSurface(c);
+ under_rect=r;
+ overlay=o;
+}
+
+void Canvas::CloseOverlay(void)
+{
+ if (overlay==NoOverlay)
+  return;
+
+ SDL_Rect r=under_rect;
+ int bpp=c->format->BytesPerPixel;
+ SDL_LockSurface(c);
+ for (int i=0;i<r.h;i++)
+  memcpy((Uint8 *)c->pixels+(r.y+i)*c->pitch+r.x*bpp,(Uint8 *)under->pixels+i*under->pitch,r.w*bpp);
+ SDL_UnlockSurface(c);
+ presenter->Update(r.x,r.y,r.w,r.h);
+
+ SDL_FreeSurface(under);
+ under=nullptr;
+ overlay=NoOverlay;
+}
+
+void Canvas::OverlayEvent(const SDL_Event &ev)
+{
+ switch (overlay)
  {
-  SDL_PollEvent(&ev);
- } 
- while ((ev.type!=SDL_KEYDOWN) && (ev.type!=SDL_MOUSEBUTTONDOWN));
- SDL_FreeSurface(splash_surface);
+  case SplashOverlay:
+        if ((ev.type==SDL_KEYDOWN) || (ev.type==SDL_MOUSEBUTTONDOWN))
+         CloseOverlay();
+        break;
+  case ConfirmOverlay:
+        if ((ev.type==SDL_MOUSEBUTTONDOWN) && Inside(ev.button.x,ev.button.y,confirm_ok))
+         CloseOverlay();
+        break;
+  case LineCharacOverlay:
+        // Only events of mouse click inside the choice box are considered
+        if ((ev.type==SDL_MOUSEBUTTONDOWN) && Inside(ev.button.x,ev.button.y,choicerect))
+         LineCharacClick(ev.button.x,ev.button.y);
+        break;
+  default:
+        break;
+ }
+}
+
+SDL_Rect Canvas::SlideRect(SDL_Surface *s)
+{
+ SDL_Rect r;
+ r.x=(s->w>scw) ? 0 : ((scw-s->w)/2);
+ r.y=(s->h>(sch-menu_height-1)) ? menu_height : menu_height+((sch-menu_height-1-s->h)/2);
+ r.w=(s->w>scw) ? scw : s->w;
+ r.h=(s->h>(sch-menu_height-1)) ? (sch-menu_height-1) : s->h;
+ return r;
 }
 
 void Canvas::Show(SDL_Surface *s)
 {
+ ScopedTimer t(prof,Profiler::Show);
  SDL_Rect r;
 
+ RemovePrediction();
+ // The pointer pointed at what was shown before
+ DiscardPointer(false);
+
  if (s!=nullptr)
  {
-  r.x=(s->w>scw) ? 0 : ((scw-s->w)/2);
-  r.y=(s->h>(sch-menu_height-1)) ? menu_height : menu_height+((sch-menu_height-1-s->h)/2);
-  r.w=(s->w>scw) ? scw : s->w;
-  r.h=(s->h>(sch-menu_height-1)) ? (sch-menu_height-1) : s->h;
+  r=SlideRect(s);
+  SDL_Rect rb=r;
   SDL_BlitSurface(s,nullptr,c,&r);
-  SDL_FreeSurface(s);
+  // The copy of the slide under the highlights follows what is shown
+  if (back!=nullptr)
+   SDL_BlitSurface(s,nullptr,back,&rb);
  }
  else
   Erase(Slide);
 }
 
+void Canvas::ShowView(SDL_Surface *v,SDL_Rect r)
+{
+ RemovePrediction();
+ DiscardPointer(false);
+ SDL_Rect a=GetDrawingArea();
+ SDL_Rect d;
+ d.x=Sint16(a.x+r.x);
+ d.y=Sint16(a.y+r.y);
+ SDL_BlitSurface(v,&r,c,&d);
+ frames++;
+ presenter->Update(a.x+r.x,a.y+r.y,r.w,r.h);
+}
+
 void Canvas::Update(UpdatableObjects what)
 {
+ ScopedTimer t(prof,Profiler::Update);
+ frames++;
+ // Traces are only seen once merged in the canvas, so updating them is updating the drawing area
  if ((what == Slide) || (what == Both))
-  SDL_UpdateRect(c,0,0,scw,sch);
- if ((what == Buffer) || (what == Both))
-  SDL_UpdateRect(buf,0,0,scw,sch-menu_height);
+  presenter->Update(0,0,scw,sch);
+ else
+  presenter->Update(0,menu_height,scw,sch-menu_height);
 }
 
 void Canvas::Erase(UpdatableObjects what)
@@ -181,9 +276,27 @@ void Canvas::Erase(UpdatableObjects what)
  r.w=scw;
  r.h=sch-menu_height;
  if ((what == Slide) || (what == Both))
+ {
+  RemovePrediction();
+  DiscardPointer(false);
   SDL_FillRect(c,&r,SDL_MapRGB(c->format,lc[White].r,lc[White].g,lc[White].b));
+  if (back!=nullptr)
+   SDL_FillRect(back,&r,SDL_MapRGB(back->format,lc[White].r,lc[White].g,lc[White].b));
+ }
  if ((what == Buffer) || (what == Both))
+ {
   SDL_FillRect(buf,&r,SDL_MapRGB(buf->format,lc[White].r,lc[White].g,lc[White].b));
+  ink_changed=true;
+  // Empty traces are described by no strokes at all
+  strokes.clear();
+  stroke.points.clear();
+  strokes_valid=true;
+  // Highlights are traces too
+  if (hl!=nullptr)
+   hl->Clear();
+  if (aa!=nullptr)
+   aa->Clear();
+ }
 }
 
 // Remember: GetPosCode is called by main only in the event of SDL_MOUSEBUTTONDOWN
@@ -196,6 +309,12 @@ Config::Commands Canvas::GetPosCode(int x,int y,bool &for_canvas)
  }
  else
  {
+  // While the HUD is shown instead of the menu, a click on it hides it
+  if (hud)
+  {
+   for_canvas=true;
+   return Config::ToggleHud;
+  }
   if (x<menu_height)
    return Config::DrawErase;
   
@@ -213,27 +332,25 @@ Config::Commands Canvas::GetPosCode(int x,int y,bool &for_canvas)
  }
 }
 
-void Canvas::DrawConfirmBoxAndWait(const std::string &fn,const std::string &message)
+void Canvas::DrawConfirmBox(const std::string &fn,const std::string &message)
 {
  SDL_Rect r;
 
  std::string complete_message=message;
- complete_message.replace(message.find_first_of("%s"),fn.size(),fn);
- int w,h;
- SDL_Surface *t=TTF_RenderUTF8_Solid(tf,complete_message.c_str(),lc[Black]);
- TTF_SizeUTF8(tf,complete_message.c_str(),&w,&h);
+ size_t pos=message.find("%s");
+ if (pos!=std::string::npos)
+  complete_message.replace(pos,2,fn);
+ int w=atlas->TextWidth(complete_message);
+ int h=atlas->Height();
 
  r.x=(scw-w-20)/2;
  r.y=menu_height+(sch-menu_height-h-50)/2;
  r.w=w+20;
  r.h=h+50;
+ OpenOverlay(ConfirmOverlay,r);
  Drawrect(r);
 
- r.x+=10;
- r.y+=10;
- r.w=w;
- r.h=h;
- SDL_BlitSurface(t,nullptr,c,&r);
+ atlas->Draw(c,complete_message,r.x+10,r.y+10,Black);
 
  r.x=(scw-30)/2;
  r.y=menu_height+(sch-menu_height)/2+7;
@@ -241,33 +358,17 @@ void Canvas::DrawConfirmBoxAndWait(const std::string &fn,const std::string &mess
  r.h=20;
  Drawrect(r);
 
- SDL_FreeSurface(t);
- t=TTF_RenderUTF8_Solid(tf,"OK",lc[Black]);
- TTF_SizeUTF8(tf,"OK",&w,&h);
- SDL_Rect r1;
- r1.x=(scw-w)/2;
- r1.y=r.y+2;
- r1.w=w;
- r1.h=h;
- SDL_BlitSurface(t,nullptr,c,&r1);
-
- Update(Slide);
+ atlas->Draw(c,"OK",(scw-atlas->TextWidth("OK"))/2,r.y+2,Black);
 
- SDL_Event ev;
- bool quit=false;
- do
- {
-  SDL_PollEvent(&ev);
-  if ((ev.type==SDL_MOUSEBUTTONDOWN) && (Inside(ev.button.x,ev.button.y,r)))
-   quit=true;
- } 
- while (!quit);
+ // The box will be closed by OverlayEvent when the user clicks on OK
+ confirm_ok=r;
+ presenter->Update(under_rect.x,under_rect.y,under_rect.w,under_rect.h);
 }
 
 /**
  * This draw each of the menu esntries. To be cleaned and compacted.
  */
-void Canvas::TextWithHighlight(const std::string &s,int row,int col,int d,int h)
+void Canvas::TextWithHighlight(SDL_Surface *dst,const std::string &s,int row,int col)
 {
  std::string s1,s2,s3;
  unsigned int i=0;
@@ -287,47 +388,26 @@ void Canvas::TextWithHighlight(const std::string &s,int row,int col,int d,int h)
   i+=2;
  s3=s.substr(i,s.size()-i);
  
- int w1,h1,w2,h2,w3,h3;
- SDL_Surface *sa=TTF_RenderUTF8_Solid(tf,s1.c_str(),lc[White]);
- TTF_SizeUTF8(tf,s1.c_str(),&w1,&h1);
- SDL_Surface *sb=TTF_RenderUTF8_Solid(tf,s2.c_str(),lc[Green]);
- TTF_SizeUTF8(tf,s2.c_str(),&w2,&h2);
- SDL_Surface *sc=TTF_RenderUTF8_Solid(tf,s3.c_str(),lc[White]);
- TTF_SizeUTF8(tf,s3.c_str(),&w3,&h3);
-
- SDL_Rect rt;
- rt.x=col+2;
- rt.y=row;
- rt.w=w1;
- rt.h=h1;
- SDL_BlitSurface(sa,nullptr,c,&rt);
- rt.x=col+w1+2;
- rt.y=row;
- rt.w=w2;
- rt.h=h2;
- SDL_BlitSurface(sb,nullptr,c,&rt);
- rt.x=col+w1+w2+2;
- rt.y=row;
- rt.w=w3;
- rt.h=h3;
- SDL_BlitSurface(sc,nullptr,c,&rt);
-
- SDL_FreeSurface(sa);
- SDL_FreeSurface(sb);
- SDL_FreeSurface(sc);
+ int x=col+2;
+ x+=atlas->Draw(dst,s1,x,row,White);
+ x+=atlas->Draw(dst,s2,x,row,Green);
+ atlas->Draw(dst,s3,x,row,White);
 }
 
 void Canvas::SetMenu(const std::vector<std::string> &mitems)
 {
  num_menuitems=mitems.size();
+
+ // The menu is composed once in its own surface. Redrawing it later is just a blit of this surface.
+ if (menubar!=nullptr)
+  SDL_FreeSurface(menubar);
+ menubar=NewSurface(scw,menu_height);
  
  SDL_Rect r;
  r.x=r.y=0;
  r.w=scw;
  r.h=menu_height;
- SDL_FillRect(c,&r,SDL_MapRGB(c->format,lc[White].r,lc[White].g,lc[White].b));
-
- DrawmodeSetcolor();
+ SDL_FillRect(menubar,&r,SDL_MapRGB(menubar->format,lc[White].r,lc[White].g,lc[White].b));
 
  int item_width=(scw-menu_height)/num_menuitems;
  for (unsigned int i=0;i<mitems.size();i++)
@@ -336,14 +416,117 @@ void Canvas::SetMenu(const std::vector<std::string> &mitems)
   r.y=0;
   r.h=menu_height;
   r.w=item_width-1;
-  SDL_FillRect(c,&r,SDL_MapRGB(c->format,lc[Black].r,lc[Black].g,lc[Black].b));
-  TextWithHighlight(mitems[i],r.y+1,r.x+1,item_width,menu_height);
+  SDL_FillRect(menubar,&r,SDL_MapRGB(menubar->format,lc[Black].r,lc[Black].g,lc[Black].b));
+  // Texts are clipped to their own item
+  SDL_SetClipRect(menubar,&r);
+  TextWithHighlight(menubar,mitems[i],r.y+1,r.x+1);
+  SDL_SetClipRect(menubar,nullptr);
+ }
+
+ RedrawMenu();
+}
+
+void Canvas::RedrawMenu(void)
+{
+ if (menubar==nullptr)
+  return;
+
+ SDL_Rect r;
+ r.x=r.y=0;
+ r.w=scw;
+ r.h=menu_height;
+ SDL_BlitSurface(menubar,nullptr,c,&r);
+ DrawmodeSetcolor();
+ TracingSetcolor();
+ presenter->Update(0,0,scw,menu_height);
+}
+
+void Canvas::DrawHud(const std::string &s)
+{
+ // The squares of the drawing mode, on the left, are kept
+ SDL_Rect r;
+ r.x=menu_height;
+ r.y=0;
+ r.w=scw-menu_height;
+ r.h=menu_height;
+ SDL_FillRect(c,&r,SDL_MapRGB(c->format,lc[Black].r,lc[Black].g,lc[Black].b));
+ SDL_SetClipRect(c,&r);
+ atlas->Draw(c,s,r.x+2,1,Green);
+ SDL_SetClipRect(c,nullptr);
+ presenter->Update(r.x,r.y,r.w,r.h);
+}
+
+SDL_Surface *Canvas::NewSurface(int w,int h)
+{
+ SDL_Surface *s=SDL_CreateRGBSurface(SDL_SWSURFACE,w,h,c->format->BitsPerPixel,
+                                     c->format->Rmask,c->format->Gmask,c->format->Bmask,c->format->Amask);
+ if (s==nullptr)
+ {
+  std::cerr << "Error creating auxiliary SDL surface. Exiting.\n";
+  SDL_Quit();
+  exit(1);
  }
- SDL_UpdateRect(c,0,0,scw,menu_height);
+ if (c->format->palette!=nullptr)
+  SDL_SetPalette(s,SDL_LOGPAL,c->format->palette->colors,0,c->format->palette->ncolors);
+ return s;
+}
+
+SDL_Surface *Canvas::Snapshot(void)
+{
+ // What is predicted, or pointed at, is not part of the blackboard
+ RemovePrediction();
+ DiscardPointer(true);
+ SDL_Surface *snap=NewSurface(scw,sch-menu_height);
+ SDL_Rect r;
+ r.x=0;
+ r.y=menu_height;
+ r.w=scw;
+ r.h=sch-menu_height;
+ SDL_BlitSurface(c,&r,snap,nullptr);
+ return snap;
+}
+
+void Canvas::EndSDL(void)
+{
+ if (menubar!=nullptr)
+  SDL_FreeSurface(menubar);
+ menubar=nullptr;
+ if (pred_under!=nullptr)
+  SDL_FreeSurface(pred_under);
+ pred_under=nullptr;
+ delete predictor;
+ predictor=nullptr;
+ delete smoother;
+ smoother=nullptr;
+ delete hl;
+ hl=nullptr;
+ delete aa;
+ aa=nullptr;
+ delete pointer;
+ pointer=nullptr;
+ if (back!=nullptr)
+  SDL_FreeSurface(back);
+ back=nullptr;
+ delete atlas;
+ atlas=nullptr;
+ delete presenter;
+ presenter=nullptr;
+ SDL_Quit();
+}
+
+Uint32 Canvas::ModeColor(void)
+{
+ if (drawstate==Highlighting)
+  return SDL_MapRGB(c->format,hl_color.r,hl_color.g,hl_color.b);
+ if (drawstate==Pointing)
+  return SDL_MapRGB(c->format,lc[Orange].r,lc[Orange].g,lc[Orange].b);
+ int d_col=(drawstate==Drawing) ? Green : Red;
+ return SDL_MapRGB(c->format,lc[d_col].r,lc[d_col].g,lc[d_col].b);
 }
 
 /**
- * This is to change the mode-square in the upper-left corner (that one which shows if we are drawing (green) or erasing (red))
+ * This is to change the mode-square in the upper-left corner (that one which shows if we are drawing (green), erasing (red),
+ * highlighting (yellow) or pointing (orange))
  */
 void Canvas::DrawmodeSetcolor(void)
 {
@@ -352,9 +535,8 @@ void Canvas::DrawmodeSetcolor(void)
  r.y=1;
  r.w=menu_height-2;
  r.h=menu_height-2;
- int d_col=(drawstate==Drawing) ? Green : Red;
- SDL_FillRect(c,&r,SDL_MapRGB(c->format,lc[d_col].r,lc[d_col].g,lc[d_col].b));
- SDL_UpdateRect(c,r.x,r.y,r.w,r.h);
+ SDL_FillRect(c,&r,ModeColor());
+ presenter->Update(r.x,r.y,r.w,r.h);
 }
 
 /**
@@ -368,9 +550,8 @@ void Canvas::TracingSetcolor(void)
  r.y=menu_height/4;
  r.w=menu_height/2;
  r.h=menu_height/2;
- int d_col=(tracing) ? Black : ((drawstate==Drawing) ? Green : Red);
- SDL_FillRect(c,&r,SDL_MapRGB(c->format,lc[d_col].r,lc[d_col].g,lc[d_col].b));
- SDL_UpdateRect(c,r.x,r.y,r.w,r.h);
+ SDL_FillRect(c,&r,(tracing) ? SDL_MapRGB(c->format,lc[Black].r,lc[Black].g,lc[Black].b) : ModeColor());
+ presenter->Update(r.x,r.y,r.w,r.h);
 }
 
 void Canvas::Drawrect(SDL_Rect r)
@@ -444,12 +625,10 @@ void Canvas::InitLC()
  ok.w=2*sqside-4;
  ok.h=sqside;
  
- // The OK text is rendered and its width and height are stored
- 
- text=TTF_RenderUTF8_Solid(tf,"OK",lc[Black]);
+ // The place of the OK text is calculated from its width and height
  {
-  int tw,th;
-  TTF_SizeUTF8(tf,"OK",&tw,&th);
+  int tw=atlas->TextWidth("OK");
+  int th=atlas->Height();
   oktext.x=ok.x+(ok.w/2)-(tw/2);
   oktext.y=ok.y+(ok.h/2)-(th/2);
   oktext.w=tw;
@@ -469,149 +648,148 @@ void Canvas::InitLC()
 
 void Canvas::ChangeLineCharac(void)
 {
- bool redraw=true;
- SDL_Event ev;
+ // The box is opened as an overlay. From now on, clicks are processed by LineCharacClick until the user clicks on OK.
+ // Inside() includes the right and bottom borders, so the kept area is one pixel bigger in each direction.
+ SDL_Rect r=choicerect;
+ r.w++;
+ r.h++;
+ OpenOverlay(LineCharacOverlay,r);
+ DrawLineCharac();
+}
+
+void Canvas::DrawLineCharac(void)
+{
+ // The complete rectangle that contains the choice box is redraw
+ Drawrect(choicerect);
+
+ // Then, the rectangle around the chosen color (defined by line_draw_index)
+ // Only the things that change for this rectangle (the location (x,y)) are modified
+ defcol.x=xoff+(line_draw_index%2)*sqside;
+ defcol.y=yoff+(line_draw_index/2)*sqside;
+ Drawrect(defcol);
+
+ // Then, the rectangle around the chosen line (defined by line_width)
+ // Again, only the thing that changes is modified
+ defline.y=yoff+(sqside/4)+((MaxLWidth+18)*(line_width-1))+2;
+ Drawrect(defline);
+ 
+ // Then, the colored squares are filled, each with its color
+ for (int i=0;i<NumCols;i++)
+  SDL_FillRect(c,&colrect[i],SDL_MapRGB(c->format,lc[i].r,lc[i].g,lc[i].b));
+ 
+ // The lines with different widths are black filled rectangles
+ for (int i=0;i<MaxLWidth;i++)
+  SDL_FillRect(c,&lines[i],SDL_MapRGB(c->format,lc[Black].r,lc[Black].g,lc[Black].b));
  
- do
+ // And finally the rectangle with the OK for confirmation...
+ Drawrect(ok);
+ // ...together with its content
+ atlas->Draw(c,"OK",oktext.x,oktext.y,Black);
+
+ // and the whole choice box is updated.
+ presenter->Update(xoff,yoff,rw,rh); 
+}
+
+void Canvas::LineCharacClick(int x,int y)
+{
+ // The user has done his/her choice. The box is closed, and what was under it comes back.
+ if (Inside(x,y,ok))
  {
-  // The first time, everything is drawn...
-  if (redraw)
-  {
-   // The complete rectangle that contains the choice box is redraw
-   Drawrect(choicerect);
-
-   // Then, the rectangle around the chosen color (defined by line_draw_index)
-   // Only the things that change for this rectangle (the location (x,y)) are modified
-   defcol.x=xoff+(line_draw_index%2)*sqside;
-   defcol.y=yoff+(line_draw_index/2)*sqside;
-   Drawrect(defcol);
-
-   // Then, the rectangle around the chosen line (defined by line_width)
-   // Again, only the thing that changes is modified
-   defline.y=yoff+(sqside/4)+((MaxLWidth+18)*(line_width-1))+2;
-   Drawrect(defline);
-   
-   // Then, the colored squares are filled, each with its color
-   for (int i=0;i<NumCols;i++)
-    SDL_FillRect(c,&colrect[i],SDL_MapRGB(c->format,lc[i].r,lc[i].g,lc[i].b));
-   
-   // The lines with different widths are black filled rectangles
-   for (int i=0;i<MaxLWidth;i++)
-    SDL_FillRect(c,&lines[i],SDL_MapRGB(c->format,lc[Black].r,lc[Black].g,lc[Black].b));
-   
-   // And finally the rectangle with the OK for confirmation...
-   Drawrect(ok);
-   // ...together with its content
-   SDL_BlitSurface(text,nullptr,c,&oktext);
-
-   // and the whole choice box is updated.
-   SDL_UpdateRect(c,xoff,yoff,rw,rh); 
+  CloseOverlay();
+  return;
+ }
  
-   //cout << "Redraw done.\n"; char ch; cin >> ch;
-  }
-  
-  // Now, let's look at the mouse click to know if we should redraw or not
-  // Not in principle, unless the user clicks on a color box or on a width line box
-  redraw=false;
-  // Only events of mouse click inside the choice box are considered
-  if (SDL_PollEvent(&ev) && (ev.type==SDL_MOUSEBUTTONDOWN) && Inside(ev.button.x,ev.button.y,choicerect))
-  {
-   // The user has done his/her choice. That's all for this function (and it is the only way to leave it)
-   if (Inside(ev.button.x,ev.button.y,ok))
-    return;
-   
-   // Let's check if the click is inside a color box...
-   int i=0;
-   while ((i<NumCols) && (!Inside(ev.button.x,ev.button.y,colrect[i])))
-    i++;
-   // If it is, we will take note of the new color (its index and the real color) and the box will have to be redrawn to reflect the new choice
-   if (i<NumCols)
-   {
-    line_draw_index=i;
-    line_draw_col=SDL_MapRGB(c->format,lc[i].r,lc[i].g,lc[i].b);
-    redraw=true;
-   }
-   else // If not a color box, let's see if it is a line width box. In this case, redraw, too.
-   { 
-    i=0;
-    while ((i<MaxLWidth) && (!Inside(ev.button.x,ev.button.y,linerect[i])))
-     i++;
-    if (i<MaxLWidth)
-    {
-     line_width=i+1;
-     redraw=true;
-    }
-   }
-  }
- } 
- while (true); // This is an infinite loop. No way to go out except by cliking on OK
+ // Let's check if the click is inside a color box...
+ int i=0;
+ while ((i<NumCols) && (!Inside(x,y,colrect[i])))
+  i++;
+ // If it is, we will take note of the new color (its index and the real color) and the box will have to be redrawn to reflect the new choice
+ if (i<NumCols)
+ {
+  line_draw_index=i;
+  line_draw_col=SDL_MapRGB(c->format,lc[i].r,lc[i].g,lc[i].b);
+  DrawLineCharac();
+  return;
+ }
+
+ // If not a color box, let's see if it is a line width box. In this case, redraw, too.
+ i=0;
+ while ((i<MaxLWidth) && (!Inside(x,y,linerect[i])))
+  i++;
+ if (i<MaxLWidth)
+ {
+  line_width=i+1;
+  DrawLineCharac();
+ }
 }
 
-void Canvas::WritePnm(std::ofstream &f)
+void Canvas::WritePnm(std::ostream &f,SDL_Surface *s)
 {
- f << "P6\n" << scw << " " << sch-menu_height << "\n255\n";
+ f << "P6\n" << s->w << " " << s->h << "\n255\n";
 
- SDL_PixelFormat *fmt=c->format;
+ SDL_PixelFormat *fmt=s->format;
  Uint8 bpp=fmt->BytesPerPixel;
  
  Uint8 *p8;
  Uint16 *p16;
- Uint32 *p32,co;
+ Uint32 co;
  SDL_Color *cs;
  unsigned char cc[3];
- //cerr << "Saving image of " << scw << "x" << sch-menu_height << " with " << int(bpp) << " bytes per pixel.\n";
- switch(bpp)
- {
-  case 1: p8=(Uint8 *)c->pixels+(scw*menu_height);
-	  for (int i=scw*menu_height;i<scw*sch;i++,p8++)
-	  {
-	   cs=fmt->palette->colors+(*p8);
-           cc[0]=cs->r;
-	   cc[1]=cs->g;
-	   cc[2]=cs->b;
-	   f.write(reinterpret_cast<char const *>(cc),3);
-	  }
-	  break;
-  case 2: p16=(Uint16 *)c->pixels+(scw*menu_height);
-	  for (int i=scw*menu_height;i<scw*sch;i++,p16++)
-	  {
-	   co=(Uint32)((*p16) & (fmt->Rmask));
-	   co>>=(fmt->Rshift);
-	   co<<=(fmt->Rloss);
-	   cc[0]=(unsigned char)co;
-	   co=(Uint32)((*p16) & (fmt->Gmask));
-	   co>>=(fmt->Gshift);
-	   co<<=(fmt->Gloss);
-	   cc[1]=(unsigned char)co;
-	   co=(Uint32)((*p16) & (fmt->Bmask));
-	   co>>=(fmt->Bshift);
-	   co<<=(fmt->Bloss);
-	   cc[2]=(unsigned char)co;
-	   f.write(reinterpret_cast<char const *>(cc),3);
-	  }
-  case 3:
-  case 4: p32=(Uint32 *)c->pixels+(scw*menu_height);
-	  for (int i=scw*menu_height;i<scw*sch;i++,p32++)
-	  {
-	   co=(Uint32)((*p32) & (fmt->Rmask));
-	   co>>=(fmt->Rshift);
-	   co<<=(fmt->Rloss);
-	   cc[0]=(unsigned char)co;
-	   co=(Uint32)((*p32) & (fmt->Gmask));
-	   co>>=(fmt->Gshift);
-	   co<<=(fmt->Gloss);
-	   cc[1]=(unsigned char)co;
-	   co=(Uint32)((*p32) & (fmt->Bmask));
-	   co>>=(fmt->Bshift);
-	   co<<=(fmt->Bloss);
-	   cc[2]=(unsigned char)co;
-	   f.write(reinterpret_cast<char const *>(cc),3);
-	  }
-	  break;
+ //cerr << "Saving image of " << s->w << "x" << s->h << " with " << int(bpp) << " bytes per pixel.\n";
+ for (int row=0;row<s->h;row++)
+ {
+  Uint8 *line=(Uint8 *)s->pixels+row*s->pitch;
+  switch(bpp)
+  {
+   case 1: p8=line;
+	   for (int i=0;i<s->w;i++,p8++)
+	   {
+	    cs=fmt->palette->colors+(*p8);
+	    cc[0]=cs->r;
+	    cc[1]=cs->g;
+	    cc[2]=cs->b;
+	    f.write(reinterpret_cast<char const *>(cc),3);
+	   }
+	   break;
+   case 2: p16=(Uint16 *)line;
+	   for (int i=0;i<s->w;i++,p16++)
+	   {
+	    co=(Uint32)((*p16) & (fmt->Rmask));
+	    co>>=(fmt->Rshift);
+	    co<<=(fmt->Rloss);
+	    cc[0]=(unsigned char)co;
+	    co=(Uint32)((*p16) & (fmt->Gmask));
+	    co>>=(fmt->Gshift);
+	    co<<=(fmt->Gloss);
+	    cc[1]=(unsigned char)co;
+	    co=(Uint32)((*p16) & (fmt->Bmask));
+	    co>>=(fmt->Bshift);
+	    co<<=(fmt->Bloss);
+	    cc[2]=(unsigned char)co;
+	    f.write(reinterpret_cast<char const *>(cc),3);
+	   }
+	   break;
+   case 3:
+   case 4: for (int i=0;i<s->w;i++)
+	   {
+	    // 3-byte pixels are not aligned, so pixels are copied byte by byte
+	    co=0;
+	    memcpy(&co,line+i*bpp,bpp);
+	    #if SDL_BYTEORDER == SDL_BIG_ENDIAN
+	    if (bpp==3)
+	     co>>=8;
+	    #endif
+	    cc[0]=(unsigned char)(((co & fmt->Rmask)>>fmt->Rshift)<<fmt->Rloss);
+	    cc[1]=(unsigned char)(((co & fmt->Gmask)>>fmt->Gshift)<<fmt->Gloss);
+	    cc[2]=(unsigned char)(((co & fmt->Bmask)>>fmt->Bshift)<<fmt->Bloss);
+	    f.write(reinterpret_cast<char const *>(cc),3);
+	   }
+	   break;
    default:
-        std::cerr << "Error: Blackboard image has an abnormal number of bits per pixel. Exiting.\n";
-	    SDL_Quit();
-	    exit(1);
+	   std::cerr << "Error: Blackboard image has an abnormal number of bits per pixel. Exiting.\n";
+	   SDL_Quit();
+	   exit(1);
+  }
  }
 }
 
@@ -623,93 +801,662 @@ void Canvas::SaveBlackboard()
  n[2]='\0';
  std::string fn="saved_"+std::string(n)+".pnm";
 
- std::ofstream f;
- f.open(fn.c_str());
- if (!f.is_open())
+ // The file is opened here, so that a file that cannot be created is reported at once
+ std::ofstream *f=new std::ofstream(fn.c_str());
+ if (!f->is_open())
  {
-  DrawConfirmBoxAndWait(fn,errorsave_message);
+  delete f;
+  DrawConfirmBox(fn,errorsave_message);
   return;
  }
- WritePnm(f);
- f.close();
- 
+
  last_saved++;
  if (last_saved>99)
   last_saved=0;
- 
- DrawConfirmBoxAndWait(fn,save_message);
+
+ // What is written is a copy of the canvas as it is now, since the user can go on drawing while it is being saved
+ SDL_Surface *snap=Snapshot();
+
+ if (sched==nullptr)
+ {
+  {
+   ScopedTimer t(prof,Profiler::Save);
+   WritePnm(*f,snap);
+   f->close();
+  }
+  DrawConfirmBox(fn,(f->fail()) ? errorsave_message : save_message);
+  delete f;
+  SDL_FreeSurface(snap);
+  return;
+ }
+
+ sched->Submit(Scheduler::Export,CancelToken(),[this,f,snap,fn](const CancelToken &)
+ {
+  {
+   ScopedTimer t(prof,Profiler::Save);
+   WritePnm(*f,snap);
+   f->close();
+  }
+  bool ok=!f->fail();
+  delete f;
+  SDL_FreeSurface(snap);
+  sched->PostToMain([this,fn,ok]()
+  {
+   notifications.push_back(std::make_pair(fn,(ok) ? save_message : errorsave_message));
+  });
+ });
+}
+
+bool Canvas::WriteImage(const std::string &fn)
+{
+ std::ofstream f(fn.c_str());
+ if (!f.is_open())
+  return false;
+ WriteImage(f);
+ f.close();
+ return !f.fail();
+}
+
+void Canvas::WriteImage(std::ostream &f)
+{
+ SDL_Surface *snap=Snapshot();
+ WritePnm(f,snap);
+ SDL_FreeSurface(snap);
+}
+
+void Canvas::ShowNotification(void)
+{
+ if (notifications.empty() || OverlayActive())
+  return;
+ DrawConfirmBox(notifications.front().first,notifications.front().second);
+ notifications.pop_front();
+}
+
+void Canvas::SetTracing(bool b)
+{
+ RemovePrediction();
+ // When the pen is lifted, the smoothed stroke is drawn up to its last position
+ if (tracing && !b && (smoother!=nullptr))
+ {
+  smoothed.clear();
+  smoother->End(smoothed);
+  for (size_t i=0;i<smoothed.size();i++)
+   Segment(smoothed[i].x,smoothed[i].y);
+ }
+ if (!b)
+  EndStroke();
+ if (predictor!=nullptr)
+  predictor->Reset();
+ tracing=b;
+ TracingSetcolor();
 }
 
 void Canvas::Drawline(int x1,int y1)
 {
- int dx=abs(x1-x0);
- int dy=abs(y1-y0);
+ // The real line takes the place of the provisional one
+ RemovePrediction();
 
- // Too short lines are not drawn. We'll wait until the user has moved mouse a little bit more.
- if ((dx+dy)<MinLDis)
+ if (smoother==nullptr)
+ {
+  // Too short lines are not drawn. We'll wait until the user has moved mouse a little bit more.
+  if ((abs(x1-x0)+abs(y1-y0))<MinLDis)
+   return;
+  Segment(x1,y1);
+  frames++;
+  last_x=x1;
+  last_y=y1;
   return;
+ }
 
- int sx=((x1-x0)>0) ? 1 : -1;
- int sy=((y1-y0)>0) ? 1 : -1;
+ // The curve is drawn in pieces that may be shorter than MinLDis, but positions of the pen too close to the former one are not used
+ if ((abs(x1-last_x)+abs(y1-last_y))<MinLDis)
+  return;
+ last_x=x1;
+ last_y=y1;
+ smoothed.clear();
+ smoother->AddPoint(x1,y1,smoothed);
+ for (size_t i=0;i<smoothed.size();i++)
+  Segment(smoothed[i].x,smoothed[i].y);
+ frames++;
+ // The stretch from the end of the curve to the pen will only be final when the next position arrives
+ if (drawstate==Drawing)
+  DrawProvisional(false,0,0);
+}
 
- int x=x0;
- int y=y0;
+void Canvas::Segment(int x1,int y1)
+{
+ if ((x1==x0) && (y1==y0))
+  return;
 
- int steep=0,e,i,fy,fx;
- SDL_Rect around;
- around.w=around.h=(drawstate==Drawing) ? line_width : er_size;
- Uint32 color=(drawstate==Drawing) ? line_draw_col : line_erase_col;
- if (dy>dx)
- {
-  steep=1;
-  std::swap(x,y);
-  std::swap(dx,dy);
-  std::swap(sx,sy);
- }
- e=2*dy-dx;
- for (i=0;i<dx;i++)
- {
-  fy=(steep) ? x : y;
-  fx=(steep) ? y : x;
-  around.x=fx-(line_width/2);
-  around.y=fy-(line_width/2);
-  SDL_FillRect(c,&around,color);
-  SDL_FillRect(buf,&around,color);
-  SDL_UpdateRect(c,around.x,around.y,around.w,around.h);
-  while (e>=0)
+ int size=line_width;
+ int offset=line_width/2;
+ Uint32 color=line_draw_col;
+ Uint8 tool=Stroke::Pen;
+ if (drawstate==Erasing)
+ {
+  size=er_size;
+  color=line_erase_col;
+  tool=Stroke::Eraser;
+ }
+ else if (drawstate==Highlighting)
+ {
+  StartHighlights();
+  size=HighlightLayer::TipSize;
+  offset=size/2;
+  color=hl->GetPixel();
+  tool=Stroke::Highlighter;
+ }
+ else if (drawstate==Pointing)
+ {
+  size=PointerSize;
+  offset=size/2;
+ }
+ // Antialiased lines may spread one pixel further than the brush
+ int margin=((drawstate==Drawing) && (aa!=nullptr)) ? 1 : 0;
+ int ux1=std::max(std::min(x0,x1)-offset-margin,0);
+ int uy1=std::max(std::min(y0,y1)-offset-margin,0);
+ int ux2=std::min(std::max(x0,x1)-offset+size+margin,scw);
+ int uy2=std::min(std::max(y0,y1)-offset+size+margin,sch);
+ SDL_Rect r;
+ r.x=ux1;
+ r.y=std::max(uy1,menu_height);
+ r.w=std::max(ux2-r.x,0);
+ r.h=std::max(uy2-r.y,0);
+
+ // The pointer draws neither in the traces nor in the strokes
+ if (drawstate==Pointing)
+ {
+  PointerPiece(x1,y1,r);
+  x0=x1;
+  y0=y1;
+  return;
+ }
+
+ if ((drawstate==Drawing) && (aa!=nullptr))
+ {
+  // The soft edges are blended again over the slide, not over what was already blended
+  StartBack();
+  aa->Line(buf,vback,x0,y0,x1,y1,size,offset,color);
+  Recompose(r);
+ }
+ else if (drawstate!=Highlighting)
+ {
+  RasterLine(c,x0,y0,x1,y1,size,offset,color);
+  RasterLine(buf,x0,y0,x1,y1,size,offset,color);
+ }
+ // The highlighter (and the eraser, over highlights) changes the layer, which is blended again from the slide, with the traces over it
+ if ((hl!=nullptr) && ((drawstate==Highlighting) || ((drawstate==Erasing) && !hl->Empty())))
+ {
+  hl->Line(x0,y0,x1,y1,size,offset,(drawstate==Highlighting));
+  Recompose(r);
+ }
+ ink_changed=true;
+
+ // The piece is added to the stroke being drawn, or starts a new one if there is none or the brush has changed
+ if (keep_strokes)
+ {
+  if (!stroke.points.empty() && ((stroke.color!=color) || (stroke.size!=size) || (stroke.offset!=offset) || (stroke.tool!=tool)))
+   EndStroke();
+  if (stroke.points.empty())
   {
-   y+=sy;
-   e-=2*dx;
+   stroke.color=color;
+   stroke.size=Uint16(size);
+   stroke.offset=Uint8(offset);
+   stroke.tool=tool;
+   StrokePoint p;
+   p.x=x0;
+   p.y=y0;
+   stroke.points.push_back(p);
   }
-  x+=sx;
-  e+=2*dy;
+  StrokePoint p;
+  p.x=x1;
+  p.y=y1;
+  stroke.points.push_back(p);
  }
+ else
+  strokes_valid=false;
+
+ // The whole piece is presented at once, instead of pixel by pixel
+ if ((ux2>ux1) && (uy2>uy1))
+  presenter->Update(ux1,uy1,ux2-ux1,uy2-uy1);
 
  x0=x1;
  y0=y1;
 }
 
+void Canvas::RasterLine(SDL_Surface *s,int xa,int ya,int xb,int yb,int size,int offset,Uint32 color)
+{
+ SDL_Rect around;
+ around.w=around.h=size;
+ WalkLine(xa,ya,xb,yb,[&](int x,int y)
+ {
+  around.x=x-offset;
+  around.y=y-offset;
+  SDL_FillRect(s,&around,color);
+ });
+}
+
+void Canvas::EndStroke(void)
+{
+ if (stroke.points.size()>=2)
+ {
+  stroke.Simplify(std::max(0.5,SimplifyTolerance*stroke.size));
+  strokes.push_back(stroke);
+ }
+ stroke.points.clear();
+}
+
+void Canvas::DrawStrokes(const std::vector<Stroke> &s)
+{
+ EndStroke();
+ for (size_t k=0;k<s.size();k++)
+ {
+  const Stroke &st=s[k];
+  if (st.tool==Stroke::Highlighter)
+   StartHighlights();
+  for (size_t i=1;i<st.points.size();i++)
+  {
+   const StrokePoint &a=st.points[i-1];
+   const StrokePoint &b=st.points[i];
+   if ((st.tool==Stroke::Pen) && (aa!=nullptr))
+    aa->Line(buf,vback,a.x,a.y,b.x,b.y,st.size,st.offset,st.color);
+   else if (st.tool!=Stroke::Highlighter)
+    RasterLine(buf,a.x,a.y,b.x,b.y,st.size,st.offset,st.color);
+   if ((hl!=nullptr) && (st.tool!=Stroke::Pen))
+    hl->Line(a.x,a.y,b.x,b.y,st.size,st.offset,(st.tool==Stroke::Highlighter));
+  }
+  if (keep_strokes)
+   strokes.push_back(st);
+ }
+}
+
+Uint64 Canvas::MemoryUse(void)
+{
+ Uint64 m=Uint64(buf->pitch)*Uint64(buf->h);
+ for (size_t k=0;k<strokes.size();k++)
+  m+=sizeof(Stroke)+strokes[k].points.capacity()*sizeof(StrokePoint);
+ if (back!=nullptr)
+  m+=Uint64(back->pitch)*Uint64(back->h);
+ if (hl!=nullptr)
+  m+=hl->MemoryUse();
+ if (aa!=nullptr)
+  m+=aa->MemoryUse();
+ m+=pointer->MemoryUse();
+ return m;
+}
+
+void Canvas::Predict(int x,int y,Uint64 stamp)
+{
+ if (predictor==nullptr)
+  return;
+ predictor->AddSample(x,y,stamp);
+ RemovePrediction();
+ if (!tracing || (drawstate!=Drawing))
+  return;
+ int px=0,py=0;
+ bool ahead=predictor->Predict(px,py);
+ if (ahead || (smoother!=nullptr))
+  DrawProvisional(ahead,px,py);
+}
+
+void Canvas::DrawProvisional(bool ahead,int px,int py)
+{
+ // The provisional line goes from the end of the traces, through the last position of the pen when the traces do not reach it,
+ // up to the predicted one, which never enters the menu nor leaves the screen
+ StrokePoint pts[3];
+ int n=0;
+ pts[n].x=x0;
+ pts[n++].y=y0;
+ if ((smoother!=nullptr) && ((last_x!=x0) || (last_y!=y0)))
+ {
+  pts[n].x=last_x;
+  pts[n++].y=last_y;
+ }
+ if (ahead)
+ {
+  pts[n].x=std::min(std::max(px,0),scw-1);
+  pts[n++].y=std::min(std::max(py,menu_height+MaxLWidth),sch-1);
+ }
+ if (n<2)
+  return;
+
+ int x1=scw,y1=sch,x2=0,y2=0;
+ for (int k=0;k<n;k++)
+ {
+  x1=std::min(x1,pts[k].x-line_width/2);
+  y1=std::min(y1,pts[k].y-line_width/2);
+  x2=std::max(x2,pts[k].x-line_width/2+line_width);
+  y2=std::max(y2,pts[k].y-line_width/2+line_width);
+ }
+ x1=std::max(x1,0);
+ y1=std::max(y1,menu_height+1);
+ x2=std::min(x2,scw);
+ y2=std::min(y2,sch);
+ if ((x2<=x1) || (y2<=y1))
+  return;
+ // The surface for what is under the line grows if a line does not fit in it (very fast strokes)
+ if ((pred_under==nullptr) || (x2-x1>pred_under->w) || (y2-y1>pred_under->h))
+ {
+  int side=2*StrokePredictor::MaxDistance+MaxLWidth;
+  if (pred_under!=nullptr)
+  {
+   side=std::max(side,std::max(pred_under->w,pred_under->h));
+   SDL_FreeSurface(pred_under);
+  }
+  pred_under=NewSurface(std::max(side,x2-x1),std::max(side,y2-y1));
+ }
+ pred_rect.x=x1;
+ pred_rect.y=y1;
+ pred_rect.w=x2-x1;
+ pred_rect.h=y2-y1;
+
+ // What is under the line is kept, and the line is drawn with the pen of the traces, but only on the screen
+ SDL_Rect r=pred_rect;
+ SDL_BlitSurface(c,&r,pred_under,nullptr);
+ SDL_SetClipRect(c,&pred_rect);
+ SDL_Rect around;
+ around.w=around.h=line_width;
+ for (int k=1;k<n;k++)
+ {
+  int ax=pts[k-1].x,ay=pts[k-1].y,bx=pts[k].x,by=pts[k].y;
+  int steps=std::max(abs(bx-ax),abs(by-ay));
+  for (int i=1;i<=steps;i++)
+  {
+   around.x=ax+(bx-ax)*i/steps-(line_width/2);
+   around.y=ay+(by-ay)*i/steps-(line_width/2);
+   SDL_FillRect(c,&around,line_draw_col);
+  }
+ }
+ SDL_SetClipRect(c,nullptr);
+ presenter->Update(pred_rect.x,pred_rect.y,pred_rect.w,pred_rect.h);
+ predicted=true;
+}
+
+void Canvas::RemovePrediction(void)
+{
+ if (!predicted)
+  return;
+ SDL_Rect src,dst=pred_rect;
+ src.x=src.y=0;
+ src.w=pred_rect.w;
+ src.h=pred_rect.h;
+ SDL_BlitSurface(pred_under,&src,c,&dst);
+ presenter->Update(pred_rect.x,pred_rect.y,pred_rect.w,pred_rect.h);
+ predicted=false;
+}
+
 void Canvas::Merge(void)
 {
- unsigned char *p=(unsigned char *)buf->pixels+(buf->pitch*menu_height);
- unsigned char *q=(unsigned char *)c->pixels+(c->pitch*menu_height);
+ ScopedTimer t(prof,Profiler::Merge);
+ Uint64 start=(hud) ? InputQueue::Now() : 0;
+ RemovePrediction();
+ // With a copy of the slide, the drawing area is composed again from it, with the highlights between the slide and the traces
+ if (back!=nullptr)
+ {
+  SDL_Rect r;
+  r.x=0;
+  r.y=menu_height;
+  r.w=scw;
+  r.h=sch-menu_height;
+  Recompose(r);
+ }
+ else
+  MergeInk(0,menu_height,scw,buf->h);
+ if (hud)
+  last_merge=InputQueue::Now()-start;
+}
+
+void Canvas::MergeInk(int x1,int y1,int x2,int y2)
+{
+ if (aa!=nullptr)
+ {
+  SDL_Rect r;
+  r.x=x1;
+  r.y=y1;
+  r.w=std::max(x2-x1,0);
+  r.h=std::max(y2-y1,0);
+  aa->Compose(c,buf,vback,r);
+  return;
+ }
  // Bytes per pixel, to know how much we must increment the pointer
  int inc=(buf->pitch/buf->w);
- unsigned char *lim=p+(buf->pitch*(buf->h-menu_height));
- int i;
- int np=0;
- while (p<lim)
- {
-  i=0;
-  while ((*(p+i)==vback[i]) && (i<inc))
-   i++;
-  if (i<inc)
+ x2=std::min(x2,buf->w);
+ y2=std::min(y2,buf->h);
+ if (x2<=x1)
+  return;
+ for (int y=y1;y<y2;y++)
+ {
+  unsigned char *p=(unsigned char *)buf->pixels+(buf->pitch*y)+(inc*x1);
+  unsigned char *q=(unsigned char *)c->pixels+(c->pitch*y)+(inc*x1);
+  unsigned char *lim=p+(inc*(x2-x1));
+  while (p<lim)
   {
-   memcpy(q,p,inc);
-   np++;
+   int i=0;
+   while ((i<inc) && (*(p+i)==vback[i]))
+    i++;
+   if (i<inc)
+    memcpy(q,p,inc);
+   p+=inc;
+   q+=inc;
+  }
+ }
+}
+
+void Canvas::Recompose(SDL_Rect r)
+{
+ if ((hl!=nullptr) && !hl->Empty())
+  hl->Compose(c,back,r);
+ else
+ {
+  SDL_Rect d=r;
+  SDL_BlitSurface(back,&r,c,&d);
+ }
+ MergeInk(r.x,r.y,r.x+r.w,r.y+r.h);
+}
+
+void Canvas::PointerPiece(int x1,int y1,SDL_Rect r)
+{
+ if ((r.w==0) || (r.h==0))
+  return;
+ // What is under the ink will be restored from the copy of the slide
+ StartBack();
+ pointer->Line(x0,y0,x1,y1,PointerSize,PointerSize/2,r,InputQueue::Now());
+ // The older ink in the area may be fading, so it is not blended twice
+ Recompose(r);
+ pointer->Draw(c,r);
+ presenter->Update(r.x,r.y,r.w,r.h);
+}
+
+Uint32 Canvas::PointerWait(void)
+{
+ return pointer->Wait(InputQueue::Now());
+}
+
+void Canvas::FadePointer(void)
+{
+ if (pointer->Empty() || OverlayActive())
+  return;
+ std::vector<SDL_Rect> dirty;
+ pointer->Advance(InputQueue::Now(),dirty);
+ if (dirty.empty())
+  return;
+ // The provisional line keeps what was under it, which is going to change
+ RemovePrediction();
+ RestorePointerAreas(dirty);
+}
+
+void Canvas::RestorePointerAreas(const std::vector<SDL_Rect> &dirty)
+{
+ for (size_t i=0;i<dirty.size();i++)
+ {
+  SDL_Rect r=dirty[i];
+  Recompose(r);
+  pointer->Draw(c,r);
+  presenter->Update(r.x,r.y,r.w,r.h);
+ }
+}
+
+void Canvas::DiscardPointer(bool restore)
+{
+ if (pointer->Empty())
+  return;
+ std::vector<SDL_Rect> dirty;
+ pointer->Clear(dirty);
+ if (restore)
+  RestorePointerAreas(dirty);
+}
+
+bool Canvas::Pan(int dx,int dy)
+{
+ if ((tiles==nullptr) || tracing || OverlayActive() || ((dx==0) && (dy==0)))
+  return false;
+ RemovePrediction();
+ // The ink of the pointer is only on the screen, and it pointed at what was there
+ DiscardPointer(true);
+ // The strokes were drawn with the former view, so they no longer describe the traces that are seen
+ EndStroke();
+ ForgetStrokes();
+
+ // The traces are in the buffer from menu_height up to its height, as MergeInk takes them
+ SDL_Rect a;
+ a.x=0;
+ a.y=menu_height;
+ a.w=scw;
+ a.h=buf->h-menu_height;
+ // The coverage of the highlighter and of the antialiased ink goes with the traces, or they would come back opaque and without highlights
+ Uint8 *planes[TileBoard::NumPlanes];
+ planes[TileBoard::HighlightPlane]=(hl!=nullptr) ? hl->GetMask() : nullptr;
+ planes[TileBoard::InkPlane]=(aa!=nullptr) ? aa->GetCoverage() : nullptr;
+ std::vector<SDL_Rect> strips;
+ PanStrips(dx,dy,strips);
+ for (size_t i=0;i<strips.size();i++)
+  tiles->Store(buf,vback,planes,strips[i],tiles->GetX()+strips[i].x,tiles->GetY()+strips[i].y-menu_height);
+
+ // What is still seen is moved, not composed again
+ ScrollPixels(buf,a,-dx,-dy);
+ ScrollPixels(c,a,-dx,-dy);
+ if (back!=nullptr)
+  ScrollPixels(back,a,-dx,-dy);
+ if (hl!=nullptr)
+  hl->Scroll(a,-dx,-dy);
+ if (aa!=nullptr)
+  aa->Scroll(a,-dx,-dy);
+ tiles->Move(dx,dy);
+
+ // The blank board is white where there are no traces
+ Uint32 white=SDL_MapRGB(c->format,lc[White].r,lc[White].g,lc[White].b);
+ strips.clear();
+ PanStrips(-dx,-dy,strips);
+ for (size_t i=0;i<strips.size();i++)
+ {
+  SDL_Rect r=strips[i];
+  int loaded=tiles->Load(buf,planes,r,tiles->GetX()+r.x,tiles->GetY()+r.y-menu_height);
+  if ((hl!=nullptr) && (loaded & (1<<TileBoard::HighlightPlane)))
+   hl->SetCovered();
+  SDL_Rect d=r;
+  if (back!=nullptr)
+  {
+   // The highlights are blended over the clean board
+   SDL_FillRect(back,&d,white);
+   Recompose(r);
+  }
+  else
+  {
+   SDL_FillRect(c,&d,white);
+   MergeInk(r.x,r.y,r.x+r.w,r.y+r.h);
+  }
+ }
+ Update(Buffer);
+ return true;
+}
+
+void Canvas::PanStrips(int dx,int dy,std::vector<SDL_Rect> &s)
+{
+ SDL_Rect a;
+ a.x=0;
+ a.y=menu_height;
+ a.w=scw;
+ a.h=buf->h-menu_height;
+ // When the view moves more than the screen, all of it leaves
+ if ((abs(dx)>=int(a.w)) || (abs(dy)>=int(a.h)))
+ {
+  s.push_back(a);
+  return;
+ }
+ if (dy!=0)
+ {
+  SDL_Rect r=a;
+  r.h=Uint16(abs(dy));
+  if (dy<0)
+   r.y=Sint16(a.y+a.h+dy);
+  s.push_back(r);
+ }
+ if (dx!=0)
+ {
+  SDL_Rect r=a;
+  r.w=Uint16(abs(dx));
+  if (dx<0)
+   r.x=Sint16(a.x+a.w+dx);
+  s.push_back(r);
+ }
+}
+
+void Canvas::ScrollPixels(SDL_Surface *s,SDL_Rect r,int dx,int dy)
+{
+ if ((abs(dx)>=int(r.w)) || (abs(dy)>=int(r.h)))
+  return;
+ int inc=s->format->BytesPerPixel;
+ // Columns that receive pixels, and the number of bytes of each row that are moved
+ int xd=r.x+std::max(dx,0);
+ int xs=r.x+std::max(-dx,0);
+ size_t n=size_t(r.w-abs(dx))*size_t(inc);
+ int rows=r.h-abs(dy);
+ SDL_LockSurface(s);
+ unsigned char *pixels=(unsigned char *)s->pixels;
+ // Rows are moved in the order that does not overwrite those still to be moved
+ for (int k=0;k<rows;k++)
+ {
+  int yd=(dy>0) ? r.y+r.h-1-k : r.y+k;
+  memmove(pixels+s->pitch*yd+inc*xd,pixels+s->pitch*(yd-dy)+inc*xs,n);
+ }
+ SDL_UnlockSurface(s);
+}
+
+void Canvas::StartHighlights(void)
+{
+ if (hl!=nullptr)
+  return;
+ hl=new HighlightLayer(c->format,scw,sch,hl_color);
+ StartBack();
+}
+
+void Canvas::StartBack(void)
+{
+ if (back!=nullptr)
+  return;
+ // The slide is what the canvas shows where there are no traces. Under the traces it is not known, and it is taken as white,
+ // as the eraser would leave it.
+ back=NewSurface(scw,sch);
+ SDL_BlitSurface(c,nullptr,back,nullptr);
+ Uint32 white=SDL_MapRGB(back->format,lc[White].r,lc[White].g,lc[White].b);
+ int inc=(buf->pitch/buf->w);
+ SDL_Rect px;
+ px.w=px.h=1;
+ for (int y=menu_height;y<buf->h;y++)
+ {
+  unsigned char *p=(unsigned char *)buf->pixels+(buf->pitch*y);
+  for (int x=0;x<buf->w;x++,p+=inc)
+  {
+   int i=0;
+   while ((i<inc) && (*(p+i)==vback[i]))
+    i++;
+   if (i<inc)
+   {
+    px.x=x;
+    px.y=y;
+    SDL_FillRect(back,&px,white);
+   }
   }
-  p+=inc;
-  q+=inc;
  }
 }
 
@@ -721,13 +1468,22 @@ void Canvas::ExecuteCommand(Config::Commands command,SDL_Surface *cs)
         SetTracing(false);
         ToggleDrawmode();
         break;
+  case Config::ToggleHighlighter:
+        SetTracing(false);
+        ToggleHighlighter();
+        break;
+  case Config::TogglePointer:
+        SetTracing(false);
+        TogglePointer();
+        break;
   case Config::LineCharac:
+        // The choice box keeps what it hides, so the slide is not needed to redraw when it is closed
         ChangeLineCharac();
-        Show(cs);
-        Merge();
-        Update(Both);
         break;
   case Config::EraseAll:
+        // The traces out of the view are erased too
+        if (tiles!=nullptr)
+         tiles->Clear();
         Erase(Both);
         Update(Both);
         break;
@@ -737,6 +1493,8 @@ void Canvas::ExecuteCommand(Config::Commands command,SDL_Surface *cs)
         Update(Both);
         break;
   case Config::EraseBlackb:
+        if (tiles!=nullptr)
+         tiles->Clear();
         Erase(Both);
         Show(cs);
         Merge();
@@ -744,9 +1502,12 @@ void Canvas::ExecuteCommand(Config::Commands command,SDL_Surface *cs)
         break;
   case Config::SaveBlackb:
         SaveBlackboard();
-        Show(cs);
-        Merge();
-        Update(Both);
+        break;
+  case Config::ToggleHud:
+        // The HUD is drawn by main, which knows the figures, as soon as it is active. When it is hidden, the menu comes back.
+        hud=!hud;
+        if (!hud)
+         RedrawMenu();
         break;
   case Config::Quit:
         break;
@@ -759,15 +1520,14 @@ void Canvas::ExecuteCommand(Config::Commands command,SDL_Surface *cs)
 
 void Canvas::Prepare(Config &cfg,SDL_Surface *sp,SDL_Surface *sl)
 {
- if ( cfg.GetShowSplash() )
- {
-  ShowSplash(sp);
-  Erase(Slide);
- }
- 
  SetMenu(cfg.GetMenuItems());
  
  Show(sl);
+ Merge();
  
- Update(Both);
+ // The splash screen is shown over the first slide, which will appear when it is closed
+ if ( cfg.GetShowSplash() && (sp!=nullptr) )
+  ShowSplash(sp);
+ else
+  Update(Both);
 }
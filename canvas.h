@@ -19,12 +19,20 @@
 #define CANVAS_H
 
 #include "config.h"
+#include "glyphatlas.h"
+#include "scheduler.h"
+#include "presenter.h"
+#include "profiler.h"
+#include "stroke.h"
+#include "highlight.h"
+#include "antialias.h"
+#include "pointer.h"
+#include "tileboard.h"
 
 // All include needed hare are already included by config.h, except SDL.h, SDL_image.h and SDL_ttf.h
 // but SDL.h and SDL_image.h are already included by SDL_ttf.h
 #include <SDL/SDL_ttf.h>
 
-#include <SDL/SDL_syswm.h>
 /*! \brief Class to manage the graphical SDL surface(s) that are being displayed and their overlays.
  *
  * This class is constructed with the configuration file name as argument, since it needs several values
@@ -35,6 +43,17 @@
  * the pen. The inconvenient is that they have to be appropriately merged before being shown; the advantages
  * are that they can be shown or erased sepparately, which is a good feature for presentations.
  *
+ * Where the canvas is presented (a window, the full screen or, for automated runs, just memory) is decided by its Presenter.
+ *
+ * The translucent strokes of the highlighter are kept apart, in a HighlightLayer, and blended over a copy of the slide as it
+ * was shown, below the traces of the pen. That copy and the layer are only created when the highlighter is first used.
+ * The copy is also used to blend the soft edges of the traces, when the configuration asks for antialiasing, and to restore
+ * what is under the ink of the pointer as it fades out.
+ *
+ * The blank boards can be larger than the screen. Then, the canvas is given a TileBoard, which keeps the traces out of the view
+ * with their highlights and the coverage of their soft edges, and panning scrolls what is already on the screen and composes
+ * only the strip that enters it.
+ *
 */
 class Canvas
 {
@@ -46,6 +65,16 @@ class Canvas
      */
     enum ColDefs { Red, Green, Blue, Black, White, PaleBlue, Yellow, Orange, NumCols };
 
+    /**
+     * The maximum width of the drawing line, in pixels
+     */
+    static const int MaxLWidth = 8;
+
+    /**
+     * Pixels that the view moves with each step of the wheel of the mouse, when the drawing area can be panned
+     */
+    static const int PanStep = 64;
+
     /**
      * The color of the eraser
      */
@@ -57,9 +86,22 @@ class Canvas
     enum UpdatableObjects { Slide, Buffer, Both };
 
     /**
-     * Possible modes of working at any moment (only two: we can be drawing, or erasing).
+     * Possible modes of working at any moment: we can be drawing, erasing, highlighting or pointing (with ink that fades out).
      */
-    enum Modes { Drawing, Erasing };
+    enum Modes { Drawing, Erasing, Highlighting, Pointing };
+
+    /**
+     * Possible pop-up elements (overlays) that can be shown over the canvas. While one of them is shown, it receives all the events.
+     *
+     * NoOverlay: nothing is shown; events are for the canvas or the slides, as usual
+     *
+     * SplashOverlay: the splash screen, which is closed by any key press or click
+     *
+     * ConfirmOverlay: a message (like the confirmation of a saved blackboard) which is closed by clicking on its box
+     *
+     * LineCharacOverlay: the box to choose the color and width of the drawing line, which is closed by clicking on its OK button
+     */
+    enum Overlays { NoOverlay, SplashOverlay, ConfirmOverlay, LineCharacOverlay };
 
     /**
      * Constructor
@@ -77,12 +119,55 @@ class Canvas
     
     /**
      * It shows in the window or screen the surface that is passed
-     * \param s The surface to be drawn
-     *
-     * Side effects: once shown, a call to SDL_FreeSurface is done on the received variable, so that memory is kept at any moment low.
+     * \param s The surface to be drawn. It is not freed, since slides belong to the page cache of PDFSlides.
      */
     void Show(SDL_Surface *s);
 
+    /**
+     * Gets where Show puts a surface
+     * \param s The surface of a slide
+     * \return The area of the canvas that it covers
+     */
+    SDL_Rect SlideRect(SDL_Surface *s);
+
+    /**
+     * Gets the area of the canvas under the menu, where slides and traces are drawn
+     * \return The area
+     */
+    SDL_Rect GetDrawingArea(void) { SDL_Rect r; r.x=0; r.y=Sint16(menu_height); r.w=Uint16(scw); r.h=Uint16(sch-menu_height); return r; };
+
+    /**
+     * Shows a view composed outside (a zoomed slide) in the drawing area, instead of the slide and its traces. They are kept,
+     * and they are seen again when the slide is shown and merged.
+     * \param v The view, as large as the drawing area. It is not freed.
+     */
+    void ShowView(SDL_Surface *v) { SDL_Rect r=GetDrawingArea(); r.x=r.y=0; ShowView(v,r); };
+
+    /**
+     * Shows an area of a view composed outside, leaving the rest of the drawing area as it is
+     * \param v The view, as large as the drawing area. It is not freed.
+     * \param r The area, in coordinates of the view
+     */
+    void ShowView(SDL_Surface *v,SDL_Rect r);
+
+    /**
+     * Writes a text in black, with the font of the menu, on a surface composed outside (a view)
+     * \param dst The surface, which must have the pixel format of the canvas
+     * \param s The text, in UTF-8
+     * \param x The x coordinate of the upper-left corner of the text
+     * \param y The y coordinate of the upper-left corner of the text
+     * \return The width of the text, in pixels
+     */
+    int DrawText(SDL_Surface *dst,const std::string &s,int x,int y) { return atlas->Draw(dst,s,x,y,Black); };
+
+    /**
+     * Gets the size of the texts written by DrawText
+     * \param s The text, in UTF-8
+     * \param w Its width, in pixels
+     * \param h Its height, in pixels (that of the font)
+     */
+    void TextSize(const std::string &s,int &w,int &h) { w=atlas->TextWidth(s); h=atlas->Height(); };
+
     /**
      * It updates the thing or things that needs to be updated/redrawn. 
      * \param what One value of Slide, Buffer or Both
@@ -112,10 +197,10 @@ class Canvas
     Config::Commands GetPosCode(int x,int y,bool &to_canvas);
     
     /**
-     * Procedure to set the tracing mode.
+     * Procedure to set the tracing mode. When tracing stops, the last piece of a smoothed stroke is drawn.
      * \param b true to start tracing (i.e.: a line is drawn following the movement of the pen), false to stop tracing mode.
      */
-    void SetTracing(bool b)   { tracing=b; TracingSetcolor(); return; };
+    void SetTracing(bool b);
     
     /**
      * Get the current state of the tracing mode
@@ -128,16 +213,91 @@ class Canvas
      * \param x Value of coordinate x to be set
      * \param y Value of coordinate y to be set
      * 
-     * Side effect: the internal state is updated with the new coordinates.
+     * Side effect: the internal state is updated with the new coordinates, and the former stroke (if any) is finished.
      */
-    void SetCoords(int x,int y) { x0=x; y0=y; return; };
+    void SetCoords(int x,int y) { EndStroke(); x0=x; y0=y; last_x=x; last_y=y; if (smoother!=nullptr) smoother->Begin(x,y); return; };
     
     /**
-     * Procedure to draw a straight line from the current pen position to the requested point
+     * Procedure to draw a line from the current pen position to the requested point. It is straight, unless the configuration asks
+     * for smoothing: then the curve through the former positions is drawn up to the former one, and the last stretch only on the screen.
      * \param x1 Value of coordinate x of the end of the line
      * \param y1 Value of coordinate y of the end of the line
      */
     void Drawline(int x1,int y1);
+
+    /**
+     * Sets the board of tiles where the traces out of the view are kept, so that the drawing area can be panned
+     * \param t The board of tiles (which is not freed by the canvas), or nullptr so that the drawing area cannot be panned, as with the slides
+     */
+    void SetTileBoard(TileBoard *t) { tiles=t; panning=false; };
+
+    /**
+     * Tells if the drawing area can be panned
+     * \return true if it has a board of tiles
+     */
+    bool Pannable(void) { return (tiles!=nullptr); };
+
+    /**
+     * Moves the view over the board. The traces that leave the screen are kept in the tiles, what is still seen is scrolled and only
+     * the strips that enter the screen are composed from the tiles.
+     * \param dx Pixels that the view moves to the right (negative to the left)
+     * \param dy Pixels that the view moves down (negative up)
+     * \return true if the view has moved, false if the drawing area cannot be panned now (there are no tiles, or a trace or a box is in the way)
+     */
+    bool Pan(int dx,int dy);
+
+    /**
+     * Procedure to start dragging the board with the mouse, if it can be panned
+     * \param x Value of coordinate x of the mouse
+     * \param y Value of coordinate y of the mouse
+     */
+    void StartPan(int x,int y) { if (Pannable() && !tracing) { panning=true; pan_x=x; pan_y=y; } };
+
+    /**
+     * Procedure to drag the board, so that the point under the mouse when dragging started follows it
+     * \param x Value of coordinate x of the mouse
+     * \param y Value of coordinate y of the mouse
+     */
+    void PanTo(int x,int y) { if (panning && Pan(pan_x-x,pan_y-y)) { pan_x=x; pan_y=y; } };
+
+    /**
+     * Procedure to stop dragging the board
+     */
+    void EndPan(void) { panning=false; };
+
+    /**
+     * Tells if the board is being dragged
+     * \return true if it is
+     */
+    bool GetPanning(void) { return panning; };
+
+    /**
+     * Procedure to draw, only on the screen, a provisional line from the current pen position to where the pen is predicted to be.
+     * It is called after Drawline, and the provisional line is removed (restoring what was under it) before anything else is drawn.
+     * It does nothing if the configuration does not ask for prediction, or when erasing.
+     * \param x Value of coordinate x of the last position read from the pen
+     * \param y Value of coordinate y of the last position read from the pen
+     * \param stamp The moment that position was read, as given by InputQueue::Now
+     */
+    void Predict(int x,int y,Uint64 stamp);
+
+    /**
+     * Gets how long the main loop may sleep before the ink of the pointer has to change
+     * \return Milliseconds, or SDL_MUTEX_MAXWAIT if there is no ink of the pointer
+     */
+    Uint32 PointerWait(void);
+
+    /**
+     * Fades out the ink of the pointer as time goes by. Only the areas that change are restored and presented. It does nothing
+     * while an overlay is shown; the ink catches up when it is closed.
+     */
+    void FadePointer(void);
+
+    /**
+     * Procedure to set the width of the drawing line, as it is done from the line characteristics box
+     * \param w The width in pixels, between 1 and MaxLWidth
+     */
+    void SetLineWidth(int w) { if ((w>=1) && (w<=MaxLWidth)) line_width=w; };
     
     /**
      * Procedure to merge the two surfaces (slides and pen traces) and show them in the window or screen. The traces are set after the slides, so they are always seen
@@ -145,25 +305,43 @@ class Canvas
     void Merge(void);
     
     /**
-     * Procedure to show the splash screen
+     * Procedure to show the splash screen. It is shown as an overlay, which is closed by the first key press or click.
+     * \param spls The surface of the splash screen. It is freed once drawn.
      */
     void ShowSplash(SDL_Surface *spls);
 
+    /**
+     * Tells if an overlay (splash screen, message or choice box) is being shown. In such a case, events must be passed to OverlayEvent instead of being processed as usual.
+     * \return true if an overlay is shown
+     */
+    bool OverlayActive(void) { return (overlay!=NoOverlay); };
+
+    /**
+     * Procedure to pass an event to the overlay being shown. If the event closes the overlay, what was under it is restored.
+     * \param ev The event, as received by the main loop
+     */
+    void OverlayEvent(const SDL_Event &ev);
+
     /** 
-     * Procedure to draw the upper menu
+     * Procedure to compose and draw the upper menu. The composed menu is kept, so that later redraws are a single blit.
      * \param mitems A vector of strings with the texts to be written in each menu entry, ordered as they must be shown.
      */
     void SetMenu(const std::vector<std::string> &mitems);
+
+    /**
+     * Procedure to redraw the upper menu (as composed by SetMenu) together with the squares that show the drawing mode
+     */
+    void RedrawMenu(void);
     
     /**
      * Procedure to be called at the end of the program to close gracefully the SDL library and free the used surfaces.
      */
-    void EndSDL(void) { SDL_Quit(); }
+    void EndSDL(void);
   
     /** 
      * Procedure to execute a command requested by main
      * \param c Command to be executed
-     * \param s SDL_Surface to be redrawn, if needed
+     * \param s SDL_Surface to be redrawn, if needed. It is not freed.
      */
     void ExecuteCommand(Config::Commands com,SDL_Surface *s);
     
@@ -177,45 +355,247 @@ class Canvas
      * \param sl  Pointer to the surface of the first slide, or null if no slides have been loaded
      */
      void Prepare(Config &cfg,SDL_Surface *sp,SDL_Surface *sl);
+
+    /**
+     * Gets the surface with the user's traces, so that they can be stored or restored from outside (by the session store)
+     * \return The internal buffer of traces. It has the same width as the canvas and its rows have the same coordinates as those of the screen.
+     */
+    SDL_Surface *GetInk(void) { return buf; };
+
+    /**
+     * Gets the bytes that make up a background (non traced) pixel of the buffer of traces
+     * \return Pointer to the bytes of a background pixel (as many as bytes per pixel has the buffer)
+     */
+    const unsigned char *GetInkBackground(void) { return vback; };
+
+    /**
+     * Gets the strokes of the highlighter, so that they can be blended over a view composed outside (a zoomed slide)
+     * \return The layer of the highlights, or nullptr if the highlighter has not been used yet
+     */
+    HighlightLayer *GetHighlights(void) { return hl; };
+
+    /**
+     * Tells if the traces have been modified (drawn or erased) since the last call to SetInkChanged(false)
+     * \return true if the traces have changed
+     */
+    bool GetInkChanged(void) { return ink_changed; };
+
+    /**
+     * Sets or resets the mark of modified traces. It is reset by the session store when it keeps or restores the traces of a slide.
+     * \param b New value of the mark
+     */
+    void SetInkChanged(bool b) { ink_changed=b; };
+
+    /**
+     * Asks the canvas to keep the strokes drawn since the traces were last erased, so that they can be stored instead of the pixels.
+     * It is done by the session store, if sessions are kept.
+     * \param b true to keep the strokes
+     */
+    void SetKeepStrokes(bool b) { keep_strokes=b; if (!b) ForgetStrokes(); };
+
+    /**
+     * Tells if the traces are exactly those drawn by the kept strokes, so that the strokes can be stored instead of the pixels
+     * \return true if the strokes are kept and nothing else has changed the traces since they were last erased
+     */
+    bool GetStrokesValid(void) { return keep_strokes && strokes_valid; };
+
+    /**
+     * Gets the kept strokes, once simplified. The stroke being drawn, if any, is finished first (the pen may go on with another one).
+     * \return The strokes, in the order they were drawn
+     */
+    const std::vector<Stroke> &GetStrokes(void) { EndStroke(); return strokes; };
+
+    /**
+     * Draws strokes in the buffer of traces (not on the screen; a Merge is needed to see them) and keeps them as if they had been drawn with the pen
+     * \param s The strokes
+     */
+    void DrawStrokes(const std::vector<Stroke> &s);
+
+    /**
+     * Notes that the traces have been changed by other means than strokes (like the restoring of a session stored as pixels), so
+     * the strokes no longer describe them. This lasts until the traces are erased.
+     */
+    void ForgetStrokes(void) { strokes.clear(); stroke.points.clear(); strokes_valid=false; };
+
+    /**
+     * Tells if SDL pumps the events in its own thread, so that they can be read from a thread different from the main one
+     * \return true if SDL was initialized with its event thread
+     */
+    bool GetThreadedEvents(void) { return presenter->ThreadedEvents(); };
+
+    /**
+     * Gets the presenter of the canvas
+     * \return The presenter (a window or screen, or an offscreen one in memory)
+     */
+    Presenter *GetPresenter(void) { return presenter; };
+
+    /**
+     * Sets the scheduler to which the saving of blackboards is submitted. Without scheduler, they are saved in the main thread.
+     * \param s The scheduler, or nullptr
+     */
+    void SetScheduler(Scheduler *s) { sched=s; };
+
+    /**
+     * Sets the profiler that measures showing, merging, updating and saving
+     * \param p The profiler, or nullptr not to measure anything
+     */
+    void SetProfiler(Profiler *p) { prof=p; };
+
+    /**
+     * Tells if the performance figures (the HUD) are shown in the menu bar
+     * \return true if they are shown
+     */
+    bool HudActive(void) { return hud; };
+
+    /**
+     * Writes the performance figures in the menu bar, instead of the menu. Only the menu bar is updated.
+     * \param s The text with the figures
+     */
+    void DrawHud(const std::string &s);
+
+    /**
+     * Gets the number of frames drawn: lines traced and updates of the drawing area or the whole canvas
+     * \return Number of frames since the program started
+     */
+    Uint64 GetFrames(void) { return frames; };
+
+    /**
+     * Gets the time taken by the last merge done while the HUD was shown
+     * \return Nanoseconds
+     */
+    Uint64 GetLastMergeTime(void) { return last_merge; };
+
+    /**
+     * Gets the memory used by the buffer of traces and by the kept strokes
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void);
+
+    /**
+     * Shows the first of the messages left by the jobs of the scheduler (like the end of a save), if any. To be called when no overlay is active.
+     */
+    void ShowNotification(void);
+
+    /**
+     * Writes the canvas (slide plus traces, without the menu) to a pnm file, in the calling thread
+     * \param fn Name of the file
+     * \return true if the file has been written, false on error
+     */
+    bool WriteImage(const std::string &fn);
+
+    /**
+     * Writes the canvas (slide plus traces, without the menu) in pnm format to a stream, in the calling thread
+     * \param f The stream
+     */
+    void WriteImage(std::ostream &f);
     
  private:
     static const int MinLDis = 4;
-    static const int MaxLWidth = 8;
+    // Tolerance of the simplification of strokes, as a fraction of the size of the brush (but never below half a pixel)
+    static constexpr double SimplifyTolerance = 0.25;
+    // Width of the lines of the pointer
+    static const int PointerSize = 6;
     
     inline bool Inside(int x,int y,SDL_Rect &r) { return ((x>=r.x) && (x<=r.x+r.w) && (y>=r.y) && (y<=r.y+r.h)); };
 
-    void DrawConfirmBoxAndWait(const std::string &fn,const std::string &message);
+    void DrawConfirmBox(const std::string &fn,const std::string &message);
     
-    void TextWithHighlight(const std::string &s,int r,int c,int d,int h);
+    void TextWithHighlight(SDL_Surface *dst,const std::string &s,int r,int c);
     
     void ToggleDrawmode(void) { if (drawstate==Drawing) drawstate=Erasing; else drawstate=Drawing; DrawmodeSetcolor(); };
+
+    void ToggleHighlighter(void) { if (drawstate==Highlighting) drawstate=Drawing; else drawstate=Highlighting; DrawmodeSetcolor(); };
+
+    void TogglePointer(void) { if (drawstate==Pointing) drawstate=Drawing; else drawstate=Pointing; DrawmodeSetcolor(); };
     
+    // Opens the line characteristics choice box, and processes the clicks on it
     void ChangeLineCharac(void);
+    void DrawLineCharac(void);
+    void LineCharacClick(int x,int y);
+
+    // Creates a surface with the same size and pixel format as the canvas, exiting on failure
+    SDL_Surface *NewSurface(int w,int h);
+
+    // Copies the drawing area of the canvas (slide plus traces) into a new surface
+    SDL_Surface *Snapshot(void);
+
+    // Opens an overlay, keeping a copy of the area of the canvas that it will hide, and closes it restoring that area
+    void OpenOverlay(Overlays o,SDL_Rect r);
+    void CloseOverlay(void);
     
     /*
-     * Procedure to show the box that asks for user confirmation to save a blackboard as a graphical file and, if confirmed, does it
+     * Procedure to save a blackboard as a graphical file.
      * This procedure shows a message with the confirmation of saving or an error if the file has not been saved. Both messages are got
      * from the configuration file and atored inside canvas in the constructor.
      */
     void SaveBlackboard(void);
     
     // Changes the color of the small square in the upper-left corner form red to green when erasing or drawing
+    // (or to that of the highlighter when highlighting)
     void DrawmodeSetcolor(void);
+
+    // The color of that square for the current mode
+    Uint32 ModeColor(void);
     
     // Changes tho color of the even smaller squere inside the former one from black to red/green when tracing or not
     void TracingSetcolor(void);
     
     // Auxiliary function to draw a rectangle filled with the erase color
     void Drawrect(SDL_Rect r);
+
+    // Auxiliary function to draw a straight piece of line from the end of the former one, in the traces and on the screen
+    void Segment(int x1,int y1);
+
+    // Auxiliary function to draw a straight line with a square brush, without its last point
+    void RasterLine(SDL_Surface *s,int xa,int ya,int xb,int yb,int size,int offset,Uint32 color);
+
+    // Auxiliary function to simplify and keep the stroke being drawn, if any
+    void EndStroke(void);
+
+    // Auxiliary function to create the copy of the slide as it is shown, if it does not exist yet
+    void StartBack(void);
+
+    // Auxiliary function to create the highlight layer (and the copy of the slide under it), if they do not exist yet
+    void StartHighlights(void);
+
+    // Auxiliary function to copy the traces over the canvas, in the area from (x1,y1) to (x2,y2) (not included)
+    void MergeInk(int x1,int y1,int x2,int y2);
+
+    // Auxiliary function to compose an area of the canvas again from the copy of the slide: highlights, and traces over them
+    void Recompose(SDL_Rect r);
+
+    // Auxiliary function to get the strips of the drawing area that leave the screen when the view moves by (dx,dy)
+    // (those that enter it are the strips for (-dx,-dy))
+    void PanStrips(int dx,int dy,std::vector<SDL_Rect> &s);
+
+    // Auxiliary function to move the pixels of an area of a surface by (dx,dy), within that area. Those uncovered are left as they are.
+    static void ScrollPixels(SDL_Surface *s,SDL_Rect r,int dx,int dy);
+
+    // Auxiliary function to draw a piece of the ink of the pointer, only on the screen, and to give it to the trail
+    void PointerPiece(int x1,int y1,SDL_Rect r);
+
+    // Auxiliary function to restore some areas of the canvas, with the ink of the pointer that is still seen over them
+    void RestorePointerAreas(const std::vector<SDL_Rect> &dirty);
+
+    // Auxiliary function to drop the ink of the pointer. If restore is true, what is under it is shown again.
+    void DiscardPointer(bool restore);
+
+    // Auxiliary function to draw, only on the screen, the provisional line from the end of the traces to the last position
+    // of the pen (if strokes are smoothed) and to the predicted one (if ahead is true)
+    void DrawProvisional(bool ahead,int px,int py);
+
+    // Auxiliary function to remove the provisional line from the screen, restoring what was under it
+    void RemovePrediction(void);
         
     // Auxiliary function to initialize som variables used to draw the line characteristics choice box
     void InitLC(void);
     
-    // Procedure to write the current canvas (slides plus traces) to a pnm file 
-    void WritePnm(std::ofstream &f);
+    // Procedure to write a copy of the canvas (slides plus traces) to a pnm file 
+    void WritePnm(std::ostream &f,SDL_Surface *s);
 
     // The following internal variables are initialized in the constructor
     int last_saved;
+    Presenter *presenter;
     int scw,sch;
     int menu_height;
     SDL_Surface *c;
@@ -224,9 +604,16 @@ class Canvas
     Uint32 line_draw_index,line_draw_col,line_erase_col;
     
     TTF_Font *tf;
+
+    // All texts are written with the glyphs of this atlas, which are rendered only once
+    GlyphAtlas *atlas;
+
+    // The upper menu, already composed by SetMenu
+    SDL_Surface *menubar;
     
     Modes drawstate;
     bool tracing;
+    bool ink_changed;
     int line_width;
     int er_size;
     
@@ -248,9 +635,62 @@ class Canvas
  
     SDL_Rect choicerect,colrect[NumCols],linerect[MaxLWidth],lines[MaxLWidth],ok,defcol,defline;
  
-    SDL_Surface *text;
- 
     SDL_Rect oktext;
+
+    // The overlay being shown, the copy of what is under it and the place of that copy in the canvas
+    Overlays overlay;
+    SDL_Surface *under;
+    SDL_Rect under_rect;
+
+    // The OK box of the confirmation message, the only place where a click closes it
+    SDL_Rect confirm_ok;
+
+    // Background saves are submitted here. Their messages (file name and text) wait in notifications until they can be shown.
+    Scheduler *sched;
+    std::deque< std::pair<std::string,std::string> > notifications;
+
+    Profiler *prof;
+
+    // The HUD, and what it shows that is measured here
+    bool hud;
+    Uint64 frames;
+    Uint64 last_merge;
+
+    // Prediction of the pen (nullptr if it is not used), and what is under the provisional line while it is on the screen
+    StrokePredictor *predictor;
+    SDL_Surface *pred_under;
+    SDL_Rect pred_rect;
+    bool predicted;
+
+    // Smoothing of the strokes (nullptr if it is not used), the points it gives, and the last position of the pen, up to which
+    // the traces do not arrive yet
+    StrokeSmoother *smoother;
+    std::vector<StrokePoint> smoothed;
+    int last_x,last_y;
+
+    // Strokes drawn since the traces were last erased (if they are kept), and the one being drawn. They are valid while
+    // nothing else has changed the traces.
+    bool keep_strokes;
+    bool strokes_valid;
+    std::vector<Stroke> strokes;
+    Stroke stroke;
+
+    // Strokes of the highlighter, and the slide as it is shown, under them and under the traces (both nullptr until they are used)
+    HighlightLayer *hl;
+    SDL_Surface *back;
+    SDL_Color hl_color;
+
+    // Coverage of the pixels of the traces, if they are antialiased (nullptr otherwise)
+    InkCoverage *aa;
+
+    // The ink of the pointer
+    PointerTrail *pointer;
+
+    // The traces out of the view, when the drawing area can be panned (nullptr otherwise), and the last position of the mouse while
+    // it drags the board
+    TileBoard *tiles;
+    bool panning;
+    int pan_x,pan_y;
 };
 
 #endif
@@ -17,6 +17,10 @@
  ***************************************************************************/
 #include "config.h"
 
+// The messages of the search when the language file has none, in the order of Config::SearchMessages
+static const char *DefaultSearchMessages[Config::NumSearchMessages]=
+{ "Search: %s", "type the words to find", "no slides", "%s slide:", "%s slides:", "indexed %s" };
+
 Config::Config(void)
 {
  // Fill default values
@@ -29,12 +33,54 @@ Config::Config(void)
  eraser_size=DefaultEraserSize;
  eraser_shape=DefaultEraserShape;
  lang_file=std::string(DefaultGlobalConfigDir)+std::string(LangFileNameGlobal);
+ save_session=false;
+ statistics=false;
+ profile_file="";
+ pen_prediction=0;
+ stroke_smoothing=false;
+ ink_antialiasing=false;
+ pointer_time=DefaultPointerTime;
+ headless=false;
+ headless_bpp=32;
+ headless_bgr=false;
+ cache_dir=std::string(getenv("HOME"))+"/"+DefaultCacheDir;
 
  SearchConfigFile();
  SearchLangMenuFile();
  ParseConfigFile();
+ search_items.assign(DefaultSearchMessages,DefaultSearchMessages+NumSearchMessages);
  ReadLangSection();
 
+ if (headless)
+  SetHeadless(true);
+
+}
+
+Config::Config(int w,int h,int bpp,bool bgr)
+{
+ in_window=true;
+ show_splash=false;
+ font_dir=DefaultFontDir;
+ font_name=DefaultFont;
+ font_size=DefaultFontSize;
+ eraser_size=DefaultEraserSize;
+ eraser_shape=DefaultEraserShape;
+ save_session=false;
+ statistics=false;
+ profile_file="";
+ pen_prediction=0;
+ stroke_smoothing=false;
+ ink_antialiasing=false;
+ pointer_time=DefaultPointerTime;
+ headless=true;
+ headless_bpp=bpp;
+ headless_bgr=bgr;
+ cache_dir=std::string(getenv("HOME"))+"/"+DefaultCacheDir;
+ SetRes(w,h);
+
+ sitems.push_back("Current blackboard saved in file %s");
+ sitems.push_back("Could not write file %s. Blackboard NOT saved.");
+ search_items.assign(DefaultSearchMessages,DefaultSearchMessages+NumSearchMessages);
 }
 
 std::string Config::SearchConfigFile(void)
@@ -353,6 +399,125 @@ Config::ValidityValues Config::ValidContent(const std::string &p,const std::stri
 	 return ValidPair;
 	 break;
  	}
+  case SaveSession:
+	{
+	 if (v=="yes")
+	 {
+	  save_session=true;
+	  return ValidPair;
+	 }
+	 if (v=="no")
+	 {
+	  save_session=false;
+	  return ValidPair;
+	 }
+	 return InvalidValue;
+	 break;
+	}
+  case CacheDir:
+	{
+	 if (v.empty())
+	  return InvalidValue;
+	 cache_dir=v;
+	 if (cache_dir.find_last_of('/')!=cache_dir.size()-1)
+	  cache_dir=cache_dir+std::string("/");
+	 return ValidPair;
+	 break;
+	}
+  case Statistics:
+	{
+	 if (v=="yes")
+	 {
+	  statistics=true;
+	  return ValidPair;
+	 }
+	 if (v=="no")
+	 {
+	  statistics=false;
+	  return ValidPair;
+	 }
+	 return InvalidValue;
+	 break;
+	}
+  case Headless:
+	{
+	 if (v=="yes")
+	 {
+	  headless=true;
+	  return ValidPair;
+	 }
+	 if (v=="no")
+	 {
+	  headless=false;
+	  return ValidPair;
+	 }
+	 return InvalidValue;
+	 break;
+	}
+  case ProfileFile:
+	{
+	 if (v.empty())
+	  return InvalidValue;
+	 profile_file=(v=="None") ? "" : v;
+	 return ValidPair;
+	 break;
+	}
+  case PenPrediction:
+	{
+	 char *p;
+	 long converted = strtol(v.c_str(),&p,10);
+	 if ((*p == '\0') && (converted>=0) && (converted<=MaxPenPrediction))
+	 {
+	  pen_prediction = unsigned(converted);
+	  return ValidPair;
+	 }
+	 else
+	  return InvalidValue;
+	 break;
+	}
+  case StrokeSmoothing:
+	{
+	 if (v=="yes")
+	 {
+	  stroke_smoothing=true;
+	  return ValidPair;
+	 }
+	 if (v=="no")
+	 {
+	  stroke_smoothing=false;
+	  return ValidPair;
+	 }
+	 return InvalidValue;
+	 break;
+	}
+  case InkAntialiasing:
+	{
+	 if (v=="yes")
+	 {
+	  ink_antialiasing=true;
+	  return ValidPair;
+	 }
+	 if (v=="no")
+	 {
+	  ink_antialiasing=false;
+	  return ValidPair;
+	 }
+	 return InvalidValue;
+	 break;
+	}
+  case PointerTime:
+	{
+	 char *p;
+	 long converted = strtol(v.c_str(),&p,10);
+	 if ((*p == '\0') && (converted>=MinPointerTime) && (converted<=MaxPointerTime))
+	 {
+	  pointer_time = unsigned(converted);
+	  return ValidPair;
+	 }
+	 else
+	  return InvalidValue;
+	 break;
+	}
   case UnknownParam: return InvalidParam; break;
   default: // We should never have arrived here, but..
 	  return InvalidParam; break;
@@ -367,6 +532,22 @@ Config::ValidityValues Config::ValidContent(const std::string &p,const std::stri
  }
 }
 
+void Config::SetHeadless(bool h)
+{
+ headless=h;
+ // Without display there is nobody to close the splash screen, and no screen whose resolution could be taken.
+ if (headless)
+ {
+  show_splash=false;
+  if (!in_window)
+  {
+   in_window=true;
+   scw=DefaultXRes;
+   sch=DefaultYRes;
+  }
+ }
+}
+
 void Config::SetRes(int w,int h)
 { 
  scw=w;
@@ -440,7 +621,8 @@ void Config::ReadLangSection()
  do
  {
   getline(f,item);
-  if (!f.eof())
+  nline++;
+  if (LineHasInfo(item,lang_file,nline) && item!="SEARCH")
   {
    if (item.find("%s")==std::string::npos)
    {
@@ -450,12 +632,40 @@ void Config::ReadLangSection()
    sitems.push_back(item);
   }
  }
- while (!f.eof());
+ while (!f.eof() && item!="SEARCH");
  if (sitems.size()<2)
  {
   std::cerr << "Error reading language file " << lang_file << ". Less than two strings in the SAVE section.\n";
   exit(1);
  }
+
+ // The SEARCH section came later, so the language files copied to the home directories before may not have it
+ if (item!="SEARCH")
+ {
+  std::cerr << "Warning: language file " << lang_file << " has no SEARCH section. The messages of the search will be in English.\n";
+  f.close();
+  return;
+ }
+ std::vector<std::string> found;
+ while (!f.eof())
+ {
+  getline(f,item);
+  nline++;
+  if (LineHasInfo(item,lang_file,nline))
+   found.push_back(item);
+ }
+ if (found.size()<size_t(NumSearchMessages))
+ {
+  std::cerr << "Error reading language file " << lang_file << ". Less than " << int(NumSearchMessages) << " strings in the SEARCH section.\n";
+  exit(1);
+ }
+ for (int i=0;i<NumSearchMessages;i++)
+  if (((i==SearchPrompt) || (i==SearchOne) || (i==SearchMany) || (i==SearchIndexed)) && (found[i].find("%s")==std::string::npos))
+  {
+   std::cerr << "Error reading language file " << lang_file << ". String " << i+1 << " of the SEARCH section does not contain '%s'.\n";
+   exit(1);
+  }
+ search_items.assign(found.begin(),found.begin()+NumSearchMessages);
  f.close();
 }
 
@@ -472,7 +682,8 @@ Config::Commands Config::InterpretKey(int key,bool &to_canvas)
  }
 
  // If the key is not in the table, it is one of those which are accessible only as key presses.
- // All of these are to be sent to the PDFSlide, not to the Canvas
+ // All of these are to be sent to the PDFSlide (or to the blank boards), not to the Canvas, except those of the performance figures,
+ // the highlighter and the pointer
  to_canvas=false;
  switch (key)
  {
@@ -482,6 +693,14 @@ Config::Commands Config::InterpretKey(int key,bool &to_canvas)
      case SDLK_UP: return(FastForward); break;
      case SDLK_PAGEDOWN: return(ToFirstSlide); break;
      case SDLK_DOWN: return(FastBackwards); break;
+     case SDLK_F2: to_canvas=true; return(ToggleHud); break;
+     case SDLK_F3: to_canvas=true; return(ToggleHighlighter); break;
+     case SDLK_F4: to_canvas=true; return(TogglePointer); break;
+     case SDLK_F6: return(ZoomOut); break;
+     case SDLK_F7: return(ZoomIn); break;
+     case SDLK_F8: return(ToggleBoards); break;
+     case SDLK_TAB: return(ToggleOverview); break;
+     case SDLK_F9: return(Search); break;
      default: break;
  }
  return(NoCommand);
@@ -108,6 +108,42 @@ class Config
      * Default value for the name of the global language configuration file (that shoud live in the DefaultGlobalConfigDir)
      */
     static constexpr const char* LangFileNameGlobal = "vbb_menu";   
+
+    /**
+     * Default value for the name of the directory (inside the user's home directory) where session files and other per-document data are kept
+     */
+    static constexpr const char* DefaultCacheDir = ".vbb_cache/";
+
+    /**
+     * Maximum time, in milliseconds, that the movement of the pen can be predicted. Beyond it, guesses are more often wrong than right.
+     */
+    static const long MaxPenPrediction = 100;
+
+    /**
+     * Default time, in milliseconds, that the ink of the pointer is seen before it fades out
+     */
+    static const long DefaultPointerTime = 1500;
+
+    /**
+     * Limits of the time that the ink of the pointer is seen, in milliseconds
+     */
+    static const long MinPointerTime = 100;
+    static const long MaxPointerTime = 10000;
+
+    /**
+     * The messages of the search, in the order of the SEARCH section of the language file. Those marked with %s contain it, to be replaced.
+     *
+     * SearchPrompt: the query being typed (%s)
+     *
+     * SearchHint: what is shown while the query is empty
+     *
+     * SearchNone: what is shown when no slide contains the words
+     *
+     * SearchOne and SearchMany: the number of slides found (%s), when there is one and when there are more
+     *
+     * SearchIndexed: how much of the document has been indexed yet (%s)
+     */
+    enum SearchMessages { SearchPrompt, SearchHint, SearchNone, SearchOne, SearchMany, SearchIndexed, NumSearchMessages };
     
      /** 
       * Possible values to be returned when an option is parsed.
@@ -146,8 +182,26 @@ class Config
      * LangFile: file with the text of the menu and accelerator keys in the user's language
      * 
      * SplashFile: file with the initial banner to be shown at program start, or None for not showing any banner at all
+     *
+     * SaveSession: should the lines drawn on each slide be kept with that slide and restored the next time the same PDF file is opened?
+     *
+     * CacheDir: directory where the session files (and other data associated to each PDF file) are stored
+     *
+     * Statistics: should timing statistics (like the latency from the pen to the screen) be written to the standard error at exit?
+     *
+     * Headless: should the program run without display, drawing only in memory? (for automated performance runs)
+     *
+     * ProfileFile: file where the time of each measured operation is written, as a Chrome trace, or None for not writing it
+     *
+     * PenPrediction: how far ahead, in milliseconds, the movement of the pen is guessed to draw a provisional line up to its tip, or 0 for not doing it
+     *
+     * StrokeSmoothing: should the positions of the pen be joined with a smooth curve, instead of with straight lines?
+     *
+     * InkAntialiasing: should the lines of the pen be drawn with soft (antialiased) edges, instead of with square pixels?
+     *
+     * PointerTime: time, in milliseconds, that the ink of the pointer is seen before it fades out
      */
-    enum ConfigParams { UnknownParam, OpenInWindow, XRes, YRes, EraserSize, EraserShape, FontDir, FontName, FontSize, LangFile, SplashFile };
+    enum ConfigParams { UnknownParam, OpenInWindow, XRes, YRes, EraserSize, EraserShape, FontDir, FontName, FontSize, LangFile, SplashFile, SaveSession, CacheDir, Statistics, Headless, ProfileFile, PenPrediction, StrokeSmoothing, InkAntialiasing, PointerTime };
     
     /** 
      * The strings thet will have to be found as parameters in the configuration file and its association with constant enumerated values.
@@ -163,7 +217,16 @@ class Config
         { "FontName",		FontName },
         { "FontSize",		FontSize },
         { "LangFile",		LangFile },
-        { "SplashFile",		SplashFile }
+        { "SplashFile",		SplashFile },
+        { "SaveSession",	SaveSession },
+        { "CacheDir",		CacheDir },
+        { "Statistics",		Statistics },
+        { "Headless",		Headless },
+        { "ProfileFile",	ProfileFile },
+        { "PenPrediction",	PenPrediction },
+        { "StrokeSmoothing",	StrokeSmoothing },
+        { "InkAntialiasing",	InkAntialiasing },
+        { "PointerTime",	PointerTime }
     };
 
     /**
@@ -200,11 +263,27 @@ class Config
      * 
      * ToLastSlide: Goes to the last slide (PDFSlide)
      * 
+     * ToggleHud: Shows or hides the performance figures in the menu bar (Canvas)
+     * 
+     * ToggleHighlighter: Changes between the translucent highlighter and the pen (Canvas)
+     * 
+     * TogglePointer: Changes between the pointer, whose ink fades out by itself, and the pen (Canvas)
+     * 
+     * ToggleBoards: Changes between the slides and the blank blackboards (main, which passes the navigation commands to the boards while they are shown)
+     * 
+     * ZoomIn: Zooms into the current slide, or doubles the zoom (main, with the zoomed view)
+     * 
+     * ZoomOut: Halves the zoom, or shows the whole slide again (main, with the zoomed view)
+     * 
+     * ToggleOverview: Shows or hides the grid of thumbnails of the slides (main, with the overview)
+     * 
+     * Search: Starts searching the slides that contain some words, which are then typed in the menu bar (main, with the search)
+     * 
      * NoCommand: Special mark to account for press of unassigned keys. Nothing is done (Canvas)
      * 
     */
     enum Commands 
-    { DrawErase, LineCharac, Next, Previous, EraseAll, EraseSlide, EraseBlackb, SaveBlackb, Quit, FastForward, FastBackwards, ToFirstSlide, ToLastSlide, NoCommand };
+    { DrawErase, LineCharac, Next, Previous, EraseAll, EraseSlide, EraseBlackb, SaveBlackb, Quit, FastForward, FastBackwards, ToFirstSlide, ToLastSlide, ToggleHud, ToggleHighlighter, TogglePointer, ToggleBoards, ZoomIn, ZoomOut, ToggleOverview, Search, NoCommand };
     
     /**
      * The command that appears as the first entry of the menu
@@ -223,6 +302,16 @@ class Config
      * 
      */
     Config();
+
+    /**
+     * Constructor for programs that draw only in memory (like the benchmarks). No file is read: every value is the default one,
+     * except the resolution, and the program runs without display, splash screen nor sessions. The messages are those of the English menu file.
+     * \param w Horizontal resolution in pixels
+     * \param h Vertical resolution in pixels
+     * \param bpp Bits per pixel of the surface in memory (8, 16, 24 or 32)
+     * \param bgr true to store the blue component in the highest bits of the pixel and the red one in the lowest, false for the opposite
+     */
+    Config(int w,int h,int bpp=32,bool bgr=false);
     
     /**
      * Destructor. Nothing to do in it, since this class does not use dynamic allocation. It is nevertheless necessary to avoid warnings because the -Winline flag.
@@ -285,6 +374,90 @@ class Config
      * \return Absolute path of the PDF banner file
      */
     std::string GetSplashFile(void) { return splash_file; };
+
+    /**
+     * Checks if the config file has asked for keeping the lines drawn on each slide between executions
+     * \return true if sessions are to be saved and restored, false if not
+     */
+    bool GetSaveSession(void) { return save_session; };
+
+    /**
+     * Gets the directory where session files and other per-document data are stored
+     * \return Absolute path of the cache directory, always ending in '/'
+     */
+    std::string GetCacheDir(void) { return cache_dir; };
+
+    /**
+     * Checks if the config file has asked for timing statistics
+     * \return true if statistics are to be written at exit, false if not
+     */
+    bool GetStatistics(void) { return statistics; };
+
+    /**
+     * Gets the file where the measures of the profiler are written as a Chrome trace
+     * \return The name of the file, or the empty string if no trace has to be written
+     */
+    std::string GetProfileFile(void) { return profile_file; };
+
+    /**
+     * Gets how far ahead the movement of the pen is predicted
+     * \return Time in milliseconds, or 0 if there is no prediction
+     */
+    unsigned GetPenPrediction(void) { return pen_prediction; };
+
+    /**
+     * Checks if the config file has asked for smoothing the strokes of the pen
+     * \return true to join the positions of the pen with a curve, false to join them with straight lines
+     */
+    bool GetStrokeSmoothing(void) { return stroke_smoothing; };
+
+    /**
+     * Checks if the config file has asked for drawing the lines of the pen with antialiasing
+     * \return true to draw them with soft edges, false to draw them with square pixels
+     */
+    bool GetInkAntialiasing(void) { return ink_antialiasing; };
+
+    /**
+     * Gets how long the ink of the pointer is seen before it fades out
+     * \return Time in milliseconds
+     */
+    unsigned GetPointerTime(void) { return pointer_time; };
+
+    /**
+     * Checks if the program has to run without display
+     * \return true to draw only in memory, false to use a window or the full screen
+     */
+    bool GetHeadless(void) { return headless; };
+
+    /**
+     * Gets the bits per pixel of the surface used when running without display
+     * \return 8, 16, 24 or 32
+     */
+    int GetHeadlessDepth(void) { return headless_bpp; };
+
+    /**
+     * Tells the order of the color components in the surface used when running without display
+     * \return true if blue is in the highest bits of the pixel, false if red is
+     */
+    bool GetHeadlessBGR(void) { return headless_bgr; };
+
+    /**
+     * Sets if the program has to run without display, overriding the configuration file (used by the -H option)
+     * \param h true to draw only in memory. Then, the splash screen is not shown, and if the full screen was asked for, the default resolution is used.
+     */
+    void SetHeadless(bool h);
+
+    /**
+     * Prepares the configuration to record or replay an input trace. Traces always start from the same state: without splash
+     * screen (whose closing would be the first event) and without restoring nor saving sessions (which would add the traces of former executions).
+     */
+    void SetTraceMode(void) { show_splash=false; save_session=false; };
+
+    /**
+     * Prepares the configuration for a soak run, which does the same work again and again without anybody looking: without splash screen.
+     * Sessions are kept as configured, so that their memory is followed too, but the program does not save them in this mode.
+     */
+    void SetSoakMode(void) { show_splash=false; };
     
     /**
      * This function returns a command to be executed, according to the key the user has pressed. If the key is associated to one element of the menu, or is one of the predefined ones, it decides which one. If not, it is ignored and NoCommand is returned.
@@ -317,6 +490,13 @@ class Config
      * \return An ordered vector of menu items
      */
     const std::vector<std::string> &GetMenuItems() { return mitems; };
+
+    /**
+     * Gets a message of the search, as read from the language configuration file (or in English, if the file has no SEARCH section)
+     * \param m The message
+     * \return The message
+     */
+    std::string GetSearchMessage(SearchMessages m) { return search_items[m]; };
     
  private:
     static const int MaxMenuHeight = 20;
@@ -346,9 +526,22 @@ class Config
     EraserShapes eraser_shape;
     
     std::string lang_file;
+
+    bool save_session;
+    bool statistics;
+    std::string profile_file;
+    unsigned pen_prediction;
+    bool stroke_smoothing;
+    bool ink_antialiasing;
+    unsigned pointer_time;
+    bool headless;
+    int headless_bpp;
+    bool headless_bgr;
+    std::string cache_dir;
        
     std::vector<std::string> mitems;
     std::vector<std::string> sitems;
+    std::vector<std::string> search_items;
     std::vector< std::pair<int,int> > accelerator_codes;
 };
 
@@ -0,0 +1,73 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <SDL/SDL.h>
+
+// Helpers shared by the planes that keep how much of each pixel of the canvas is covered (one byte per pixel, row by row),
+// like those of the highlighter and of the antialiased ink.
+
+/**
+ * Divides by 255, rounded, a value up to 255*255 (a component multiplied by a coverage)
+ * \param v The value
+ * \return The quotient
+ */
+static inline Uint8 Div255(Uint32 v)
+{
+ v+=128;
+ return Uint8((v+(v>>8))>>8);
+}
+
+/**
+ * Moves the coverage of an area of a plane. The pixels that enter the area are not covered.
+ * \param plane The plane, with width*height bytes
+ * \param width Width of the plane
+ * \param height Height of the plane
+ * \param r The area, which is clipped to the plane
+ * \param dx Pixels to the right (negative to the left)
+ * \param dy Pixels down (negative up)
+ */
+static inline void ScrollCoverage(Uint8 *plane,int width,int height,SDL_Rect r,int dx,int dy)
+{
+ int x1=std::max(int(r.x),0),x2=std::min(int(r.x)+int(r.w),width);
+ int y1=std::max(int(r.y),0),y2=std::min(int(r.y)+int(r.h),height);
+ if ((x2<=x1) || (y2<=y1))
+  return;
+ int w=x2-x1,h=y2-y1;
+ int n=std::max(w-abs(dx),0);
+ for (int k=0;k<h;k++)
+ {
+  // Rows are moved in the order that does not overwrite those still to be moved
+  int y=(dy>0) ? y2-1-k : y1+k;
+  Uint8 *row=plane+size_t(y)*size_t(width);
+  if ((n>0) && (y-dy>=y1) && (y-dy<y2))
+  {
+   memmove(row+x1+std::max(dx,0),plane+size_t(y-dy)*size_t(width)+x1+std::max(-dx,0),n);
+   // The columns that enter the area
+   memset(row+((dx>0) ? x1 : x1+n),0,w-n);
+  }
+  else
+   memset(row+x1,0,w);
+ }
+}
+
+#endif
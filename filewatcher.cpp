@@ -0,0 +1,107 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "filewatcher.h"
+
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+
+FileWatcher::FileWatcher(const std::string &fn,std::function<void()> changed)
+{
+ notify=changed;
+ thread=nullptr;
+ stop[0]=stop[1]=-1;
+ size_t slash=fn.rfind('/');
+ dir=(slash==std::string::npos) ? "." : (slash==0) ? "/" : fn.substr(0,slash);
+ name=(slash==std::string::npos) ? fn : fn.substr(slash+1);
+
+ fd=inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+ if ((fd<0) || (inotify_add_watch(fd,dir.c_str(),IN_CLOSE_WRITE | IN_MOVED_TO)<0) || (pipe(stop)!=0))
+ {
+  std::cerr << "Warning: cannot watch " << fn << ". It will not be reloaded when it changes.\n";
+  return;
+ }
+ if ((thread=SDL_CreateThread(Run,this))==nullptr)
+  std::cerr << "Warning: cannot create the thread that watches " << fn << ". It will not be reloaded when it changes.\n";
+}
+
+FileWatcher::~FileWatcher()
+{
+ if (thread!=nullptr)
+ {
+  char c=0;
+  if (write(stop[1],&c,1)==1)
+   SDL_WaitThread(thread,nullptr);
+ }
+ if (fd>=0)
+  close(fd);
+ for (int i=0;i<2;i++)
+  if (stop[i]>=0)
+   close(stop[i]);
+}
+
+bool FileWatcher::Read(void)
+{
+ // The events have variable length (they end with the name of the file), so they are read into an aligned buffer
+ union
+ {
+  struct inotify_event ev;
+  char buf[4096];
+ } u;
+ bool found=false;
+ ssize_t len;
+ while ((len=read(fd,u.buf,sizeof(u.buf)))>0)
+ {
+  ssize_t i=0;
+  while (i+ssize_t(sizeof(struct inotify_event))<=len)
+  {
+   const struct inotify_event *ev=(const struct inotify_event *)(u.buf+i);
+   if ((ev->len>0) && (name==ev->name))
+    found=true;
+   i+=sizeof(struct inotify_event)+ev->len;
+  }
+ }
+ return found;
+}
+
+int FileWatcher::Run(void *data)
+{
+ FileWatcher *w=(FileWatcher *)data;
+ struct pollfd p[2];
+ p[0].fd=w->fd;
+ p[0].events=POLLIN;
+ p[1].fd=w->stop[0];
+ p[1].events=POLLIN;
+ bool pending=false;
+ for (;;)
+ {
+  // Without a change pending, it sleeps until something happens. With one, until it settles.
+  int r=poll(p,2,(pending) ? SettleTime : -1);
+  if ((r>0) && (p[1].revents!=0))
+   break;
+  if ((r>0) && (p[0].revents & POLLIN))
+   pending|=w->Read();
+  else if ((r==0) && pending)
+  {
+   pending=false;
+   w->notify();
+  }
+ }
+ return 0;
+}
@@ -0,0 +1,69 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <iostream>
+#include <string>
+#include <functional>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+
+/*! \brief Class to tell when a file has been written again, for instance when the PDF file of the slides is compiled again
+ *
+ * A thread waits (with inotify, without using CPU) for the events of the directory of the file, since programs that
+ * write files often write them aside and rename them, so the file itself is replaced. When the file is closed after
+ * being written, or renamed onto, the thread waits until SettleTime passes without more events for it (some programs
+ * write the file several times in a row) and then calls a function.
+ *
+ * If inotify cannot be used, a warning is written and nothing is watched.
+*/
+class FileWatcher
+{
+ public:
+    /**
+     * Time, in milliseconds, without events for the file before its change is told
+     */
+    static const int SettleTime = 300;
+
+    /**
+     * Constructor. It starts watching the file.
+     * \param fn The file
+     * \param changed The function that is called when the file has changed. It is called from the thread of the watcher.
+     */
+    FileWatcher(const std::string &fn,std::function<void()> changed);
+
+    /**
+     * Destructor. It stops the thread.
+     */
+    ~FileWatcher();
+
+ private:
+    static int Run(void *data);
+    // Reads the events waiting, and tells if any of them is of the file
+    bool Read(void);
+
+    std::string dir,name;
+    std::function<void()> notify;
+    // The inotify descriptor, and the pipe that wakes the thread up to stop it
+    int fd;
+    int stop[2];
+    SDL_Thread *thread;
+};
+
+#endif
@@ -0,0 +1,210 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "glyphatlas.h"
+
+#include <iostream>
+
+GlyphAtlas::GlyphAtlas(TTF_Font *f,SDL_PixelFormat *fmt)
+{
+ font=f;
+ format=fmt;
+ width=0;
+ height=TTF_FontHeight(font);
+
+ // Printable ASCII and Latin-1 characters. Others will be added when found in the menu or in a message.
+ for (Uint32 cp=32;cp<127;cp++)
+  AddGlyph(cp);
+ for (Uint32 cp=160;cp<256;cp++)
+  AddGlyph(cp);
+}
+
+GlyphAtlas::~GlyphAtlas()
+{
+ for (std::map<int,SDL_Surface *>::iterator it=atlases.begin();it!=atlases.end();++it)
+  SDL_FreeSurface(it->second);
+}
+
+Uint32 GlyphAtlas::NextCodePoint(const std::string &s,size_t &i)
+{
+ unsigned char b=(unsigned char)s[i++];
+ int extra=0;
+ Uint32 cp=b;
+ if ((b & 0xE0)==0xC0)
+ {
+  cp=b & 0x1F;
+  extra=1;
+ }
+ else if ((b & 0xF0)==0xE0)
+ {
+  cp=b & 0x0F;
+  extra=2;
+ }
+ else if ((b & 0xF8)==0xF0)
+ {
+  cp=b & 0x07;
+  extra=3;
+ }
+ while ((extra>0) && (i<s.size()) && (((unsigned char)s[i] & 0xC0)==0x80))
+ {
+  cp=(cp<<6) | ((unsigned char)s[i++] & 0x3F);
+  extra--;
+ }
+ // SDL_ttf works with 16-bit characters. Anything else (or a broken sequence) is shown as a question mark.
+ if ((extra>0) || (cp>0xFFFF))
+  cp='?';
+ return cp;
+}
+
+std::string GlyphAtlas::EncodeCodePoint(Uint32 cp)
+{
+ std::string e;
+ if (cp<0x80)
+  e.push_back(char(cp));
+ else if (cp<0x800)
+ {
+  e.push_back(char(0xC0 | (cp>>6)));
+  e.push_back(char(0x80 | (cp & 0x3F)));
+ }
+ else
+ {
+  e.push_back(char(0xE0 | (cp>>12)));
+  e.push_back(char(0x80 | ((cp>>6) & 0x3F)));
+  e.push_back(char(0x80 | (cp & 0x3F)));
+ }
+ return e;
+}
+
+bool GlyphAtlas::AddGlyph(Uint32 cp)
+{
+ if (glyphs.find(cp)!=glyphs.end())
+  return false;
+
+ int w=0,h=0;
+ if (TTF_SizeUTF8(font,EncodeCodePoint(cp).c_str(),&w,&h)!=0)
+  w=0;
+ Glyph g;
+ g.x=width;
+ g.w=w;
+ glyphs[cp]=g;
+ width+=w;
+ return true;
+}
+
+void GlyphAtlas::Build(int id)
+{
+ std::map<int,SDL_Surface *>::iterator old=atlases.find(id);
+ if (old!=atlases.end())
+ {
+  SDL_FreeSurface(old->second);
+  atlases.erase(old);
+ }
+
+ SDL_Surface *a=SDL_CreateRGBSurface(SDL_SWSURFACE,(width>0) ? width : 1,height,format->BitsPerPixel,
+                                     format->Rmask,format->Gmask,format->Bmask,format->Amask);
+ if (a==nullptr)
+ {
+  std::cerr << "Error creating the SDL surface of the glyph atlas. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+ if (format->palette!=nullptr)
+  SDL_SetPalette(a,SDL_LOGPAL,format->palette->colors,0,format->palette->ncolors);
+
+ // The background is the inverse of the color of the glyphs, so that it can never be confused with them
+ SDL_Color col=colors[id];
+ Uint32 key=SDL_MapRGB(a->format,col.r^0xFF,col.g^0xFF,col.b^0xFF);
+ SDL_FillRect(a,nullptr,key);
+
+ // Surfaces rendered by TTF_RenderUTF8_Solid have a color key in their background, so only the glyph itself is copied
+ for (std::map<Uint32,Glyph>::iterator it=glyphs.begin();it!=glyphs.end();++it)
+ {
+  if (it->second.w==0)
+   continue;
+  SDL_Surface *g=TTF_RenderUTF8_Solid(font,EncodeCodePoint(it->first).c_str(),col);
+  if (g==nullptr)
+   continue;
+  SDL_Rect r;
+  r.x=it->second.x;
+  r.y=0;
+  r.w=it->second.w;
+  r.h=height;
+  SDL_BlitSurface(g,nullptr,a,&r);
+  SDL_FreeSurface(g);
+ }
+
+ SDL_SetColorKey(a,SDL_SRCCOLORKEY | SDL_RLEACCEL,key);
+ atlases[id]=a;
+}
+
+void GlyphAtlas::AddColor(int id,SDL_Color col)
+{
+ colors[id]=col;
+ Build(id);
+}
+
+void GlyphAtlas::AddGlyphs(const std::string &s)
+{
+ bool added=false;
+ size_t i=0;
+ while (i<s.size())
+  added|=AddGlyph(NextCodePoint(s,i));
+ if (added)
+  for (std::map<int,SDL_Color>::iterator it=colors.begin();it!=colors.end();++it)
+   Build(it->first);
+}
+
+int GlyphAtlas::TextWidth(const std::string &s)
+{
+ AddGlyphs(s);
+ int w=0;
+ size_t i=0;
+ while (i<s.size())
+  w+=glyphs[NextCodePoint(s,i)].w;
+ return w;
+}
+
+int GlyphAtlas::Draw(SDL_Surface *dst,const std::string &s,int x,int y,int id)
+{
+ std::map<int,SDL_Surface *>::iterator a=atlases.find(id);
+ if (a==atlases.end())
+  return 0;
+
+ AddGlyphs(s);
+ // AddGlyphs may have rebuilt the atlases
+ a=atlases.find(id);
+
+ int x0=x;
+ size_t i=0;
+ SDL_Rect src,dr;
+ src.y=0;
+ src.h=height;
+ while (i<s.size())
+ {
+  const Glyph &g=glyphs[NextCodePoint(s,i)];
+  if (g.w>0)
+  {
+   src.x=g.x;
+   src.w=g.w;
+   dr.x=x;
+   dr.y=y;
+   SDL_BlitSurface(a->second,&src,dst,&dr);
+  }
+  x+=g.w;
+ }
+ return x-x0;
+}
@@ -0,0 +1,111 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef GLYPHATLAS_H
+#define GLYPHATLAS_H
+
+#include <string>
+#include <map>
+#include <SDL/SDL_ttf.h>
+
+/*! \brief Class to write texts by blitting glyphs rendered only once
+ *
+ * The GlyphAtlas (one per font and size) renders with SDL_ttf, once, every glyph that the program may need
+ * (the printable ASCII and Latin-1 characters, plus those that appear in the menu and messages) and keeps
+ * them side by side in one surface per color, already converted to the pixel format of the screen and with
+ * a color key for the background. Writing a text is then a blit per character, without any work of FreeType
+ * and without allocating memory.
+ *
+ * Glyphs are placed one after the other using the width of each one alone, so kerning is ignored. This is
+ * exact for monospaced fonts, like the default one.
+ *
+ * If a text contains a character that is not in the atlas, it is added (and all atlases rebuilt) the first time it is found.
+*/
+class GlyphAtlas
+{
+ public:
+    /**
+     * Constructor. It renders the default set of glyphs, but no atlas is built until a color is added.
+     * \param f The TTF font, already opened
+     * \param fmt The pixel format of the surfaces onto which the texts will be written
+     */
+    GlyphAtlas(TTF_Font *f,SDL_PixelFormat *fmt);
+
+    /**
+     * Destructor. It frees the atlases.
+     */
+    ~GlyphAtlas();
+
+    /**
+     * Builds the atlas for a color
+     * \param id The identifier that will be used to ask for this color when writing
+     * \param col The color
+     */
+    void AddColor(int id,SDL_Color col);
+
+    /**
+     * Makes sure that all the characters of a text are in the atlas (so that writing it later will not need to rebuild it)
+     * \param s A text, in UTF-8
+     */
+    void AddGlyphs(const std::string &s);
+
+    /**
+     * Gets the width of a text, as it will be written
+     * \param s A text, in UTF-8
+     * \return Width in pixels
+     */
+    int TextWidth(const std::string &s);
+
+    /**
+     * Gets the height of any text written with this atlas
+     * \return Height in pixels (that of the font)
+     */
+    int Height(void) { return height; };
+
+    /**
+     * Writes a text
+     * \param dst The surface onto which the text is written
+     * \param s The text, in UTF-8
+     * \param x The x coordinate of the upper-left corner of the text
+     * \param y The y coordinate of the upper-left corner of the text
+     * \param id The identifier of the color (which must have been added with AddColor)
+     * \return The width of the written text, in pixels
+     */
+    int Draw(SDL_Surface *dst,const std::string &s,int x,int y,int id);
+
+ private:
+    struct Glyph
+    {
+     int x;
+     int w;
+    };
+
+    static Uint32 NextCodePoint(const std::string &s,size_t &i);
+    static std::string EncodeCodePoint(Uint32 cp);
+    bool AddGlyph(Uint32 cp);
+    void Build(int id);
+
+    TTF_Font *font;
+    SDL_PixelFormat *format;
+    int width,height;
+
+    std::map<Uint32,Glyph> glyphs;
+    std::map<int,SDL_Color> colors;
+    std::map<int,SDL_Surface *> atlases;
+};
+
+#endif
@@ -0,0 +1,221 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "highlight.h"
+#include "coverage.h"
+#include "linewalk.h"
+
+#include <cstring>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+bool HighlightLayer::vectorized=true;
+
+HighlightLayer::HighlightLayer(SDL_PixelFormat *fmt,int w,int h,SDL_Color col)
+{
+ format=fmt;
+ width=w;
+ height=h;
+ mask.assign(size_t(w)*size_t(h),0);
+ empty=true;
+ color=col;
+ pixel=SDL_MapRGB(format,col.r,col.g,col.b);
+ // The bytes of the pixel are written as they would be in a surface
+ memcpy(bytes,&pixel,4);
+ if ((format->BytesPerPixel==3) && (SDL_BYTEORDER==SDL_BIG_ENDIAN))
+  memcpy(bytes,(Uint8 *)&pixel+1,3);
+}
+
+bool HighlightLayer::HasVectorized(void)
+{
+#if defined(__SSE2__)
+ return true;
+#else
+ return false;
+#endif
+}
+
+void HighlightLayer::Clear(void)
+{
+ if (!empty)
+  std::fill(mask.begin(),mask.end(),0);
+ empty=true;
+}
+
+void HighlightLayer::Scroll(SDL_Rect r,int dx,int dy)
+{
+ ScrollCoverage(&mask[0],width,height,r,dx,dy);
+}
+
+void HighlightLayer::Line(int xa,int ya,int xb,int yb,int size,int offset,bool cover)
+{
+ // The tip is put at each point of the line, as the pen does
+ WalkLine(xa,ya,xb,yb,[&](int x,int y)
+ {
+  int x1=std::max(x-offset,0);
+  int y1=std::max(y-offset,0);
+  int x2=std::min(x-offset+size,width);
+  int y2=std::min(y-offset+size,height);
+  for (int yy=y1;yy<y2;yy++)
+  {
+   Uint8 *m=&mask[size_t(yy)*size_t(width)];
+   for (int xx=x1;xx<x2;xx++)
+    m[xx]=(cover) ? std::max(m[xx],Alpha) : 0;
+  }
+  if (cover && (x2>x1) && (y2>y1))
+   empty=false;
+ });
+}
+
+void HighlightLayer::Compose(SDL_Surface *dst,SDL_Surface *src,SDL_Rect r)
+{
+ int x1=std::max(int(r.x),0);
+ int y1=std::max(int(r.y),0);
+ int x2=std::min(std::min(int(r.x)+int(r.w),width),std::min(dst->w,src->w));
+ int y2=std::min(std::min(int(r.y)+int(r.h),height),std::min(dst->h,src->h));
+ if ((x2<=x1) || (y2<=y1))
+  return;
+ int bpp=format->BytesPerPixel;
+ SDL_LockSurface(dst);
+ SDL_LockSurface(src);
+ for (int y=y1;y<y2;y++)
+  BlendRow((Uint8 *)dst->pixels+y*dst->pitch+x1*bpp,(const Uint8 *)src->pixels+y*src->pitch+x1*bpp,
+           &mask[size_t(y)*size_t(width)+x1],x2-x1);
+ SDL_UnlockSurface(src);
+ SDL_UnlockSurface(dst);
+}
+
+void HighlightLayer::BlendRow(Uint8 *d,const Uint8 *s,const Uint8 *a,int n)
+{
+ switch (format->BytesPerPixel)
+ {
+  case 4:
+        if (vectorized && HasVectorized())
+         BlendBytes32SSE2(d,s,a,n);
+        else
+         BlendBytes(d,s,a,n,4);
+        break;
+  case 3:
+        BlendBytes(d,s,a,n,3);
+        break;
+  case 2:
+        Blend16(d,s,a,n);
+        break;
+  default:
+        BlendPalette(d,s,a,n);
+        break;
+ }
+}
+
+void HighlightLayer::BlendBytes(Uint8 *d,const Uint8 *s,const Uint8 *a,int n,int bpp)
+{
+ // With 24 and 32 bits, each component is a byte, so every byte is blended with the same byte of the color
+ for (int i=0;i<n;i++,d+=bpp,s+=bpp)
+ {
+  Uint32 al=a[i];
+  if (al==0)
+  {
+   memcpy(d,s,bpp);
+   continue;
+  }
+  for (int k=0;k<bpp;k++)
+   d[k]=Div255(s[k]*(255-al)+bytes[k]*al);
+ }
+}
+
+void HighlightLayer::BlendBytes32SSE2(Uint8 *d,const Uint8 *s,const Uint8 *a,int n)
+{
+ int i=0;
+#if defined(__SSE2__)
+ const __m128i zero=_mm_setzero_si128();
+ const __m128i c255=_mm_set1_epi16(255);
+ const __m128i c128=_mm_set1_epi16(128);
+ Uint32 p;
+ memcpy(&p,bytes,4);
+ const __m128i col=_mm_unpacklo_epi8(_mm_set1_epi32(int(p)),zero);
+ for (;i+4<=n;i+=4)
+ {
+  Uint32 a4;
+  memcpy(&a4,a+i,4);
+  __m128i sp=_mm_loadu_si128((const __m128i *)(s+4*i));
+  // Four uncovered pixels are copied as they are
+  if (a4==0)
+  {
+   _mm_storeu_si128((__m128i *)(d+4*i),sp);
+   continue;
+  }
+  // The alpha of each pixel is repeated for its four bytes, and everything is widened to 16 bits
+  __m128i av=_mm_cvtsi32_si128(int(a4));
+  av=_mm_unpacklo_epi8(av,av);
+  av=_mm_unpacklo_epi16(av,av);
+  __m128i alo=_mm_unpacklo_epi8(av,zero);
+  __m128i ahi=_mm_unpackhi_epi8(av,zero);
+  __m128i slo=_mm_unpacklo_epi8(sp,zero);
+  __m128i shi=_mm_unpackhi_epi8(sp,zero);
+  __m128i vlo=_mm_add_epi16(_mm_mullo_epi16(slo,_mm_sub_epi16(c255,alo)),_mm_mullo_epi16(col,alo));
+  __m128i vhi=_mm_add_epi16(_mm_mullo_epi16(shi,_mm_sub_epi16(c255,ahi)),_mm_mullo_epi16(col,ahi));
+  vlo=_mm_add_epi16(vlo,c128);
+  vhi=_mm_add_epi16(vhi,c128);
+  vlo=_mm_srli_epi16(_mm_add_epi16(vlo,_mm_srli_epi16(vlo,8)),8);
+  vhi=_mm_srli_epi16(_mm_add_epi16(vhi,_mm_srli_epi16(vhi,8)),8);
+  _mm_storeu_si128((__m128i *)(d+4*i),_mm_packus_epi16(vlo,vhi));
+ }
+#endif
+ // The pixels that do not make a group of four
+ BlendBytes(d+4*i,s+4*i,a+i,n-i,4);
+}
+
+void HighlightLayer::Blend16(Uint8 *d,const Uint8 *s,const Uint8 *a,int n)
+{
+ const SDL_PixelFormat *f=format;
+ for (int i=0;i<n;i++)
+ {
+  Uint16 p;
+  memcpy(&p,s+2*i,2);
+  Uint32 al=a[i];
+  if (al!=0)
+  {
+   Uint8 r=Uint8(((p & f->Rmask)>>f->Rshift)<<f->Rloss);
+   Uint8 g=Uint8(((p & f->Gmask)>>f->Gshift)<<f->Gloss);
+   Uint8 b=Uint8(((p & f->Bmask)>>f->Bshift)<<f->Bloss);
+   r=Div255(r*(255-al)+color.r*al);
+   g=Div255(g*(255-al)+color.g*al);
+   b=Div255(b*(255-al)+color.b*al);
+   p=Uint16(((r>>f->Rloss)<<f->Rshift) | ((g>>f->Gloss)<<f->Gshift) | ((b>>f->Bloss)<<f->Bshift));
+  }
+  memcpy(d+2*i,&p,2);
+ }
+}
+
+void HighlightLayer::BlendPalette(Uint8 *d,const Uint8 *s,const Uint8 *a,int n)
+{
+ // With a palette, the nearest color is looked for, which is slow, but only for covered pixels
+ for (int i=0;i<n;i++)
+ {
+  Uint32 al=a[i];
+  if (al==0)
+  {
+   d[i]=s[i];
+   continue;
+  }
+  Uint8 r,g,b;
+  SDL_GetRGB(s[i],format,&r,&g,&b);
+  d[i]=Uint8(SDL_MapRGB(format,Div255(r*(255-al)+color.r*al),Div255(g*(255-al)+color.g*al),Div255(b*(255-al)+color.b*al)));
+ }
+}
@@ -0,0 +1,160 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <vector>
+#include <SDL/SDL.h>
+
+/*! \brief Class to keep the strokes of the highlighter and to blend them over the slides
+ *
+ * The traces of the pen are opaque and they are copied over the slide. Those of the highlighter are translucent: the layer
+ * keeps, for each pixel of the canvas, how much it is covered by the highlighter (its alpha, from 0 to 255), and the color
+ * of the slide is blended with that of the highlighter in that proportion. Strokes over strokes do not darken, since the
+ * coverage of a pixel is the largest one of the strokes that touch it.
+ *
+ * Blending has to be done again, from the slide as it was shown, every time the slide or the highlights change, so it is
+ * done a row at a time by kernels specific for each pixel format. With 32 bits per pixel, four pixels are blended at once
+ * with SSE2 when the processor has it. All the kernels give exactly the same result, which is that of
+ * (slide*(255-alpha)+color*alpha)/255 rounded for each component.
+*/
+class HighlightLayer
+{
+ public:
+    /**
+     * Coverage of the strokes of the highlighter (about 40%)
+     */
+    static const Uint8 Alpha = 104;
+
+    /**
+     * Size in pixels of the (square) tip of the highlighter
+     */
+    static const int TipSize = 16;
+
+    /**
+     * Constructor. The layer starts empty.
+     * \param fmt The pixel format of the surfaces that will be blended (that of the canvas)
+     * \param w Width of the canvas
+     * \param h Height of the canvas
+     * \param col Color of the highlighter
+     */
+    HighlightLayer(SDL_PixelFormat *fmt,int w,int h,SDL_Color col);
+
+    /**
+     * Removes all the highlights
+     */
+    void Clear(void);
+
+    /**
+     * Tells if there is nothing highlighted
+     * \return true if no pixel is covered
+     */
+    bool Empty(void) { return empty; };
+
+    /**
+     * Covers (or uncovers) the pixels along a straight line, with a square brush at each of its points except the last one
+     * \param xa Value of coordinate x of the start of the line
+     * \param ya Value of coordinate y of the start of the line
+     * \param xb Value of coordinate x of the end of the line
+     * \param yb Value of coordinate y of the end of the line
+     * \param size Side of the brush, in pixels (TipSize for the highlighter)
+     * \param offset Distance from each point to the upper-left corner of the brush
+     * \param cover true to highlight the pixels, false to remove their highlight (as the eraser does)
+     */
+    void Line(int xa,int ya,int xb,int yb,int size,int offset,bool cover);
+
+    /**
+     * Moves the highlights of an area, as the traces are moved when the board is panned. Those that leave the area are lost.
+     * \param r The area
+     * \param dx Pixels to the right (negative to the left)
+     * \param dy Pixels down (negative up)
+     */
+    void Scroll(SDL_Rect r,int dx,int dy);
+
+    /**
+     * Gets the coverage of the pixels, to keep it and to put it back when the board is panned
+     * \return The alpha of each pixel of the canvas, row by row. After writing on it, SetCovered must be called.
+     */
+    Uint8 *GetMask(void) { return &mask[0]; };
+
+    /**
+     * Tells the layer that its mask has been written from outside, so that it may no longer be empty
+     */
+    void SetCovered(void) { empty=false; };
+
+    /**
+     * Blends the highlights over a surface, writing the result in another one of the same size and format
+     * \param dst The surface where the result is written (the canvas)
+     * \param src The surface with what is under the highlights (the slide)
+     * \param r The area to blend, which is clipped to the surfaces
+     */
+    void Compose(SDL_Surface *dst,SDL_Surface *src,SDL_Rect r);
+
+    /**
+     * Blends the color of the highlighter over a row of pixels of the format of the canvas, in place, each one with its own coverage
+     * \param d The pixels
+     * \param a The coverage of each pixel
+     * \param n Number of pixels
+     */
+    void BlendInPlace(Uint8 *d,const Uint8 *a,int n) { BlendRow(d,d,a,n); };
+
+    /**
+     * Gets the color of the highlighter
+     * \return The pixel value, in the format of the canvas
+     */
+    Uint32 GetPixel(void) { return pixel; };
+
+    /**
+     * Gets the memory used by the coverage of the pixels
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void) { return mask.capacity(); };
+
+    /**
+     * Chooses between the vectorized kernels and the scalar ones, for all layers. The vectorized ones are used by default,
+     * if the processor has them; the scalar ones are meant for the benchmarks and the checks.
+     * \param v true to use the vectorized kernels when available
+     */
+    static void SetVectorized(bool v) { vectorized=v; };
+
+    /**
+     * Tells if there are vectorized kernels in this build
+     * \return true if they are available
+     */
+    static bool HasVectorized(void);
+
+ private:
+    void BlendRow(Uint8 *d,const Uint8 *s,const Uint8 *a,int n);
+    void BlendBytes(Uint8 *d,const Uint8 *s,const Uint8 *a,int n,int bpp);
+    void BlendBytes32SSE2(Uint8 *d,const Uint8 *s,const Uint8 *a,int n);
+    void Blend16(Uint8 *d,const Uint8 *s,const Uint8 *a,int n);
+    void BlendPalette(Uint8 *d,const Uint8 *s,const Uint8 *a,int n);
+
+    static bool vectorized;
+
+    SDL_PixelFormat *format;
+    int width,height;
+    std::vector<Uint8> mask;
+    bool empty;
+    SDL_Color color;
+    Uint32 pixel;
+    // The bytes of the color, in the order they are in memory, for formats of 24 and 32 bits
+    Uint8 bytes[4];
+};
+
+#endif
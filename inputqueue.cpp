@@ -0,0 +1,246 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "inputqueue.h"
+
+#include <time.h>
+#include <errno.h>
+
+// While events are arriving, SDL is checked every millisecond. After this time without events, every 10 milliseconds.
+static const Uint64 ActivePeriod = 200000000ULL;
+static const Uint32 ActiveDelay = 1;
+static const Uint32 IdleDelay = 10;
+
+InputQueue::InputQueue(bool threaded_events)
+{
+ threaded=threaded_events;
+ thread=nullptr;
+ running=false;
+ replay_fast=false;
+ head=0;
+ tail=0;
+ max_depth=0;
+ lat_count=lat_sum=lat_max=0;
+ if ((ready=SDL_CreateSemaphore(0))==nullptr)
+ {
+  std::cerr << "Error creating the semaphore of the input queue. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+}
+
+InputQueue::~InputQueue()
+{
+ Stop();
+ SDL_DestroySemaphore(ready);
+}
+
+Uint64 InputQueue::Now(void)
+{
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC,&ts);
+ return Uint64(ts.tv_sec)*1000000000ULL+Uint64(ts.tv_nsec);
+}
+
+void InputQueue::Start(void)
+{
+ if (!threaded || (thread!=nullptr))
+  return;
+ running=true;
+ if ((thread=SDL_CreateThread(Run,this))==nullptr)
+ {
+  std::cerr << "Warning: cannot create the input thread. Events will be read by the main loop.\n";
+  running=false;
+  threaded=false;
+ }
+}
+
+void InputQueue::StartReplay(const std::vector<InputEvent> &events,bool fast)
+{
+ if (thread!=nullptr)
+  return;
+ replay=events;
+ replay_fast=fast;
+ running=true;
+ if ((thread=SDL_CreateThread(Replay,this))==nullptr)
+ {
+  std::cerr << "Error creating the thread that replays the trace. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+ // From now on, events come only through the ring
+ threaded=true;
+}
+
+void InputQueue::Stop(void)
+{
+ if (thread==nullptr)
+  return;
+ running=false;
+ SDL_WaitThread(thread,nullptr);
+ thread=nullptr;
+}
+
+bool InputQueue::Push(const InputEvent &ie)
+{
+ size_t h=head.load(std::memory_order_relaxed);
+ if (h-tail.load(std::memory_order_acquire)>=Capacity)
+  return false;
+ ring[h & (Capacity-1)]=ie;
+ head.store(h+1,std::memory_order_release);
+ return true;
+}
+
+bool InputQueue::Pop(InputEvent &ie)
+{
+ size_t t=tail.load(std::memory_order_relaxed);
+ size_t d=head.load(std::memory_order_acquire)-t;
+ if (d==0)
+  return false;
+ if (d>max_depth)
+  max_depth=d;
+ ie=ring[t & (Capacity-1)];
+ tail.store(t+1,std::memory_order_release);
+ return true;
+}
+
+size_t InputQueue::Depth(void)
+{
+ return head.load(std::memory_order_acquire)-tail.load(std::memory_order_acquire);
+}
+
+int InputQueue::Run(void *data)
+{
+ InputQueue *q=static_cast<InputQueue *>(data);
+ SDL_Event ev[64];
+ Uint64 last=0;
+ while (q->running)
+ {
+  // SDL_PeepEvents is safe from any thread; the events are pumped by the event thread of SDL itself.
+  int n=SDL_PeepEvents(ev,64,SDL_GETEVENT,SDL_ALLEVENTS);
+  if (n<=0)
+  {
+   SDL_Delay((InputQueue::Now()-last<ActivePeriod) ? ActiveDelay : IdleDelay);
+   continue;
+  }
+  // All the events taken at once arrived since the former check, so they share the stamp
+  InputEvent ie;
+  ie.stamp=last=InputQueue::Now();
+  for (int i=0;i<n;i++)
+  {
+   ie.event=ev[i];
+   q->Feed(ie);
+  }
+ }
+ return 0;
+}
+
+void InputQueue::Feed(InputEvent &ie)
+{
+ // If the main loop is so late that the ring is full, we wait for it instead of losing events
+ while (!Push(ie) && running)
+  SDL_Delay(ActiveDelay);
+ SDL_SemPost(ready);
+}
+
+int InputQueue::Replay(void *data)
+{
+ InputQueue *q=static_cast<InputQueue *>(data);
+ Uint64 base=InputQueue::Now();
+ for (unsigned int i=0;(i<q->replay.size()) && q->running;i++)
+ {
+  InputEvent ie=q->replay[i];
+  if (!q->replay_fast)
+  {
+   // Sleeping until the absolute time of the event keeps the pace without accumulating delays
+   Uint64 t=base+ie.stamp;
+   struct timespec ts;
+   ts.tv_sec=time_t(t/1000000000ULL);
+   ts.tv_nsec=long(t%1000000000ULL);
+   while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,nullptr)==EINTR)
+    ;
+  }
+  // The stamp is the moment the event is passed, as if it had been read from SDL now
+  ie.stamp=InputQueue::Now();
+  q->Feed(ie);
+ }
+
+ InputEvent end;
+ memset(&end,0,sizeof(InputEvent));
+ end.event.type=SDL_USEREVENT;
+ end.event.user.type=SDL_USEREVENT;
+ end.event.user.code=EndOfTrace;
+ end.stamp=InputQueue::Now();
+ q->Feed(end);
+ return 0;
+}
+
+bool InputQueue::ReadFromSDL(InputEvent &ie)
+{
+ SDL_PumpEvents();
+ if (SDL_PeepEvents(&ie.event,1,SDL_GETEVENT,SDL_ALLEVENTS)<=0)
+  return false;
+ ie.stamp=Now();
+ return true;
+}
+
+bool InputQueue::Wait(InputEvent &ie,Uint32 timeout)
+{
+ if (threaded)
+ {
+  int r=(timeout==SDL_MUTEX_MAXWAIT) ? SDL_SemWait(ready) : SDL_SemWaitTimeout(ready,timeout);
+  if (r!=0)
+   return false;
+  // If the semaphore was posted by Wake, there may be no event
+  return Pop(ie);
+ }
+
+ // Without input thread, the events are read here, sleeping in between as SDL_WaitEvent does (but waking up if Wake is called).
+ Uint64 end=(timeout==SDL_MUTEX_MAXWAIT) ? 0 : Now()+Uint64(timeout)*1000000ULL;
+ while (true)
+ {
+  if (ReadFromSDL(ie))
+   return true;
+  if ((end!=0) && (Now()>=end))
+   return false;
+  if (SDL_SemWaitTimeout(ready,IdleDelay)==0)
+   return false;
+ }
+}
+
+void InputQueue::Wake(void)
+{
+ SDL_SemPost(ready);
+}
+
+void InputQueue::Displayed(const InputEvent &ie)
+{
+ Uint64 l=Now()-ie.stamp;
+ lat_count++;
+ lat_sum+=l;
+ if (l>lat_max)
+  lat_max=l;
+}
+
+void InputQueue::PrintStatistics(std::ostream &out)
+{
+ out << "Input: " << (threaded ? "read by its own thread" : "read by the main loop");
+ out << ", maximum queue depth " << max_depth << " events\n";
+ if (lat_count>0)
+  out << "Input to display latency: mean " << (lat_sum/lat_count)/1000 << " us, max " << lat_max/1000 << " us ("
+      << lat_count << " events)\n";
+}
@@ -0,0 +1,159 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef INPUTQUEUE_H
+#define INPUTQUEUE_H
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include <SDL/SDL_mutex.h>
+
+/**
+ * An event as read from SDL, with the moment it was read
+ */
+struct InputEvent
+{
+ SDL_Event event;
+ Uint64 stamp;       // Nanoseconds of the monotonic clock
+};
+
+/*! \brief Class to read the input events in a thread of their own
+ *
+ * SDL 1.2 keeps at most 128 pending events, and mouse motions are lost (or arrive late) if the program is busy
+ * rendering a slide or saving a file when the pen moves. The InputQueue runs a thread that does nothing but
+ * taking the events from SDL as soon as they arrive, stamping them with the time of a monotonic clock and passing
+ * them to the main thread through a ring buffer.
+ *
+ * The ring has a single producer (the input thread) and a single consumer (the main loop), so it needs no locks:
+ * each end only writes its own index. A semaphore counts the events in the ring, so that the main loop can sleep
+ * while there is nothing to do, exactly as it did with SDL_WaitEvent.
+ *
+ * This needs SDL to pump the events in a thread of its own (SDL_INIT_EVENTTHREAD). If it could not be started,
+ * the queue works without thread: the main loop reads the events from SDL by itself when waiting for one.
+ *
+ * The stamps allow to measure the latency from the moment the pen moved to the moment the line was on the screen.
+ *
+ * Instead of reading SDL, the thread can replay a recorded trace, at the recorded pace or as fast as the main loop
+ * can take the events. After the last one, an SDL_USEREVENT with code EndOfTrace is passed.
+*/
+class InputQueue
+{
+ public:
+    /**
+     * Number of events that the ring can keep. It must be a power of 2.
+     */
+    static const size_t Capacity = 4096;
+
+    /**
+     * Code of the SDL_USEREVENT that follows the last event of a replayed trace
+     */
+    static const int EndOfTrace = 1;
+
+    /**
+     * Constructor. It does not start the thread.
+     * \param threaded_events true if SDL has been initialized with its own event thread, so that events can be read from another thread
+     */
+    InputQueue(bool threaded_events);
+
+    /**
+     * Destructor. It stops the thread, if it was running.
+     */
+    ~InputQueue();
+
+    /**
+     * Starts the input thread (if events can be read from a thread)
+     */
+    void Start(void);
+
+    /**
+     * Starts the thread that replays a trace. Events are not read from SDL in this case.
+     * \param events The events of the trace, with stamps relative to the first one
+     * \param fast true to pass the events as fast as possible, false to keep the recorded pace
+     */
+    void StartReplay(const std::vector<InputEvent> &events,bool fast);
+
+    /**
+     * Stops the input thread. It must be called before SDL is closed.
+     */
+    void Stop(void);
+
+    /**
+     * Waits for an event
+     * \param ie The event, returned by reference
+     * \param timeout Maximum time to wait, in milliseconds. SDL_MUTEX_MAXWAIT to wait forever.
+     * \return true if an event was returned, false if the time expired or the wait was interrupted by Wake
+     */
+    bool Wait(InputEvent &ie,Uint32 timeout);
+
+    /**
+     * Makes Wait return, even if there are no events. It can be called from any thread.
+     */
+    void Wake(void);
+
+    /**
+     * Gets the number of events waiting in the ring
+     * \return The number of events
+     */
+    size_t Depth(void);
+
+    /**
+     * Notes that the effect of an event is already on the screen, to measure the latency
+     * \param ie The event
+     */
+    void Displayed(const InputEvent &ie);
+
+    /**
+     * Writes the maximum depth reached by the ring and the input-to-display latencies measured with Displayed
+     * \param out The stream to write to
+     */
+    void PrintStatistics(std::ostream &out);
+
+    /**
+     * Gets the current time of the monotonic clock
+     * \return Time in nanoseconds
+     */
+    static Uint64 Now(void);
+
+ private:
+    static int Run(void *data);
+    static int Replay(void *data);
+    void Feed(InputEvent &ie);
+    bool Push(const InputEvent &ie);
+    bool Pop(InputEvent &ie);
+    bool ReadFromSDL(InputEvent &ie);
+
+    bool threaded;
+    SDL_Thread *thread;
+    std::atomic<bool> running;
+    SDL_sem *ready;
+
+    std::vector<InputEvent> replay;
+    bool replay_fast;
+
+    InputEvent ring[Capacity];
+    // head is only written by the producer and tail only by the consumer
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+
+    size_t max_depth;
+    Uint64 lat_count,lat_sum,lat_max;
+};
+
+#endif
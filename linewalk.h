@@ -0,0 +1,71 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef LINEWALK_H
+#define LINEWALK_H
+
+#include <cstdlib>
+#include <algorithm>
+
+// The walk along the straight lines of the pen, shared by the pen itself, the highlighter and the pointer, so that the
+// three of them put their brush at the same points.
+
+/**
+ * Walks a straight line with the algorithm of Bresenham, calling plot at each of its points except the last one (which is
+ * the first one of the next line of a stroke)
+ * \param xa Value of coordinate x of the start of the line
+ * \param ya Value of coordinate y of the start of the line
+ * \param xb Value of coordinate x of the end of the line
+ * \param yb Value of coordinate y of the end of the line
+ * \param plot What is done at each point, called as plot(x,y)
+ */
+template <class Plot> inline void WalkLine(int xa,int ya,int xb,int yb,Plot plot)
+{
+ int dx=abs(xb-xa);
+ int dy=abs(yb-ya);
+ int sx=((xb-xa)>0) ? 1 : -1;
+ int sy=((yb-ya)>0) ? 1 : -1;
+
+ int x=xa;
+ int y=ya;
+
+ bool steep=false;
+ if (dy>dx)
+ {
+  steep=true;
+  std::swap(x,y);
+  std::swap(dx,dy);
+  std::swap(sx,sy);
+ }
+ int e=2*dy-dx;
+ for (int i=0;i<dx;i++)
+ {
+  if (steep)
+   plot(y,x);
+  else
+   plot(x,y);
+  while (e>=0)
+  {
+   y+=sy;
+   e-=2*dx;
+  }
+  x+=sx;
+  e+=2*dy;
+ }
+}
+
+#endif
@@ -19,60 +19,542 @@
 // config.h does not need to be explicitly included, since canvas and pdfslides include it.
 #include "canvas.h"
 #include "pdfslides.h"
+#include "session.h"
+#include "inputqueue.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "profiler.h"
+#include "memmonitor.h"
+#include "boards.h"
+#include "zoomview.h"
+#include "overview.h"
+#include "search.h"
+#include "filewatcher.h"
+
+#include <unistd.h>
+
+/**
+ * Maximum time, in milliseconds, that the program waits for a slide to be rendered when going to it.
+ * After that, the traces are shown alone and the slide will appear when it is ready.
+ */
+static const Uint32 MaxSlideWait = 50;
+
+/**
+ * Time, in milliseconds, between two refreshes of the performance figures (the HUD), when it is shown
+ */
+static const Uint32 HudPeriod = 500;
+
+/**
+ * Gets how long the main loop may wait for events before something has to be redrawn by itself (the HUD, or the ink of the pointer)
+ * \param cnv The canvas
+ * \return Milliseconds, or SDL_MUTEX_MAXWAIT to wait until an event arrives
+ */
+static Uint32 WaitTime(Canvas &cnv)
+{
+ return std::min((cnv.HudActive()) ? HudPeriod : Uint32(SDL_MUTEX_MAXWAIT),cnv.PointerWait());
+}
+
+/**
+ * Default maximum growth, in MB, of the resident size of the program along a soak run
+ */
+static const int DefaultSoakGrowth = 32;
+
+/**
+ * Strokes drawn on each slide by the synthetic workload of the soak mode, and segments of each stroke
+ */
+static const int SoakStrokes = 8;
+static const int SoakSegments = 40;
+
+/**
+ * Every how many cycles the synthetic workload erases the traces of all the slides
+ */
+static const int SoakErasePeriod = 10;
+
+/**
+ * Writes how the program is called, and ends it
+ * \param prog Name of the program
+ */
+static void Usage(const char *prog)
+{
+ std::cerr << "Usage: " << prog << " [-H] [-r trace_file | -p trace_file [-f]] [-s cycles [-m MB]] [-o image.pnm] [pdf_file]\n";
+ std::cerr << "       If no pdf file is given, an empty blackboard is opened.\n";
+ std::cerr << "       -H  run without display (headless), drawing only in memory\n";
+ std::cerr << "       -r  record the input events to trace_file\n";
+ std::cerr << "       -p  replay the input events of trace_file, and end when they are over\n";
+ std::cerr << "       -f  replay as fast as possible, instead of at the recorded pace\n";
+ std::cerr << "       -s  soak: do the work (the replayed trace, or else a synthetic one) that number of times, as fast as possible,\n";
+ std::cerr << "           sampling the memory after each one, and fail if it grows too much\n";
+ std::cerr << "       -m  maximum growth of the memory in a soak run, in MB (" << DefaultSoakGrowth << " by default)\n";
+ std::cerr << "       -o  write the final blackboard (slide and traces) to image.pnm when the program ends\n";
+ std::cerr << "       Any other configuration is done via config files, either \n";
+ std::cerr << "          '$HOME/" << Config::ConfigFileNameLocal << "' or\n";
+ std::cerr << "          '" << Config::DefaultGlobalConfigDir << Config::ConfigFileNameGlobal << "'\n";
+ std::cerr << "       in that order of preference.\n";
+ exit(1);
+}
+
+/**
+ * Redraws the canvas with a slide and the traces over it
+ * \param cnv The canvas
+ * \param s The surface of the slide, or nullptr for no slide
+ */
+static void ShowSlide(Canvas &cnv,SDL_Surface *s)
+{
+ cnv.Erase(Canvas::Slide);
+ cnv.Show(s);
+ cnv.Merge();
+ cnv.Update(Canvas::Both);
+}
+
+/**
+ * Goes to a slide chosen by its number (from the overview or the search), keeping the traces of the slide left and restoring those of the new one
+ * \param cnv The canvas
+ * \param sld The slides
+ * \param ses The session store
+ * \param page The slide, from 0
+ * \param wait Whether the slide is always waited for (when replaying) or only for MaxSlideWait milliseconds
+ */
+static void GoToSlide(Canvas &cnv,PDFSlides &sld,SessionStore &ses,int page,bool wait)
+{
+ int former_page=sld.GetCurrentPage();
+ if (sld.GoToPage(page))
+ {
+  ses.Keep(former_page,cnv);
+  ses.Restore(sld.GetCurrentPage(),cnv);
+ }
+ ShowSlide(cnv,(wait || sld.WaitCurrentPage(MaxSlideWait)) ? sld.GetCurrentPageSurface() : nullptr);
+}
+
+/**
+ * Refreshes the performance figures in the menu bar, if the HUD is shown and its period has passed. It is called after every event and whenever the main loop wakes up.
+ * \param cnv The canvas
+ * \param sld The slides
+ * \param ses The session store
+ * \param boards The blank boards
+ * \param inq The input queue
+ */
+static void RefreshHud(Canvas &cnv,PDFSlides &sld,SessionStore &ses,BoardStack &boards,InputQueue &inq)
+{
+ // When the HUD was refreshed last, and the frames drawn up to then. A time of 0 means that it has just been shown.
+ static Uint64 last_time=0,last_frames=0;
+
+ if (!cnv.HudActive() || cnv.OverlayActive())
+ {
+  last_time=0;
+  return;
+ }
+ Uint64 now=InputQueue::Now();
+ if ((last_time!=0) && (now-last_time<Uint64(HudPeriod)*1000000ULL))
+  return;
+
+ double fps=(last_time==0) ? 0.0 : double(cnv.GetFrames()-last_frames)*1e9/double(now-last_time);
+ Uint64 asked=sld.GetCacheHits()+sld.GetCacheMisses();
+ char s[256];
+ snprintf(s,sizeof(s),"%.0f fps | render %.1f ms | merge %.1f ms | cache hits %d%% | pages %.1f MB | ink %.1f MB | queue %u",
+          fps,double(sld.GetLastRenderTime())/1e6,double(cnv.GetLastMergeTime())/1e6,
+          (asked>0) ? int(100*sld.GetCacheHits()/asked) : 100,double(sld.MemoryUse())/1048576.0,
+          double(cnv.MemoryUse()+ses.MemoryUse()+boards.MemoryUse())/1048576.0,unsigned(inq.Depth()));
+ cnv.DrawHud(s);
+ last_time=now;
+ last_frames=cnv.GetFrames();
+}
+
+/**
+ * Shows all the slides, one after the other, measuring the time of each one. This is what the program does without display.
+ * \param cnv The canvas
+ * \param sld The slides, with the first one as current
+ * \param ses The session store, to restore the traces of each slide as it would be done by the user
+ * \param prof The profiler, which records each change of slide, or nullptr
+ */
+static void WalkSlides(Canvas &cnv,PDFSlides &sld,SessionStore &ses,Profiler *prof)
+{
+ int pages=sld.GetNumPages();
+ Uint64 total=0,slowest=0;
+ int slowest_page=0;
+ for (int i=0;i<pages;i++)
+ {
+  Uint64 t=InputQueue::Now();
+  if (i>0)
+  {
+   int former_page=sld.GetCurrentPage();
+   sld.ExecuteCommand(Config::Next);
+   ses.Keep(former_page,cnv);
+   ses.Restore(sld.GetCurrentPage(),cnv);
+  }
+  ShowSlide(cnv,sld.GetCurrentPageSurface());
+  if (prof!=nullptr)
+   prof->Record(Profiler::SlideChange,t,InputQueue::Now());
+  t=InputQueue::Now()-t;
+  total+=t;
+  if (t>slowest)
+  {
+   slowest=t;
+   slowest_page=sld.GetCurrentPage();
+  }
+ }
+ std::cout << "Headless run: " << pages << " slides in " << total/1000000 << " ms";
+ if (pages>0)
+  std::cout << " (mean " << total/pages/1000 << " us, slowest " << slowest/1000 << " us on slide " << slowest_page+1 << ")";
+ std::cout << ", " << cnv.GetPresenter()->GetUpdates() << " updates of " << cnv.GetPresenter()->GetUpdatedPixels() << " pixels\n";
+}
+
+/**
+ * Draws a stroke at random, as the pen would do
+ * \param cnv The canvas
+ * \param seed The state of the pseudo-random generator, changed by reference
+ */
+static void SoakStroke(Canvas &cnv,Uint32 &seed)
+{
+ SDL_Surface *ink=cnv.GetInk();
+ // The stroke stays away from the borders and from the menu, so that no point falls out of the drawing area
+ int margin=Canvas::MaxLWidth;
+ int top=ink->h/8;
+ int w=ink->w-2*margin;
+ int h=ink->h-top-margin;
+ if ((w<=0) || (h<=0))
+  return;
+ seed=seed*1103515245+12345;
+ cnv.SetLineWidth(1+int((seed>>16)%Canvas::MaxLWidth));
+ seed=seed*1103515245+12345;
+ int x=margin+int((seed>>8)%w);
+ seed=seed*1103515245+12345;
+ int y=top+int((seed>>8)%h);
+ cnv.SetTracing(true);
+ cnv.SetCoords(x,y);
+ for (int i=0;i<SoakSegments;i++)
+ {
+  seed=seed*1103515245+12345;
+  x+=int((seed>>16)%17)-8;
+  seed=seed*1103515245+12345;
+  y+=int((seed>>16)%17)-8;
+  x=std::min(std::max(x,margin),margin+w-1);
+  y=std::min(std::max(y,top),top+h-1);
+  cnv.Drawline(x,y);
+ }
+ cnv.SetTracing(false);
+}
+
+/**
+ * Does the synthetic work of the soak mode: in each cycle, all the slides are shown one after the other, some strokes are drawn
+ * on each one, and then the program goes back to the first one. Now and then, the traces are erased. The memory is sampled after each cycle.
+ * \param cnv The canvas
+ * \param sld The slides, with the first one as current
+ * \param ses The session store, which keeps the traces of each slide as it would be done by the user
+ * \param mon The memory monitor
+ * \param cycles The number of cycles
+ */
+static void SoakSlides(Canvas &cnv,PDFSlides &sld,SessionStore &ses,MemoryMonitor &mon,int cycles)
+{
+ // Without slides, the work is done on the empty blackboard
+ int steps=std::max(sld.GetNumPages(),1);
+ Uint32 seed=1;
+ for (int c=1;c<=cycles;c++)
+ {
+  for (int i=0;i<steps;i++)
+  {
+   int former_page=sld.GetCurrentPage();
+   if ((i>0) && sld.ExecuteCommand(Config::Next))
+   {
+    ses.Keep(former_page,cnv);
+    ses.Restore(sld.GetCurrentPage(),cnv);
+    ShowSlide(cnv,sld.GetCurrentPageSurface());
+   }
+   if (c%SoakErasePeriod==0)
+    cnv.ExecuteCommand(Config::EraseBlackb,sld.GetCurrentPageSurface());
+   else
+    for (int j=0;j<SoakStrokes;j++)
+     SoakStroke(cnv,seed);
+  }
+  int former_page=sld.GetCurrentPage();
+  if (sld.ExecuteCommand(Config::ToFirstSlide))
+  {
+   ses.Keep(former_page,cnv);
+   ses.Restore(sld.GetCurrentPage(),cnv);
+   ShowSlide(cnv,sld.GetCurrentPageSurface());
+  }
+  mon.Sample(c,std::cout);
+ }
+}
 
 /**
  * The entry point of the program
- * \param argc The number of arguments. It will be checked that it is 1 (the program name) or 2 (the program name and the PDF file to load, if any)
- * \param argv The argument. argv[0] will be the name of the program. argv[1] the name of the .pdf file with the slides (if present).
+ * \param argc The number of arguments
+ * \param argv The arguments. argv[0] will be the name of the program, then the options (see Usage) and the name of the .pdf file with the slides (if present).
  * \return 0 on success, 1 on abormal or premature exit by error
  */
 int main(int argc,char *argv[])
 {
- if (argc>2)
+ bool headless=false,fast=false;
+ std::string record_file,replay_file,image_file;
+ int soak_cycles=0,soak_growth=DefaultSoakGrowth;
+ int opt;
+ while ((opt=getopt(argc,argv,"Hr:p:fs:m:o:"))!=-1)
  {
-  std::cerr << "Usage: " << argv[0] << " [pdf_file]\n";
-  std::cerr << "       If no pdf file is given, an empty blackboard is opened.\n";
-  std::cerr << "       This program has no other command-line parameters.\n";
-  std::cerr << "       Configuration is done via config files, either \n";
-  std::cerr << "          '$HOME/" << Config::ConfigFileNameLocal << "' or\n";
-  std::cerr << "          '" << Config::DefaultGlobalConfigDir << Config::ConfigFileNameGlobal << "'\n";
-  std::cerr << "       in that order of preference.\n";
-  exit(1);
+  switch (opt)
+  {
+   case 'H': headless=true; break;
+   case 'r': record_file=optarg; break;
+   case 'p': replay_file=optarg; break;
+   case 'f': fast=true; break;
+   case 's': soak_cycles=atoi(optarg); if (soak_cycles<=0) Usage(argv[0]); break;
+   case 'm': soak_growth=atoi(optarg); if (soak_growth<0) Usage(argv[0]); break;
+   case 'o': image_file=optarg; break;
+   default: Usage(argv[0]); break;
+  }
  }
+ if ((optind<argc-1) || (!record_file.empty() && !replay_file.empty()) || (!record_file.empty() && (soak_cycles>0)))
+  Usage(argv[0]);
+ bool replaying=!replay_file.empty();
+ // A soak run goes always as fast as possible
+ if (soak_cycles>0)
+  fast=true;
  
  // The name of the pdf file to be loaded, or the empty string if no one is passed (empty blackboard)
- std::string fname=(argc==2) ? std::string(argv[1]) : "";
+ std::string fname=(optind<argc) ? std::string(argv[optind]) : "";
  
- // The configuration object is populated with the values from the configuration files 
+ // The configuration object is populated with the values from the configuration files, and then with the options
  Config cfg;
+ if (headless)
+  cfg.SetHeadless(true);
+ if (soak_cycles>0)
+  cfg.SetSoakMode();
+ if (!record_file.empty() || replaying)
+  cfg.SetTraceMode();
+
+ // The trace to replay is read before opening anything
+ std::vector<InputEvent> trace_events;
+ int trace_w=0,trace_h=0;
+ if (replaying)
+  InputTrace::Load(replay_file,trace_events,trace_w,trace_h);
+
+ // In a soak run, the trace is repeated, each time after the former one, with an event that asks for a sample at the end of each repetition
+ if (replaying && (soak_cycles>0))
+ {
+  std::vector<InputEvent> once;
+  once.swap(trace_events);
+  Uint64 length=(once.empty()) ? 0 : once.back().stamp;
+  InputEvent sample;
+  memset(&sample,0,sizeof(sample));
+  sample.event.type=SDL_USEREVENT;
+  sample.event.user.code=MemoryMonitor::SampleEvent;
+  for (int c=0;c<soak_cycles;c++)
+  {
+   Uint64 offset=Uint64(c)*length;
+   for (size_t i=0;i<once.size();i++)
+   {
+    trace_events.push_back(once[i]);
+    trace_events.back().stamp+=offset;
+   }
+   sample.stamp=offset+length;
+   trace_events.push_back(sample);
+  }
+ }
 
  // A canvas is created, according to the values stored in config
  Canvas cnv(cfg);
+
+ SDL_Surface *screen=cnv.GetPresenter()->GetSurface();
+ if (replaying && ((trace_w!=screen->w) || (trace_h!=screen->h)))
+  std::cerr << "Warning: the trace was recorded at " << trace_w << "x" << trace_h << " and it is replayed at " << screen->w << "x" << screen->h
+            << ". The result will not be the same.\n";
+ InputTrace *recorder=(record_file.empty()) ? nullptr : new InputTrace(record_file,screen->w,screen->h);
+
+ // Events are read by a thread of their own, so that no pen movement is lost while the main loop is busy.
+ InputQueue inq(cnv.GetThreadedEvents());
+
+ // Rendering of slides and saving of blackboards are done in the background. When a job has something for the main loop, it wakes it up.
+ Scheduler sched;
+ sched.SetWakeup([&inq]() { inq.Wake(); });
+ // When replaying, blackboards are saved in the main thread, so that the messages appear always at the same moment
+ if (!replaying)
+  cnv.SetScheduler(&sched);
  
  // A PSDSlides structure if filled with the characteristics of the splash file (if needed) and PDF file (if read)
- PDFSlides sld(cfg,fname);
+ PDFSlides sld(cfg,fname,sched);
+
+ // The main operations are measured only if statistics or a trace of the measures are asked for
+ Profiler *prof=nullptr;
+ if (cfg.GetStatistics() || !cfg.GetProfileFile().empty())
+  prof=new Profiler(!cfg.GetProfileFile().empty());
+ cnv.SetProfiler(prof);
+ sld.SetProfiler(prof);
  
- // This loads the splash screen (if requested), draws the upper menu (always) and the first slide (it there are slides). Then, it redraws the canvas.
+ // The traces of former executions on this same document (if sessions are kept) are mapped, but only those of the first slide are decoded now.
+ SessionStore ses(cfg,sld,cnv,sched);
+ ses.Restore(sld.GetCurrentPage(),cnv);
+
+ // Without slides, the navigation keys go through the blank boards
+ BoardStack boards(ses);
+ if (sld.GetNumPages()==0)
+  boards.Open(cnv);
+ // The slides are shown whole until they are zoomed
+ ZoomView zoom;
+ // The thumbnails of the slides start to be rendered now, in the background
+ Overview overview(cfg,sld,sched);
+ // And the text of the slides goes to the index of the search
+ SlideSearch search(cfg,sld,sched);
+
+ // In a soak run, the memory of the process and that of each subsystem is followed
+ MemoryMonitor *mon=nullptr;
+ if (soak_cycles>0)
+ {
+  mon=new MemoryMonitor(Uint64(soak_growth)*1048576ULL);
+  mon->AddSubsystem("slide cache",[&sld]() { return sld.MemoryUse(); });
+  mon->AddSubsystem("canvas",[&cnv]() { return cnv.MemoryUse(); });
+  mon->AddSubsystem("session",[&ses]() { return ses.MemoryUse(); });
+  mon->AddSubsystem("boards",[&boards]() { return boards.MemoryUse(); });
+  mon->AddSubsystem("zoom",[&zoom]() { return zoom.MemoryUse(); });
+  mon->AddSubsystem("overview",[&overview]() { return overview.MemoryUse(); });
+  mon->AddSubsystem("search",[&search]() { return search.MemoryUse(); });
+ }
+ int soak_cycle=0;
+
+ // When the PDF file is written again (compiled, for instance), it is reloaded. Not when replaying nor in a soak run, whose results
+ // must depend only on the trace or on the synthetic work.
+ FileWatcher *watcher=nullptr;
+ if (!sld.GetFileName().empty() && !replaying && (mon==nullptr) && cnv.GetPresenter()->Interactive())
+  watcher=new FileWatcher(sld.GetFileName(),[&sched,&sld]() { sched.PostToMain([&sld]() { sld.StartReload(); }); });
+
+ // This draws the upper menu (always) and the first slide (it there are slides) with its traces. Then, it shows the splash screen over them (if requested) or redraws the canvas.
  cnv.Prepare(cfg,sld.GetSplashSurface(),sld.GetCurrentPageSurface());
  
+ if (replaying)
+  inq.StartReplay(trace_events,fast);
+ else
+  inq.Start();
+
  // These are the variable for the main loop whose values will change at any turn according to the user's mouse clicks or key presses.
+ InputEvent iev;
  SDL_Event ev;
  Config::Commands command=Config::NoCommand;
  bool sent_to_canvas=true;
+
+ // Without display (and without trace to replay), nobody can send events: the slides are shown once and the program ends.
+ if (!cnv.GetPresenter()->Interactive() && !replaying && (mon==nullptr))
+ {
+  WalkSlides(cnv,sld,ses,prof);
+  command=Config::Quit;
+ }
+ // A soak run without trace does the synthetic work instead of waiting for the user
+ if ((mon!=nullptr) && !replaying)
+ {
+  SoakSlides(cnv,sld,ses,*mon,soak_cycles);
+  command=Config::Quit;
+ }
  
  while (command!=Config::Quit)
  {
-  // All keyboard or mouse events are read, but only those relevant will be processed
-  while (SDL_WaitEvent(&ev) && (command!=Config::Quit))
+  // What the jobs of the scheduler have left for the main loop is done first. Then, unless a pop-up box is in the way,
+  // the current slide is shown if it was not ready when we went to it, and messages of finished jobs are shown.
+  sched.RunMainTasks();
+  if (!cnv.OverlayActive())
   {
+   if (sld.CurrentPageArrived() && !boards.Active() && !zoom.Active() && !overview.Active())
+    ShowSlide(cnv,sld.GetCurrentPageSurface());
+   // The tiles of the zoomed slide are put in the view as they arrive
+   if (sld.ZoomTilesArrived() && !boards.Active() && !overview.Active())
+    zoom.Refresh(cnv,sld);
+   // Once the pages of a reloaded document have been compared, it replaces the former one, and the rest follows it
+   if (sld.ReloadArrived())
+   {
+    std::vector<bool> changed;
+    int former_page=sld.GetCurrentPage();
+    // While the boards are shown, the canvas has the traces of a board, and those of the slide are kept by the stack
+    if (boards.Active())
+     boards.KeepSlide(former_page);
+    else
+     ses.Keep(former_page,cnv);
+    sld.FinishReload(changed);
+    ses.Reload(sld);
+    overview.Reload(changed);
+    search.Reload(changed);
+    if (sld.GetCurrentPage()!=former_page)
+    {
+     if (boards.Active())
+      boards.RestoreSlide(sld.GetCurrentPage());
+     else
+      ses.Restore(sld.GetCurrentPage(),cnv);
+    }
+    // The current slide is shown again only if it has changed
+    if ((sld.GetCurrentPage()!=former_page) || changed[sld.GetCurrentPage()])
+    {
+     zoom.Close();
+     if (!boards.Active() && !overview.Active())
+      ShowSlide(cnv,sld.WaitCurrentPage(MaxSlideWait) ? sld.GetCurrentPageSurface() : nullptr);
+    }
+   }
+   cnv.ShowNotification();
+  }
+  // The search uses the menu bar, like the HUD
+  if (!search.Active())
+   RefreshHud(cnv,sld,ses,boards,inq);
+  cnv.FadePointer();
+
+  // All keyboard or mouse events are read, but only those relevant will be processed.
+  // Wait returns false when the scheduler wakes the loop up, so that the lines above are done, or when the HUD has to be refreshed
+  // or the ink of the pointer has to fade. Without any of them, it sleeps until the next event.
+  while ((command!=Config::Quit) && inq.Wait(iev,WaitTime(cnv)))
+  {
+   ScopedTimer t(prof,Profiler::EventHandling);
+   ev=iev.event;
+   if (recorder!=nullptr)
+    recorder->Record(iev);
    // In principle, the event does not call for any command...   
    command=Config::NoCommand;
+
+   // While a pop-up box (splash screen, message or line characteristics) is shown, it receives all the events.
+   // Nothing is polled inside it: it is the SDL_WaitEvent of this loop which waits (without using CPU) for the user.
+   if (cnv.OverlayActive())
+   {
+    cnv.OverlayEvent(ev);
+    continue;
+   }
+   // While searching, the keys write the query, and the slides found are shown as they are chosen
+   if (search.Active() && (ev.type==SDL_KEYDOWN))
+   {
+    int page=search.Key(ev.key.keysym,cnv);
+    if ((page>=0) && (page!=sld.GetCurrentPage()))
+     GoToSlide(cnv,sld,ses,page,replaying);
+    continue;
+   }
    switch (ev.type)
    {
     // A mouse or pen button (no matters which one) has been pressed.
     case SDL_MOUSEBUTTONDOWN:
+                // A click on the menu bar ends the search, and then does what it would do without it
+                if (search.Active() && !cnv.InsideCanvas(ev.button.y))
+                 search.Close(cnv);
+                // While the overview is shown, a click on a thumbnail goes to its slide and the wheel moves the grid up and down
+                if (overview.Active() && cnv.InsideCanvas(ev.button.y))
+                {
+                 if ((ev.button.button==SDL_BUTTON_WHEELUP) || (ev.button.button==SDL_BUTTON_WHEELDOWN))
+                  overview.Scroll((ev.button.button==SDL_BUTTON_WHEELUP) ? -1 : 1,cnv);
+                 else
+                 {
+                  int page=overview.PageAt(ev.button.x,ev.button.y);
+                  if (page>=0)
+                  {
+                   overview.Close();
+                   GoToSlide(cnv,sld,ses,page,replaying);
+                  }
+                 }
+                }
+                // While a slide is zoomed, the pen does not draw: the wheel moves the slide up and down and any other button drags it
+                else if (zoom.Active() && cnv.InsideCanvas(ev.button.y))
+                {
+                 if ((ev.button.button==SDL_BUTTON_WHEELUP) || (ev.button.button==SDL_BUTTON_WHEELDOWN))
+                  zoom.Pan(0,(ev.button.button==SDL_BUTTON_WHEELUP) ? -Canvas::PanStep : Canvas::PanStep,cnv,sld);
+                 else
+                  zoom.StartDrag(ev.button.x,ev.button.y);
+                }
+                // On a board that can be panned, the wheel moves it up and down and the right button drags it
+                else if (cnv.Pannable() && cnv.InsideCanvas(ev.button.y) &&
+                    ((ev.button.button==SDL_BUTTON_WHEELUP) || (ev.button.button==SDL_BUTTON_WHEELDOWN)))
+                 cnv.Pan(0,(ev.button.button==SDL_BUTTON_WHEELUP) ? -Canvas::PanStep : Canvas::PanStep);
+                else if (cnv.Pannable() && cnv.InsideCanvas(ev.button.y) && (ev.button.button==SDL_BUTTON_RIGHT))
+                 cnv.StartPan(ev.button.x,ev.button.y);
                 // If the click is on the drawing area...
-                if (cnv.InsideCanvas(ev.button.y))
+                else if (cnv.InsideCanvas(ev.button.y))
                 {
                  // ... we will start tracing a line which will follow the mouse/pen, First, internal state becomes 'Tracing'...
                  cnv.SetTracing(true);
@@ -87,15 +569,30 @@ int main(int argc,char *argv[])
                 break;
     // A mouse button is released. This mean the pen/mouse must stop tracing (drawing line when it is moved)
     case SDL_MOUSEBUTTONUP:
-               if (cnv.InsideCanvas(ev.button.y))
+               if (zoom.GetDragging())
+                zoom.EndDrag();
+               else if (cnv.GetPanning())
+                cnv.EndPan();
+               else if (cnv.InsideCanvas(ev.button.y))
                 cnv.SetTracing(false);
                break;  
     // The mouse/pen is being moved
     case SDL_MOUSEMOTION:
                // If we are moving while the mouse/pen button is pressed (Tracing mode), a line is drawn from the internal coordinates of start to the current point.
                // After tracing, drawline updates the internal current coordinates, instead of calling here SetCoords. This is just for efficiency.
-                if (cnv.GetTracing()==true)
-                 cnv.Drawline(ev.button.x,ev.button.y);
+                if (zoom.GetDragging())
+                 zoom.DragTo(ev.motion.x,ev.motion.y,cnv,sld);
+                else if (cnv.GetPanning())
+                 cnv.PanTo(ev.motion.x,ev.motion.y);
+                else if (cnv.GetTracing()==true)
+                {
+                 cnv.Drawline(ev.motion.x,ev.motion.y);
+                 inq.Displayed(iev);
+                 if (prof!=nullptr)
+                  prof->Record(Profiler::PenToScreen,iev.stamp,InputQueue::Now());
+                 // The line may be drawn a little ahead, up to where the pen will be when it is seen
+                 cnv.Predict(ev.motion.x,ev.motion.y,iev.stamp);
+                }
                 break;
     // A key has been pressed
     case SDL_KEYDOWN:
@@ -103,6 +600,13 @@ int main(int argc,char *argv[])
                // Any key not in the table will return NoCommand.
                 command=cfg.InterpretKey(ev.key.keysym.sym,sent_to_canvas);
                 break;
+    // The replayed trace is over
+    case SDL_USEREVENT:
+               if (ev.user.code==InputQueue::EndOfTrace)
+                command=Config::Quit;
+               else if ((ev.user.code==MemoryMonitor::SampleEvent) && (mon!=nullptr))
+                mon->Sample(++soak_cycle,std::cout);
+               break;
     // All other events (key releases, for example) are ignored.
     default: break;
    }
@@ -110,28 +614,132 @@ int main(int argc,char *argv[])
    // The follwoing lines will efectively execute the received commands, it there is something to execute.
    if ((command!=Config::NoCommand) && (command!=Config::Quit))
    {
+    // Any command but those of the zoom (and the HUD, which is in the menu bar) works on the slide shown whole
+    if (zoom.Active() && (command!=Config::ZoomIn) && (command!=Config::ZoomOut) && (command!=Config::ToggleHud))
+    {
+     zoom.Close();
+     ShowSlide(cnv,sld.GetCurrentPageSurface());
+    }
+    // And the same for the overview
+    if (overview.Active() && (command!=Config::ToggleOverview) && (command!=Config::ToggleHud))
+    {
+     overview.Close();
+     ShowSlide(cnv,sld.GetCurrentPageSurface());
+    }
     // In the case of commands for the Canvas, it is the Canvas object itself which does the redraw, as needed (only of the slides, the traces, or both things).
     // This is tricky so it is better to do it inside the canvas, where all these things are accessible.
     if ( sent_to_canvas )
-     cnv.ExecuteCommand(command,sld.GetCurrentPageSurface());
+     cnv.ExecuteCommand(command,(boards.Active()) ? nullptr : sld.GetCurrentPageSurface());
+    // While the blank boards are shown, they take the navigation commands. They are opened and closed only if there are slides.
+    else if (command==Config::ToggleBoards)
+    {
+     if (sld.GetNumPages()>0)
+     {
+      if (boards.Active())
+       boards.Close(cnv);
+      else
+       boards.Open(cnv);
+      ShowSlide(cnv,(boards.Active()) ? nullptr : sld.GetCurrentPageSurface());
+     }
+    }
+    // The search is only of the slides
+    else if (command==Config::Search)
+    {
+     if (!boards.Active() && (sld.GetNumPages()>0))
+      search.Open(cnv);
+    }
+    // The overview is only of the slides
+    else if (command==Config::ToggleOverview)
+    {
+     if (overview.Active())
+     {
+      overview.Close();
+      ShowSlide(cnv,sld.GetCurrentPageSurface());
+     }
+     else if (!boards.Active())
+      overview.Open(cnv);
+    }
+    // Only the slides are zoomed
+    else if ((command==Config::ZoomIn) || (command==Config::ZoomOut))
+    {
+     if (!boards.Active() && (sld.GetNumPages()>0))
+     {
+      bool changed=(command==Config::ZoomIn) ? zoom.ZoomIn(cnv,sld) : zoom.ZoomOut(cnv,sld);
+      if (changed && !zoom.Active())
+       ShowSlide(cnv,sld.GetCurrentPageSurface());
+     }
+    }
+    else if (boards.Active())
+    {
+     if (boards.ExecuteCommand(command,cnv))
+      ShowSlide(cnv,nullptr);
+    }
     else
+    {
      // In the case of commans for the PDFSLides, in general, it will always need redraw, unless the command has not been executed
      // (for example: trying to advance after the last slide, or before the first). ExecuteCommand returns a boolean to know that.
      // This is why ExecuteCommand is a function and not a void, as in the Canvas object.
+     // If sessions are kept, the traces of the slide we leave are kept and those of the new one are restored.
+     int former_page=sld.GetCurrentPage();
      if (sld.ExecuteCommand(command))
      {
-      cnv.Erase(Canvas::Slide);
-      cnv.Show(sld.GetCurrentPageSurface());
-      cnv.Merge();
-      cnv.Update(Canvas::Both);
+      ses.Keep(former_page,cnv);
+      ses.Restore(sld.GetCurrentPage(),cnv);
+      // When replaying, the slide is always waited for, so that the result does not depend on the speed of rendering
+      ShowSlide(cnv,(replaying || sld.WaitCurrentPage(MaxSlideWait)) ? sld.GetCurrentPageSurface() : nullptr);
+      if (prof!=nullptr)
+       prof->Record(Profiler::SlideChange,iev.stamp,InputQueue::Now());
      }
+    }
    }
+   // While drawing, the loop may not be left for a long time, so the HUD is also refreshed (and the pointer faded) here
+   if (!search.Active())
+    RefreshHud(cnv,sld,ses,boards,inq);
+   cnv.FadePointer();
   }
  }
  // We have left the loop by generating the Quit command. 
+ // The traces of the last slide are kept and the session is written (only if something has changed, and never after the strokes of a soak run).
+ if (sld.GetNumPages()>0)
+  boards.Close(cnv);
+ ses.Keep(sld.GetCurrentPage(),cnv);
+ if (mon==nullptr)
+  ses.Save();
+ // Pending saves are finished before leaving, but not the rendering in advance nor that of the thumbnails
+ delete watcher;
+ sld.CancelJobs();
+ ses.CancelJobs();
+ overview.CancelJobs();
+ search.CancelJobs();
+ sched.Stop();
+ // The thumbnails and the rendering times are written once no worker renders them
+ if (mon==nullptr)
+ {
+  overview.Save();
+  sld.SaveCosts();
+ }
+ inq.Stop();
+ delete recorder;
+ if (!image_file.empty() && !cnv.WriteImage(image_file))
+  std::cerr << "Warning: cannot write the image file " << image_file << ".\n";
+ if (cfg.GetStatistics())
+ {
+  inq.PrintStatistics(std::cerr);
+  sched.PrintStatistics(std::cerr);
+  prof->PrintStatistics(std::cerr);
+ }
+ if (!cfg.GetProfileFile().empty() && !prof->WriteTraceEvents(cfg.GetProfileFile()))
+  std::cerr << "Warning: cannot write the profile file " << cfg.GetProfileFile() << ".\n";
+ delete prof;
+ bool soak_passed=true;
+ if (mon!=nullptr)
+ {
+  soak_passed=mon->Report(std::cout);
+  delete mon;
+ }
  cnv.EndSDL();
 
- // Return success (this is the intended way to leave the program).
- return 0;
+ // Return success (this is the intended way to leave the program), unless the memory grew too much in a soak run.
+ return (soak_passed) ? 0 : 1;
 }
 
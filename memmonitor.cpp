@@ -0,0 +1,143 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "memmonitor.h"
+#include "inputqueue.h"
+
+#include <fstream>
+#include <iomanip>
+#include <unistd.h>
+#include <malloc.h>
+
+static const double MB=1048576.0;
+
+MemoryMonitor::MemoryMonitor(Uint64 max_growth)
+{
+ limit=max_growth;
+ start_time=InputQueue::Now();
+ samples=0;
+ first_rss=last_rss=high_rss=0;
+ first_heap=last_heap=high_heap=0;
+ high_arena=0;
+}
+
+void MemoryMonitor::AddSubsystem(const std::string &name,std::function<Uint64(void)> use)
+{
+ Subsystem s;
+ s.name=name;
+ s.use=use;
+ s.high=0;
+ subsystems.push_back(s);
+}
+
+Uint64 MemoryMonitor::ResidentSize(void)
+{
+ // The second field of statm is the number of resident pages
+ std::ifstream f("/proc/self/statm");
+ Uint64 size=0,resident=0;
+ if (!(f >> size >> resident))
+  return 0;
+ return resident*Uint64(sysconf(_SC_PAGESIZE));
+}
+
+Uint64 MemoryMonitor::HeapInUse(void)
+{
+#if defined(__GLIBC__) && ((__GLIBC__>2) || (__GLIBC_MINOR__>=33))
+ struct mallinfo2 mi=mallinfo2();
+ return Uint64(mi.uordblks)+Uint64(mi.hblkhd);
+#elif defined(__GLIBC__)
+ // The fields of the old mallinfo are int, so they wrap above 2 GB
+ struct mallinfo mi=mallinfo();
+ return Uint64(unsigned(mi.uordblks))+Uint64(unsigned(mi.hblkhd));
+#else
+ return 0;
+#endif
+}
+
+Uint64 MemoryMonitor::HeapSize(void)
+{
+#if defined(__GLIBC__) && ((__GLIBC__>2) || (__GLIBC_MINOR__>=33))
+ struct mallinfo2 mi=mallinfo2();
+ return Uint64(mi.arena)+Uint64(mi.hblkhd);
+#elif defined(__GLIBC__)
+ struct mallinfo mi=mallinfo();
+ return Uint64(unsigned(mi.arena))+Uint64(unsigned(mi.hblkhd));
+#else
+ return 0;
+#endif
+}
+
+void MemoryMonitor::Sample(int cycle,std::ostream &out)
+{
+ Uint64 rss=ResidentSize();
+ Uint64 heap=HeapInUse();
+ Uint64 arena=HeapSize();
+ if (samples==0)
+ {
+  first_rss=rss;
+  first_heap=heap;
+  out << "Soak: cycle, seconds, resident MB, heap in use MB, heap kept by malloc MB";
+  for (size_t i=0;i<subsystems.size();i++)
+   out << ", " << subsystems[i].name << " MB";
+  out << "\n";
+ }
+ samples++;
+ last_rss=rss;
+ last_heap=heap;
+ if (rss>high_rss)
+  high_rss=rss;
+ if (heap>high_heap)
+  high_heap=heap;
+ if (arena>high_arena)
+  high_arena=arena;
+
+ out << std::fixed << std::setprecision(1);
+ out << "Soak: " << cycle << ", " << double(InputQueue::Now()-start_time)/1e9 << ", " << double(rss)/MB << ", "
+     << double(heap)/MB << ", " << double(arena)/MB;
+ for (size_t i=0;i<subsystems.size();i++)
+ {
+  Uint64 u=subsystems[i].use();
+  if (u>subsystems[i].high)
+   subsystems[i].high=u;
+  out << ", " << double(u)/MB;
+ }
+ out << "\n";
+ out.unsetf(std::ios::floatfield);
+}
+
+bool MemoryMonitor::Report(std::ostream &out)
+{
+ if (samples==0)
+ {
+  out << "Soak: no sample was taken.\n";
+  return true;
+ }
+ // The heap may be reused by the resident pages, and the other way round, so only the resident size decides
+ Sint64 growth=Sint64(last_rss)-Sint64(first_rss);
+ bool passed=(growth<=Sint64(limit));
+ out << std::fixed << std::setprecision(1);
+ out << "Soak: " << samples << " samples. High-water marks: resident " << double(high_rss)/MB << " MB, heap in use "
+     << double(high_heap)/MB << " MB, heap kept by malloc " << double(high_arena)/MB << " MB";
+ for (size_t i=0;i<subsystems.size();i++)
+  out << ", " << subsystems[i].name << " " << double(subsystems[i].high)/MB << " MB";
+ out << ".\n";
+ out << "Soak: from the first sample to the last one, the resident size grew " << double(growth)/MB << " MB and the heap in use "
+     << double(Sint64(last_heap)-Sint64(first_heap))/MB << " MB (limit " << double(limit)/MB << " MB): "
+     << ((passed) ? "passed" : "FAILED") << ".\n";
+ out.unsetf(std::ios::floatfield);
+ return passed;
+}
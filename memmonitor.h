@@ -0,0 +1,107 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef MEMMONITOR_H
+#define MEMMONITOR_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <functional>
+#include <SDL/SDL.h>
+
+/*! \brief Class to follow the memory used by the program along a long run
+ *
+ * It is used by the soak mode, which makes the program go again and again through the same work (a recorded trace,
+ * or a synthetic walk through the slides drawing on each one) to see, in minutes, what a lecture of several hours
+ * would do to the memory. Each sample keeps the resident size of the process (read from /proc/self/statm), the
+ * memory given to the program by malloc (as told by mallinfo) and the memory that each subsystem says it holds.
+ *
+ * The first sample is taken when the work has been done once, so that caches are full and buffers allocated.
+ * The run fails if the resident size grows, from that sample to the last one, more than a given limit.
+*/
+class MemoryMonitor
+{
+ public:
+    /**
+     * Code of the SDL_USEREVENT placed after each repetition of a trace, so that the main loop takes a sample
+     */
+    static const int SampleEvent = 2;
+
+    /**
+     * Constructor
+     * \param max_growth Maximum growth of the resident size, in bytes, from the first sample to the last one
+     */
+    MemoryMonitor(Uint64 max_growth);
+
+    /**
+     * Adds a subsystem whose memory is sampled
+     * \param name The name that appears in the report
+     * \param use A function that returns the bytes that the subsystem holds
+     */
+    void AddSubsystem(const std::string &name,std::function<Uint64(void)> use);
+
+    /**
+     * Takes a sample and writes it as a line of the report
+     * \param cycle The number of times the work has been done
+     * \param out The stream for the line
+     */
+    void Sample(int cycle,std::ostream &out);
+
+    /**
+     * Writes the high-water marks and the growth from the first sample to the last one
+     * \param out The stream
+     * \return true if the growth is within the limit, false otherwise
+     */
+    bool Report(std::ostream &out);
+
+    /**
+     * Gets the resident size of the process
+     * \return Bytes, or 0 if it cannot be known
+     */
+    static Uint64 ResidentSize(void);
+
+    /**
+     * Gets the memory allocated with malloc and not yet freed
+     * \return Bytes, or 0 if it cannot be known
+     */
+    static Uint64 HeapInUse(void);
+
+    /**
+     * Gets the memory kept by malloc in its arenas, either in use or free
+     * \return Bytes, or 0 if it cannot be known
+     */
+    static Uint64 HeapSize(void);
+
+ private:
+    struct Subsystem
+    {
+     std::string name;
+     std::function<Uint64(void)> use;
+     Uint64 high;
+    };
+
+    Uint64 limit;
+    std::vector<Subsystem> subsystems;
+    Uint64 start_time;
+    int samples;
+    Uint64 first_rss,last_rss,high_rss;
+    Uint64 first_heap,last_heap,high_heap;
+    Uint64 high_arena;
+};
+
+#endif
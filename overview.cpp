@@ -0,0 +1,428 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "overview.h"
+#include "cachefile.h"
+
+Overview::Overview(Config &cfg,PDFSlides &sld,Scheduler &sc) : slides(sld),scheduler(sc)
+{
+ pages=sld.GetNumPages();
+ pdf_hash=sld.GetFileHash();
+ enabled=(cfg.GetSaveSession() && (pages>0));
+ mapped=nullptr;
+ map_len=0;
+ index=nullptr;
+ mapped_pages=0;
+ changed=false;
+ active=false;
+ canvas=nullptr;
+ view=nullptr;
+ vw=vh=0;
+ cols=rows=1;
+ top_row=0;
+ cell_w=cell_h=margin=0;
+ lock=SDL_CreateMutex();
+ if (lock==nullptr)
+ {
+  std::cerr << "Error creating the synchronization object of the thumbnails. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+
+ if (enabled)
+ {
+  dir=cfg.GetCacheDir();
+  SetFileName();
+  Map();
+ }
+
+ // From the first slide on, as they will be seen
+ for (int i=0;i<pages;i++)
+  if ((index==nullptr) || (index[i].width==0))
+   Submit(i,Scheduler::Thumbnail);
+}
+
+Overview::~Overview()
+{
+ Unmap();
+ if (view!=nullptr)
+  SDL_FreeSurface(view);
+ SDL_DestroyMutex(lock);
+}
+
+void Overview::SetFileName(void)
+{
+ // Thumbnails do not depend on the screen, only on the document and on their size
+ char n[64];
+ snprintf(n,sizeof(n),"%016llx_%dx%d",(unsigned long long)pdf_hash,ThumbWidth,ThumbHeight);
+ fname=dir+std::string(n)+ThumbsExtension;
+}
+
+void Overview::Map(void)
+{
+ if (!CacheFile::Map(fname,sizeof(Header),mapped,map_len))
+  return;
+
+ const Header *h=(const Header *)mapped;
+ bool valid=((h->magic==ThumbsMagic) && (h->version==ThumbsVersion) && (h->pdf_hash==pdf_hash) && (int(h->pages)==pages) &&
+             (int(h->width)==ThumbWidth) && (int(h->height)==ThumbHeight) && (sizeof(Header)+pages*sizeof(IndexEntry)<=map_len));
+ if (valid)
+ {
+  index=(const IndexEntry *)(mapped+sizeof(Header));
+  mapped_pages=pages;
+  outdated.assign(pages,false);
+  for (int i=0;i<pages && valid;i++)
+   valid=((int(index[i].width)<=ThumbWidth) && (int(index[i].height)<=ThumbHeight) && (index[i].offset<=map_len) &&
+          (Uint64(index[i].width)*index[i].height*3<=map_len-index[i].offset));
+ }
+ if (!valid)
+ {
+  std::cerr << "Warning: thumbnail file " << fname << " is not valid for this document. It will be ignored and overwritten.\n";
+  Unmap();
+ }
+}
+
+void Overview::Unmap(void)
+{
+ CacheFile::Unmap(mapped,map_len);
+ mapped=nullptr;
+ map_len=0;
+ index=nullptr;
+ mapped_pages=0;
+ outdated.clear();
+}
+
+void Overview::Submit(int page,Scheduler::Priority p)
+{
+ scheduler.Submit(p,token,[this,page](const CancelToken &t)
+ {
+  if (t.Cancelled())
+   return;
+  Render(page,t);
+  scheduler.PostToMain([this,page]() { Arrived(page); });
+ });
+}
+
+void Overview::Render(int page,const CancelToken &tk)
+{
+ SDL_LockMutex(lock);
+ bool done=((thumbs.find(page)!=thumbs.end()) || (rendering.find(page)!=rendering.end()));
+ if (!done)
+  rendering.insert(page);
+ SDL_UnlockMutex(lock);
+ if (done)
+  return;
+
+ Thumb t;
+ t.w=t.h=0;
+ SDL_Surface *s=slides.RenderThumbnail(page,ThumbWidth,ThumbHeight);
+ if (s!=nullptr)
+ {
+  t.w=std::min(s->w,ThumbWidth);
+  t.h=std::min(s->h,ThumbHeight);
+  t.rgb.resize(size_t(t.w)*size_t(t.h)*3);
+  SDL_LockSurface(s);
+  Uint8 *q=t.rgb.data();
+  for (int y=0;y<t.h;y++)
+  {
+   const Uint8 *p=(const Uint8 *)s->pixels+y*s->pitch;
+   for (int x=0;x<t.w;x++,p+=s->format->BytesPerPixel,q+=3)
+   {
+    Uint32 v=0;
+    memcpy(&v,p,s->format->BytesPerPixel);
+    SDL_GetRGB(v,s->format,q,q+1,q+2);
+   }
+  }
+  SDL_UnlockSurface(s);
+  SDL_FreeSurface(s);
+ }
+
+ SDL_LockMutex(lock);
+ // If the document has been reloaded meanwhile, the thumbnail may be of the former one (and rendering has been emptied)
+ if (!tk.Cancelled())
+ {
+  thumbs[page]=t;
+  rendering.erase(page);
+  changed=true;
+ }
+ SDL_UnlockMutex(lock);
+}
+
+bool Overview::GetThumb(int page,int &w,int &h,const Uint8 *&rgb)
+{
+ if ((index!=nullptr) && (page<mapped_pages) && !outdated[page] && (index[page].width>0))
+ {
+  w=int(index[page].width);
+  h=int(index[page].height);
+  rgb=mapped+index[page].offset;
+  return true;
+ }
+ // Thumbnails are never changed once they are in the map, so their pixels can be used without the lock
+ SDL_LockMutex(lock);
+ std::map<int,Thumb>::const_iterator it=thumbs.find(page);
+ bool found=((it!=thumbs.end()) && (it->second.w>0));
+ if (found)
+ {
+  w=it->second.w;
+  h=it->second.h;
+  rgb=it->second.rgb.data();
+ }
+ SDL_UnlockMutex(lock);
+ return found;
+}
+
+void Overview::Open(Canvas &cnv)
+{
+ if (pages==0)
+  return;
+ canvas=&cnv;
+ SDL_Rect a=cnv.GetDrawingArea();
+ vw=a.w;
+ vh=a.h;
+ int tw,th;
+ cnv.TextSize("0",tw,th);
+ cell_w=ThumbWidth+Gap;
+ cell_h=ThumbHeight+Gap+th;
+ cols=std::max(vw/cell_w,1);
+ rows=std::max(vh/cell_h,1);
+ margin=std::max((vw-cols*cell_w)/2,0);
+ top_row=slides.GetCurrentPage()/cols-rows/2;
+ active=true;
+ Scroll(0,cnv);
+
+ // The thumbnails that are seen, and still missing, go before the others
+ for (int i=top_row*cols;(i<(top_row+rows)*cols) && (i<pages);i++)
+ {
+  int w,h;
+  const Uint8 *rgb;
+  if (!GetThumb(i,w,h,rgb))
+   Submit(i,Scheduler::Prefetch);
+ }
+}
+
+void Overview::Scroll(int r,Canvas &cnv)
+{
+ if (!active)
+  return;
+ int last=std::max((pages+cols-1)/cols-rows,0);
+ top_row=std::min(std::max(top_row+r,0),last);
+ Draw(cnv);
+}
+
+SDL_Rect Overview::Cell(int page)
+{
+ SDL_Rect r;
+ r.x=Sint16(margin+(page%cols)*cell_w);
+ r.y=Sint16((page/cols-top_row)*cell_h);
+ r.w=Uint16(cell_w);
+ r.h=Uint16(cell_h);
+ return r;
+}
+
+int Overview::PageAt(int x,int y)
+{
+ if (!active || (canvas==nullptr))
+  return -1;
+ y-=canvas->GetDrawingArea().y;
+ if ((x<margin) || (x>=margin+cols*cell_w) || (y<0) || (y>=rows*cell_h))
+  return -1;
+ int page=(top_row+y/cell_h)*cols+(x-margin)/cell_w;
+ return (page<pages) ? page : -1;
+}
+
+void Overview::Draw(Canvas &cnv)
+{
+ SDL_PixelFormat *fmt=cnv.GetInk()->format;
+ if (view==nullptr)
+ {
+  view=SDL_CreateRGBSurface(SDL_SWSURFACE,vw,vh,fmt->BitsPerPixel,fmt->Rmask,fmt->Gmask,fmt->Bmask,fmt->Amask);
+  if (view==nullptr)
+  {
+   std::cerr << "Error creating the SDL surface of the overview. Exiting.\n";
+   SDL_Quit();
+   exit(1);
+  }
+  if (fmt->palette!=nullptr)
+   SDL_SetPalette(view,SDL_LOGPAL,fmt->palette->colors,0,fmt->palette->ncolors);
+ }
+ SDL_FillRect(view,nullptr,SDL_MapRGB(fmt,0xE0,0xE0,0xE0));
+ for (int i=top_row*cols;(i<(top_row+rows)*cols) && (i<pages);i++)
+  DrawCell(i,cnv);
+ cnv.ShowView(view);
+}
+
+void Overview::DrawCell(int page,Canvas &cnv)
+{
+ SDL_PixelFormat *fmt=view->format;
+ SDL_Rect c=Cell(page);
+ SDL_Rect b=c;
+ SDL_FillRect(view,&b,SDL_MapRGB(fmt,0xE0,0xE0,0xE0));
+
+ // The box of the thumbnail, framed in red for the current slide
+ SDL_Rect box;
+ box.x=Sint16(c.x+Gap/2);
+ box.y=Sint16(c.y+Gap/2);
+ box.w=ThumbWidth;
+ box.h=ThumbHeight;
+ if (page==slides.GetCurrentPage())
+ {
+  SDL_Rect f;
+  f.x=Sint16(box.x-3);
+  f.y=Sint16(box.y-3);
+  f.w=Uint16(box.w+6);
+  f.h=Uint16(box.h+6);
+  SDL_FillRect(view,&f,SDL_MapRGB(fmt,0xFF,0x00,0x00));
+ }
+ int w,h;
+ const Uint8 *rgb;
+ if (GetThumb(page,w,h,rgb))
+ {
+  SDL_Rect f=box;
+  SDL_FillRect(view,&f,SDL_MapRGB(fmt,0xE0,0xE0,0xE0));
+  Uint32 rmask,gmask,bmask;
+ #if SDL_BYTEORDER == SDL_BIG_ENDIAN
+  rmask=0xff0000;
+  gmask=0x00ff00;
+  bmask=0x0000ff;
+ #else
+  rmask=0x0000ff;
+  gmask=0x00ff00;
+  bmask=0xff0000;
+ #endif
+  // The pixels are only read by the blit
+  SDL_Surface *t=SDL_CreateRGBSurfaceFrom(const_cast<Uint8 *>(rgb),w,h,24,w*3,rmask,gmask,bmask,0);
+  if (t!=nullptr)
+  {
+   SDL_Rect d;
+   d.x=Sint16(box.x+(ThumbWidth-w)/2);
+   d.y=Sint16(box.y+(ThumbHeight-h)/2);
+   SDL_BlitSurface(t,nullptr,view,&d);
+   SDL_FreeSurface(t);
+  }
+ }
+ else
+ {
+  // Not rendered yet
+  SDL_Rect f=box;
+  SDL_FillRect(view,&f,SDL_MapRGB(fmt,0xB0,0xB0,0xB0));
+ }
+
+ char n[16];
+ snprintf(n,sizeof(n),"%d",page+1);
+ int tw,th;
+ cnv.TextSize(n,tw,th);
+ cnv.DrawText(view,n,c.x+(cell_w-tw)/2,box.y+ThumbHeight+Gap/4);
+}
+
+void Overview::Arrived(int page)
+{
+ if (!active || (canvas==nullptr) || (page>=pages) || (page<top_row*cols) || (page>=(top_row+rows)*cols) || canvas->OverlayActive())
+  return;
+ DrawCell(page,*canvas);
+ canvas->ShowView(view,Cell(page));
+}
+
+void Overview::Reload(const std::vector<bool> &changed_pages)
+{
+ SDL_LockMutex(lock);
+ // The thumbnails being rendered may be of the former document, so they are thrown away when they end
+ token.Cancel();
+ token=CancelToken();
+ rendering.clear();
+ pages=int(changed_pages.size());
+ std::map<int,Thumb>::iterator it=thumbs.begin();
+ while (it!=thumbs.end())
+ {
+  if ((it->first>=pages) || changed_pages[it->first])
+   thumbs.erase(it++);
+  else
+   ++it;
+ }
+ for (int i=0;(i<mapped_pages) && (i<pages);i++)
+  if (changed_pages[i])
+   outdated[i]=true;
+ // The thumbnails that are still valid go to the file of the new content
+ pdf_hash=slides.GetFileHash();
+ if (enabled)
+  SetFileName();
+ changed=true;
+ SDL_UnlockMutex(lock);
+
+ for (int i=0;i<pages;i++)
+ {
+  int w,h;
+  const Uint8 *rgb;
+  if (!GetThumb(i,w,h,rgb))
+   Submit(i,Scheduler::Thumbnail);
+ }
+ if (active && (canvas!=nullptr))
+  Scroll(0,*canvas);
+}
+
+void Overview::Save(void)
+{
+ if (!enabled || !changed)
+  return;
+
+ std::vector<IndexEntry> idx(pages);
+ Uint64 offset=sizeof(Header)+pages*sizeof(IndexEntry);
+ for (int i=0;i<pages;i++)
+ {
+  int w=0,h=0;
+  const Uint8 *rgb;
+  if (!GetThumb(i,w,h,rgb))
+   w=h=0;
+  idx[i].offset=offset;
+  idx[i].width=Uint32(w);
+  idx[i].height=Uint32(h);
+  offset+=Uint64(w)*Uint64(h)*3;
+ }
+
+ Header h;
+ h.magic=ThumbsMagic;
+ h.version=ThumbsVersion;
+ h.pdf_hash=pdf_hash;
+ h.pages=pages;
+ h.width=ThumbWidth;
+ h.height=ThumbHeight;
+ h.reserved=0;
+
+ bool ok=CacheFile::Write(dir,fname,"thumbnail file","Thumbnails",[&](std::ofstream &f)
+ {
+  f.write(reinterpret_cast<const char *>(&h),sizeof(Header));
+  f.write(reinterpret_cast<const char *>(&idx[0]),pages*sizeof(IndexEntry));
+  for (int i=0;i<pages;i++)
+  {
+   int w,hh;
+   const Uint8 *rgb;
+   if (GetThumb(i,w,hh,rgb))
+    f.write(reinterpret_cast<const char *>(rgb),std::streamsize(w)*hh*3);
+  }
+ });
+ if (ok)
+  changed=false;
+}
+
+Uint64 Overview::MemoryUse(void)
+{
+ Uint64 m=(view!=nullptr) ? Uint64(view->pitch)*Uint64(view->h) : 0;
+ SDL_LockMutex(lock);
+ for (std::map<int,Thumb>::const_iterator it=thumbs.begin();it!=thumbs.end();++it)
+  m+=it->second.rgb.capacity();
+ SDL_UnlockMutex(lock);
+ return m;
+}
@@ -0,0 +1,198 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef OVERVIEW_H
+#define OVERVIEW_H
+
+#include "canvas.h"
+#include "pdfslides.h"
+
+/*! \brief Class to show a grid with small images (thumbnails) of all the slides, to go to one of them with a click
+ *
+ * Thumbnails are rendered by the workers of the scheduler, with the lowest priority but that of the exports, from the start
+ * of the program, so that opening the overview is immediate even for long documents. Those that have not arrived yet are
+ * shown as gray boxes, and drawn as soon as they arrive. When the overview is opened, those that it shows are asked for
+ * first.
+ *
+ * If sessions are kept, the thumbnails are stored in a file beside the session file, whose name is built from the hash of
+ * the content of the PDF file, and they are not rendered again in later executions. The file is memory-mapped, and each
+ * thumbnail is used from the mapping, as it is stored (24-bit RGB).
+*/
+class Overview
+{
+ public:
+    /**
+     * Width of the box where each thumbnail fits
+     */
+    static const int ThumbWidth = 160;
+
+    /**
+     * Height of the box where each thumbnail fits
+     */
+    static const int ThumbHeight = 120;
+
+    /**
+     * Space around each thumbnail, in pixels
+     */
+    static const int Gap = 16;
+
+    /**
+     * Extension of the thumbnail files
+     */
+    static constexpr const char* ThumbsExtension = ".thumbs";
+
+    /**
+     * Constructor. It maps the thumbnail file of the document, if sessions are kept and it exists, and submits the rendering of the thumbnails that are not in it.
+     * \param cfg The configuration object (to know if sessions are used and where they are stored)
+     * \param sld The slides object, which renders the thumbnails
+     * \param sc The scheduler to which rendering is submitted
+     */
+    Overview(Config &cfg,PDFSlides &sld,Scheduler &sc);
+
+    /**
+     * Destructor. It unmaps the thumbnail file. The scheduler must have been stopped before, since its jobs use this object.
+     */
+    ~Overview();
+
+    /**
+     * Tells if the overview is shown
+     * \return true if it is
+     */
+    bool Active(void) { return active; };
+
+    /**
+     * Shows the overview, with the row of the current slide in the middle of the screen
+     * \param cnv The canvas
+     */
+    void Open(Canvas &cnv);
+
+    /**
+     * Stops showing the overview (the slide must be shown again)
+     */
+    void Close(void) { active=false; };
+
+    /**
+     * Moves the grid up or down
+     * \param rows Number of rows (positive to see those below)
+     * \param cnv The canvas
+     */
+    void Scroll(int rows,Canvas &cnv);
+
+    /**
+     * Gets the slide whose thumbnail is at a point of the screen
+     * \param x Value of coordinate x
+     * \param y Value of coordinate y
+     * \return The number of the slide, from 0, or -1 if there is none there
+     */
+    int PageAt(int x,int y);
+
+    /**
+     * Cancels the rendering that has not started yet. To be called before stopping the scheduler at the end of the program.
+     */
+    void CancelJobs(void) { token.Cancel(); };
+
+    /**
+     * Writes the thumbnail file, if sessions are kept and new thumbnails have been rendered. To be called once the scheduler is stopped.
+     */
+    void Save(void);
+
+    /**
+     * Follows the document once it has been reloaded: the thumbnails of the slides that have changed are rendered again, and the others are kept.
+     * If the overview is shown, it is drawn again.
+     * \param changed_pages For each slide of the new document, true if it has changed
+     */
+    void Reload(const std::vector<bool> &changed_pages);
+
+    /**
+     * Gets the memory used by the thumbnails rendered during this execution and by the view
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void);
+
+ private:
+    static const Uint32 ThumbsMagic = 0x54424256;   // "VBBT" read as little-endian
+    static const Uint32 ThumbsVersion = 1;
+
+    struct Header
+    {
+     Uint32 magic;
+     Uint32 version;
+     Uint64 pdf_hash;
+     Uint32 pages;
+     Uint32 width;
+     Uint32 height;
+     Uint32 reserved;
+    };
+
+    struct IndexEntry
+    {
+     Uint64 offset;
+     Uint32 width;         // 0 if the page has no thumbnail
+     Uint32 height;
+    };
+
+    struct Thumb
+    {
+     int w,h;
+     std::vector<Uint8> rgb;
+    };
+
+    void SetFileName(void);
+    void Map(void);
+    void Unmap(void);
+    // Renders the thumbnail of a page, unless it is already there, and keeps it unless tk has been cancelled meanwhile. Run by the workers.
+    void Render(int page,const CancelToken &tk);
+    void Submit(int page,Scheduler::Priority p);
+    // Called in the main thread when the thumbnail of a page arrives
+    void Arrived(int page);
+    bool GetThumb(int page,int &w,int &h,const Uint8 *&rgb);
+    SDL_Rect Cell(int page);
+    void Draw(Canvas &cnv);
+    void DrawCell(int page,Canvas &cnv);
+
+    PDFSlides &slides;
+    Scheduler &scheduler;
+    CancelToken token;
+    int pages;
+    Uint64 pdf_hash;
+
+    // Thumbnail file
+    bool enabled;
+    std::string dir,fname;
+    unsigned char *mapped;
+    size_t map_len;
+    const IndexEntry *index;
+    // After a reload, the thumbnails of the file that are no longer valid
+    int mapped_pages;
+    std::vector<bool> outdated;
+
+    // Thumbnails rendered during this execution, and those being rendered, protected by lock
+    SDL_mutex *lock;
+    std::map<int,Thumb> thumbs;
+    std::set<int> rendering;
+    bool changed;
+
+    // The grid, only used by the main thread. The canvas is kept while the overview is shown, for the thumbnails that arrive.
+    bool active;
+    Canvas *canvas;
+    SDL_Surface *view;
+    int vw,vh;
+    int cols,rows,top_row;
+    int cell_w,cell_h,margin;
+};
+
+#endif
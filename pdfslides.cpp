@@ -18,50 +18,101 @@
 
 #include "pdfslides.h"
 
+#include <fstream>
+#include <algorithm>
+
 //using namespace std;
 
-PDFSlides::PDFSlides(Config &cfg,std::string fn)
+PDFSlides::PDFSlides(Config &cfg,std::string fn,Scheduler &sc) : scheduler(sc)
 {
+ reload_lock=SDL_CreateMutex();
+ cache_lock=SDL_CreateMutex();
+ cache_cond=SDL_CreateCond();
+ if ((reload_lock==nullptr) || (cache_lock==nullptr) || (cache_cond==nullptr))
+ {
+  std::cerr << "Error creating the synchronization objects of the page cache. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+ delivered=arrived=false;
+ zoom_clock=0;
+ zoom_arrived=false;
+ new_hash=0;
+ fingerprints_left=0;
+ generation=0;
+ reload_ready=false;
+ prof=nullptr;
+ last_render=0;
+ cache_hits=cache_misses=0;
+
  scw=cfg.GetXres();
  sch=cfg.GetYres()-cfg.GetMenuHeight();
  
  if (cfg.GetShowSplash())
  {
-  splashdoc=InitDoc(cfg.GetSplashFile(),false);
-  splash_surface=GetPageSurface(splashdoc,0,false);
+  splash=InitDoc(cfg.GetSplashFile(),false);
+  splash_surface=GetSplashSurface();
  }
  else
- {
-  splashdoc=nullptr;
   splash_surface=nullptr;
- }
  
  filename=fn;
  if (filename=="")
  {
   pdfloaded=false;
-  slidesdoc=nullptr;
+  num_pages=0;
+  file_hash=0;
  }
  else
  {
   pdfloaded=true;
-  slidesdoc=InitDoc(filename,false);
+  source=InitDoc(filename,false,&file_hash);
+  num_pages=source->pages;
  }
 
  current_page=0;
  default_rot=false;
+ costs=new RenderCosts(cfg,file_hash,GetNumPages(),scw,sch);
+
+ // The first page (and its neighbours) start to be rendered now, while the rest of the program is initialized.
+ Schedule();
 }
 
 PDFSlides::~PDFSlides()
 {
- if (splashdoc!=nullptr)
-  delete splashdoc;
- if (slidesdoc!=nullptr)
-  delete slidesdoc;
+ nav_token.Cancel();
+ reload_token.Cancel();
+ for (std::map<int,SDL_Surface *>::iterator it=cache.begin();it!=cache.end();++it)
+  SDL_FreeSurface(it->second);
+ for (std::map<ZoomKey,ZoomTile>::iterator it=zoom_tiles.begin();it!=zoom_tiles.end();++it)
+  SDL_FreeSurface(it->second.s);
+ delete costs;
+ SDL_DestroyCond(cache_cond);
+ SDL_DestroyMutex(cache_lock);
+ SDL_DestroyMutex(reload_lock);
  // splash_surface will be freed by SDL_Quit
 }
 
-poppler::document *PDFSlides::InitDoc(std::string fn,bool rot)
+PDFSlides::Source::Source()
+{
+ pages=0;
+ lock=SDL_CreateMutex();
+ if (lock==nullptr)
+ {
+  std::cerr << "Error creating the synchronization object of a PDF document. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+}
+
+PDFSlides::Source::~Source()
+{
+ for (size_t i=0;i<idle.size();i++)
+  delete idle[i];
+ SDL_DestroyMutex(lock);
+}
+
+PDFSlides::SourcePtr PDFSlides::InitDoc(std::string fn,bool rot,Uint64 *hash)
 {
  if (!poppler::page_renderer::can_render())
  {
@@ -69,31 +120,162 @@ poppler::document *PDFSlides::InitDoc(std::string fn,bool rot)
   exit(1);
  }
  
- poppler::document *doc=poppler::document::load_from_file(fn,"","");
- if (doc==nullptr)
+ Uint64 h;
+ std::string err;
+ SourcePtr src=LoadSource(fn,h,err);
+ if (src==nullptr)
  {
-  std::cerr << "Error from PDFdoc constructor: loading error. Cannot open file " << fn << std::endl;
+  std::cerr << "Error from PDFdoc constructor: " << err << std::endl;
   exit(1);
  }
- if (doc->is_locked())
+ if (hash!=nullptr)
+  *hash=h;
+ default_rot=rot;
+ 
+ return src;
+}
+
+PDFSlides::SourcePtr PDFSlides::LoadSource(const std::string &fn,Uint64 &hash,std::string &err)
+{
+ SourcePtr src=std::make_shared<Source>();
+ std::ifstream f(fn.c_str(),std::ios::binary | std::ios::ate);
+ if (f.is_open())
  {
-  std::cerr << "Error from PDFdoc constructor: encrypted document";
-  exit(1);
+  std::streamoff len=f.tellg();
+  if (len>0)
+  {
+   src->data.resize(size_t(len));
+   f.seekg(0);
+   if (!f.read(&src->data[0],len))
+    src->data.clear();
+  }
  }
+ if (src->data.empty())
+ {
+  err="loading error. Cannot open file "+fn;
+  return nullptr;
+ }
+ hash=HashData((const unsigned char *)&src->data[0],src->data.size());
 
+ // The documents read the bytes of the source, which are kept while any of them exists
+ poppler::document *doc=poppler::document::load_from_raw_data(&src->data[0],int(src->data.size()));
+ if (doc==nullptr)
+ {
+  err="loading error. Cannot open file "+fn;
+  return nullptr;
+ }
+ if (doc->is_locked())
+ {
+  err="encrypted document";
+  delete doc;
+  return nullptr;
+ }
  if (doc->pages()<1)
  {
-  std::cerr << "Error from PDFdoc constructor: the PDF document has no pages.\n";
+  err="the PDF document has no pages.";
+  delete doc;
+  return nullptr;
+ }
+ src->pages=doc->pages();
+ src->idle.push_back(doc);
+ return src;
+}
+
+poppler::document *PDFSlides::Borrow(const SourcePtr &src)
+{
+ poppler::document *doc=nullptr;
+ SDL_LockMutex(src->lock);
+ if (!src->idle.empty())
+ {
+  doc=src->idle.back();
+  src->idle.pop_back();
+ }
+ SDL_UnlockMutex(src->lock);
+ if (doc!=nullptr)
+  return doc;
+ // The same bytes have already been opened once, so this can only fail if memory is exhausted
+ doc=poppler::document::load_from_raw_data(&src->data[0],int(src->data.size()));
+ if (doc==nullptr)
+ {
+  std::cerr << "Error opening again a PDF document already loaded. Exiting.\n";
+  SDL_Quit();
   exit(1);
  }
- default_rot=rot;
- 
  return doc;
 }
 
+void PDFSlides::GiveBack(const SourcePtr &src,poppler::document *doc)
+{
+ SDL_LockMutex(src->lock);
+ src->idle.push_back(doc);
+ SDL_UnlockMutex(src->lock);
+}
+
+PDFSlides::SourcePtr PDFSlides::CurrentSource(Uint32 *gen)
+{
+ SDL_LockMutex(cache_lock);
+ SourcePtr src=source;
+ if (gen!=nullptr)
+  *gen=generation;
+ SDL_UnlockMutex(cache_lock);
+ return src;
+}
+
+Uint64 PDFSlides::HashData(const unsigned char *p,size_t len,Uint64 h)
+{
+ // The hash is done on 64-bit words instead of bytes. It is not the canonical FNV-1a, but it is eight times faster
+ // and we only need it to be stable and to change whenever the data change.
+ size_t nw=len/sizeof(Uint64);
+ for (size_t i=0;i<nw;i++)
+ {
+  Uint64 w;
+  memcpy(&w,p+i*sizeof(Uint64),sizeof(Uint64));
+  h^=w;
+  h*=FNVPrime;
+ }
+ for (size_t i=nw*sizeof(Uint64);i<len;i++)
+ {
+  h^=Uint64(p[i]);
+  h*=FNVPrime;
+ }
+ h^=Uint64(len);
+ h*=FNVPrime;
+ return h;
+}
+
+Uint64 PDFSlides::TextHash(poppler::document *doc,int pagenum)
+{
+ poppler::page *p=doc->create_page(pagenum);
+ if (p==nullptr)
+  return 1;
+ poppler::byte_array t=p->text().to_utf8();
+ poppler::rectf r=p->page_rect(poppler::media_box);
+ delete p;
+
+ Uint64 h=HashData((const unsigned char *)t.data(),t.size());
+ double size[2]={r.width(),r.height()};
+ h=HashData((const unsigned char *)size,sizeof(size),h);
+ return (h!=0) ? h : 1;
+}
+
+Uint64 PDFSlides::PixelHash(poppler::document *doc,int pagenum)
+{
+ Uint64 h=FNVOffset;
+ SDL_Surface *s=GetThumbnailSurface(doc,pagenum,default_rot,FingerprintWidth,FingerprintHeight);
+ if (s!=nullptr)
+ {
+  SDL_LockSurface(s);
+  for (int y=0;y<s->h;y++)
+   h=HashData((const unsigned char *)s->pixels+y*s->pitch,size_t(s->w)*s->format->BytesPerPixel,h);
+  SDL_UnlockSurface(s);
+  SDL_FreeSurface(s);
+ }
+ return (h!=0) ? h : 1;
+}
+
 bool PDFSlides::GoNext()
 {
- if (current_page+1<slidesdoc->pages())
+ if (current_page+1<num_pages)
  {
   current_page++;
   return true;
@@ -113,11 +295,11 @@ bool PDFSlides::GoPrev()
 
 bool PDFSlides::GoFF()
 { 
- if (current_page+1 < slidesdoc->pages()) 
+ if (current_page+1 < num_pages) 
  { 
   current_page+=NumSlidesJump;
-  if (current_page > slidesdoc->pages()-1)
-   current_page=slidesdoc->pages()-1;
+  if (current_page > num_pages-1)
+   current_page=num_pages-1;
   return true;
  }
  return false;
@@ -148,9 +330,9 @@ bool PDFSlides::GoFirst()
 
 bool PDFSlides::GoLast()
 { 
- if (current_page!=slidesdoc->pages()-1)
+ if (current_page!=num_pages-1)
  {
-  current_page=slidesdoc->pages()-1;
+  current_page=num_pages-1;
   return true;
  }
  return false;
@@ -174,7 +356,7 @@ SDL_Surface *PDFSlides::GetPageSurface(poppler::document *doc,int pagenum,bool r
   poppler::image img = pr.render_page(p);
   if (!img.is_valid())
   {
-   std::cerr << "Error from get_currentpage_surface: rendering of page " << current_page << " failed.\n";
+   std::cerr << "Error from get_currentpage_surface: rendering of page " << pagenum << " failed.\n";
    exit(1);
   }
   iw=img.width();
@@ -226,12 +408,58 @@ SDL_Surface *PDFSlides::GetPageSurface(poppler::document *doc,int pagenum,bool r
 
  if (!img.is_valid())
  {
-  std::cerr << "Error from get_currentpage_surface: rendering of page " << current_page << " failed.\n";
+  std::cerr << "Error from get_currentpage_surface: rendering of page " << pagenum << " failed.\n";
   exit(1);
  }
- iw=img.width();
- ih=img.height();
- //cerr << "New rendering is (" << iw << "," << ih << ")\n";
+ delete p;
+ return(ImageToSurface(img));
+}
+
+SDL_Surface *PDFSlides::GetThumbnailSurface(poppler::document *doc,int pagenum,bool rot,int w,int h)
+{
+ poppler::page_renderer pr;
+ pr.set_render_hint(poppler::page_renderer::antialiasing, true);
+ pr.set_render_hint(poppler::page_renderer::text_antialiasing, true);
+
+ poppler::page *p=doc->create_page(pagenum);
+ poppler::rectf inchsize=p->page_rect(poppler::media_box);
+ float pw=(rot) ? float(inchsize.height()) : float(inchsize.width());
+ float ph=(rot) ? float(inchsize.width()) : float(inchsize.height());
+ float dpi=DefaultDPI*std::min(float(w)/pw,float(h)/ph);
+ poppler::image img = pr.render_page(p,dpi,dpi,-1,-1,-1,-1,(rot) ? poppler::rotate_90 : poppler::rotate_0);
+ delete p;
+ if (!img.is_valid())
+ {
+  std::cerr << "Error from get_thumbnail_surface: rendering of page " << pagenum << " failed.\n";
+  return nullptr;
+ }
+ return(ImageToSurface(img));
+}
+
+SDL_Surface *PDFSlides::GetRegionSurface(poppler::document *doc,int pagenum,bool rot,int fw,int fh,float scale,int x,int y,int w,int h)
+{
+ poppler::page_renderer pr;
+ pr.set_render_hint(poppler::page_renderer::antialiasing, true);
+ pr.set_render_hint(poppler::page_renderer::text_antialiasing, true);
+
+ poppler::page *p=doc->create_page(pagenum);
+ // The same resolution of GetPageSurface, multiplied by the scale
+ poppler::rectf inchsize=p->page_rect(poppler::media_box);
+ float dpi=scale*DefaultDPI*( rot ? float(fh)/float(inchsize.height()) : float(fw)/float(inchsize.width()) );
+ poppler::image img = pr.render_page(p,dpi,dpi,x,y,w,h,(rot) ? poppler::rotate_90 : poppler::rotate_0);
+ delete p;
+ if (!img.is_valid())
+ {
+  std::cerr << "Error from get_region_surface: rendering of an area of page " << pagenum << " failed.\n";
+  return nullptr;
+ }
+ return(ImageToSurface(img));
+}
+
+SDL_Surface *PDFSlides::ImageToSurface(const poppler::image &img)
+{
+ int iw=img.width();
+ int ih=img.height();
  int id=3;
  
  switch (img.format())
@@ -266,10 +494,10 @@ SDL_Surface *PDFSlides::GetPageSurface(poppler::document *doc,int pagenum,bool r
  //cout << "Surface created with pointer " << s << endl;
  SDL_PixelFormat *fmt=s->format;
 
- Uint32 *poi=(Uint32 *)img.data();
+ const Uint32 *poi=(const Uint32 *)img.const_data();
  Uint8 *sb=(Uint8 *)s->pixels;
  Uint32 *sb2;
- Uint32 *poi2;
+ const Uint32 *poi2;
  Uint8 r,g,b,a;
  
  SDL_LockSurface(s);
@@ -293,27 +521,522 @@ SDL_Surface *PDFSlides::GetPageSurface(poppler::document *doc,int pagenum,bool r
  }
   
  SDL_UnlockSurface(s);
- delete p;
- return(s);   
+ return(s);
+}
+
+SDL_Surface *PDFSlides::RenderToCache(int pagenum,bool wait)
+{
+ // Only the pages that are waited for count as hits (they were already there) or misses (they had to be rendered)
+ bool hit=true;
+ SDL_LockMutex(cache_lock);
+ while (rendering.find(pagenum)!=rendering.end())
+ {
+  if (!wait)
+  {
+   SDL_UnlockMutex(cache_lock);
+   return nullptr;
+  }
+  hit=false;
+  SDL_CondWait(cache_cond,cache_lock);
+ }
+ std::map<int,SDL_Surface *>::iterator it=cache.find(pagenum);
+ if (it!=cache.end())
+ {
+  SDL_Surface *s=it->second;
+  SDL_UnlockMutex(cache_lock);
+  if (wait)
+  {
+   if (hit)
+    cache_hits++;
+   else
+    cache_misses++;
+  }
+  return s;
+ }
+ rendering.insert(pagenum);
+ SDL_UnlockMutex(cache_lock);
+ if (wait)
+  cache_misses++;
+
+ SDL_Surface *s;
+ Uint64 took;
+ Uint32 gen;
+ SourcePtr src=CurrentSource(&gen);
+ poppler::document *doc=Borrow(src);
+ {
+  ScopedTimer t(prof,Profiler::PageRender);
+  Uint64 start=InputQueue::Now();
+  s=GetPageSurface(doc,pagenum,default_rot);
+  took=InputQueue::Now()-start;
+  last_render=took;
+ }
+ GiveBack(src,doc);
+ costs->Record(pagenum,took);
+
+ SDL_LockMutex(cache_lock);
+ // If the document has been reloaded meanwhile, the page may not be the same. Only workers can find this, since the main thread reloads.
+ if ((gen!=generation) || (s==nullptr))
+ {
+  if (s!=nullptr)
+   SDL_FreeSurface(s);
+  s=nullptr;
+ }
+ else
+  cache[pagenum]=s;
+ rendering.erase(pagenum);
+ SDL_CondBroadcast(cache_cond);
+ SDL_UnlockMutex(cache_lock);
+ return s;
+}
+
+void PDFSlides::Schedule(void)
+{
+ if (!pdfloaded)
+  return;
+
+ // Whatever was waiting for the former page is of no use now
+ nav_token.Cancel();
+ nav_token=CancelToken();
+ delivered=arrived=false;
+ // The tiles being rendered for the former page are cancelled with its jobs, or left out when they arrive
+ zoom_pending.clear();
+
+ SDL_LockMutex(cache_lock);
+ // Pages far from the current one are released, but the most expensive ones. Those being rendered will be inserted later, and released by a later call.
+ std::vector< std::pair<Uint32,int> > far;
+ for (std::map<int,SDL_Surface *>::iterator it=cache.begin();it!=cache.end();++it)
+  if (abs(it->first-current_page)>CacheWindow)
+   far.push_back(std::make_pair(costs->Get(it->first),it->first));
+ std::sort(far.begin(),far.end(),std::greater< std::pair<Uint32,int> >());
+ for (int i=0;i<int(far.size());i++)
+  if ((i>=MaxExpensiveKept) || (far[i].first<RenderCosts::ExpensiveRender))
+  {
+   SDL_FreeSurface(cache[far[i].second]);
+   cache.erase(far[i].second);
+  }
+ bool cached=(cache.find(current_page)!=cache.end());
+ SDL_UnlockMutex(cache_lock);
+ std::map<ZoomKey,ZoomTile>::iterator zt=zoom_tiles.begin();
+ while (zt!=zoom_tiles.end())
+ {
+  if (abs(zt->first.page-current_page)>CacheWindow)
+  {
+   SDL_FreeSurface(zt->second.s);
+   zoom_tiles.erase(zt++);
+  }
+  else
+   ++zt;
+ }
+
+ int page=current_page;
+ if (!cached)
+  scheduler.Submit(Scheduler::VisibleSlide,nav_token,[this,page](const CancelToken &)
+  {
+   RenderToCache(page,false);
+   // It is the main thread who checks if the page is still the current one and has not been shown yet
+   scheduler.PostToMain([this,page]()
+   {
+    if ((page==current_page) && !delivered)
+     arrived=true;
+   });
+  });
+
+ // Forward first, since it is the usual direction. Expensive pages are rendered up to the end of the cache window, and the time
+ // of each page divided by its distance goes first, since a page that takes longer to render must start earlier.
+ std::vector< std::pair<Uint64,int> > ahead;
+ for (int d=1;d<=CacheWindow;d++)
+  for (int sign=1;sign>=-1;sign-=2)
+  {
+   int p=current_page+sign*d;
+   if ((p<0) || (p>=num_pages) || ((d>PrefetchWindow) && !costs->Expensive(p)))
+    continue;
+   ahead.push_back(std::make_pair(Uint64(costs->Get(p))/Uint64(d),p));
+  }
+ std::stable_sort(ahead.begin(),ahead.end(),[](const std::pair<Uint64,int> &a,const std::pair<Uint64,int> &b) { return a.first>b.first; });
+ for (size_t i=0;i<ahead.size();i++)
+ {
+  int p=ahead[i].second;
+  scheduler.Submit(Scheduler::Prefetch,nav_token,[this,p](const CancelToken &t)
+  {
+   if (!t.Cancelled())
+    RenderToCache(p,false);
+  });
+ }
 }
 
 SDL_Surface *PDFSlides::GetCurrentPageSurface()
 { 
  if (pdfloaded)
-     return(GetPageSurface(slidesdoc,current_page,default_rot));
+ {
+  delivered=true;
+  arrived=false;
+  return(RenderToCache(current_page,true));
+ }
  else
      return(nullptr);
 }
+
+bool PDFSlides::WaitCurrentPage(Uint32 ms)
+{
+ if (!pdfloaded)
+  return true;
+ SDL_LockMutex(cache_lock);
+ Uint32 end=SDL_GetTicks()+ms;
+ bool cached=(cache.find(current_page)!=cache.end());
+ while (!cached)
+ {
+  Uint32 now=SDL_GetTicks();
+  if (now>=end)
+   break;
+  SDL_CondWaitTimeout(cache_cond,cache_lock,end-now);
+  cached=(cache.find(current_page)!=cache.end());
+ }
+ SDL_UnlockMutex(cache_lock);
+ return cached;
+}
+
+bool PDFSlides::CurrentPageArrived(void)
+{
+ bool a=arrived;
+ arrived=false;
+ return a;
+}
     
+SDL_Surface *PDFSlides::GetZoomTile(int level,int tx,int ty)
+{
+ if (!pdfloaded || (level<1) || (tx<0) || (ty<0))
+  return nullptr;
+
+ ZoomKey k;
+ k.page=current_page;
+ k.level=level;
+ k.tx=tx;
+ k.ty=ty;
+ std::map<ZoomKey,ZoomTile>::iterator it=zoom_tiles.find(k);
+ if (it!=zoom_tiles.end())
+ {
+  it->second.used=++zoom_clock;
+  return it->second.s;
+ }
+
+ if (zoom_pending.find(k)!=zoom_pending.end())
+  return nullptr;
+
+ // The zoomed page is measured on the surface of the page as it is shown
+ SDL_Surface *page=RenderToCache(current_page,true);
+ int fw=page->w,fh=page->h;
+ int x=tx*ZoomTileSize,y=ty*ZoomTileSize;
+ int w=std::min(ZoomTileSize,(fw<<level)-x),h=std::min(ZoomTileSize,(fh<<level)-y);
+ if ((w<=0) || (h<=0))
+  return nullptr;
+
+ // The tile is rendered by a worker, and the main thread keeps it when it arrives, unless the document has been reloaded meanwhile
+ zoom_pending.insert(k);
+ Uint32 gen=generation;
+ bool rot=default_rot;
+ scheduler.Submit(Scheduler::Refinement,nav_token,[this,k,gen,rot,fw,fh,x,y,w,h](const CancelToken &)
+ {
+  SourcePtr src=CurrentSource();
+  poppler::document *doc=Borrow(src);
+  SDL_Surface *s;
+  {
+   ScopedTimer t(prof,Profiler::PageRender);
+   Uint64 start=InputQueue::Now();
+   s=GetRegionSurface(doc,k.page,rot,fw,fh,float(1<<k.level),x,y,w,h);
+   last_render=InputQueue::Now()-start;
+  }
+  GiveBack(src,doc);
+  scheduler.PostToMain([this,k,gen,s]() { ZoomTileArrived(k,gen,s); });
+ });
+ return nullptr;
+}
+
+void PDFSlides::ZoomTileArrived(const ZoomKey &k,Uint32 gen,SDL_Surface *s)
+{
+ zoom_pending.erase(k);
+ if (s==nullptr)
+  return;
+ if ((gen!=generation) || (k.page!=current_page) || (zoom_tiles.find(k)!=zoom_tiles.end()))
+ {
+  SDL_FreeSurface(s);
+  return;
+ }
+
+ // The least recently used tile leaves its place
+ if (int(zoom_tiles.size())>=MaxZoomTiles)
+ {
+  std::map<ZoomKey,ZoomTile>::iterator lru=zoom_tiles.begin();
+  for (std::map<ZoomKey,ZoomTile>::iterator z=zoom_tiles.begin();z!=zoom_tiles.end();++z)
+   if (z->second.used<lru->second.used)
+    lru=z;
+  SDL_FreeSurface(lru->second.s);
+  zoom_tiles.erase(lru);
+ }
+ ZoomTile t;
+ t.s=s;
+ t.used=++zoom_clock;
+ zoom_tiles[k]=t;
+ zoom_arrived=true;
+}
+
+bool PDFSlides::ZoomTilesArrived(void)
+{
+ bool a=zoom_arrived;
+ zoom_arrived=false;
+ return a;
+}
+
+Uint64 PDFSlides::MemoryUse(void)
+{
+ Uint64 m=0;
+ SDL_LockMutex(cache_lock);
+ for (std::map<int,SDL_Surface *>::iterator it=cache.begin();it!=cache.end();++it)
+  m+=Uint64(it->second->pitch)*Uint64(it->second->h);
+ SDL_UnlockMutex(cache_lock);
+ for (std::map<ZoomKey,ZoomTile>::iterator it=zoom_tiles.begin();it!=zoom_tiles.end();++it)
+  m+=Uint64(it->second.s->pitch)*Uint64(it->second.s->h);
+ return m;
+}
+
+SDL_Surface *PDFSlides::RenderPage(int pagenum)
+{
+ if (!pdfloaded)
+  return(nullptr);
+
+ SourcePtr src=CurrentSource();
+ poppler::document *doc=Borrow(src);
+ SDL_Surface *s=GetPageSurface(doc,pagenum,default_rot);
+ GiveBack(src,doc);
+ return(s);
+}
+
+SDL_Surface *PDFSlides::RenderThumbnail(int pagenum,int w,int h)
+{
+ if (!pdfloaded)
+  return(nullptr);
+
+ // The document may be reloaded by the main thread, so its number of pages is that of the source got
+ SourcePtr src=CurrentSource();
+ if ((pagenum<0) || (pagenum>=src->pages))
+  return(nullptr);
+ poppler::document *doc=Borrow(src);
+ SDL_Surface *s=GetThumbnailSurface(doc,pagenum,default_rot,w,h);
+ GiveBack(src,doc);
+ return(s);
+}
+
+std::string PDFSlides::GetPageText(int pagenum)
+{
+ if (!pdfloaded)
+  return std::string();
+
+ std::string t;
+ SourcePtr src=CurrentSource();
+ if ((pagenum<0) || (pagenum>=src->pages))
+  return t;
+ poppler::document *doc=Borrow(src);
+ poppler::page *p=doc->create_page(pagenum);
+ if (p!=nullptr)
+ {
+  poppler::byte_array b=p->text().to_utf8();
+  t.assign(b.begin(),b.end());
+  delete p;
+ }
+ GiveBack(src,doc);
+ return t;
+}
+
+bool PDFSlides::StartReload(void)
+{
+ if (!pdfloaded)
+  return false;
+
+ Uint64 h;
+ std::string err;
+ SourcePtr src=LoadSource(filename,h,err);
+ if (src==nullptr)
+ {
+  std::cerr << "Warning: cannot reload " << filename << " (" << err << "). The loaded slides are kept.\n";
+  return false;
+ }
+ if ((h==new_hash) && (new_source!=nullptr))
+  return false;
+
+ // Whatever was being compared is of no use now. The jobs check their token with the lock, and keep the sources they use while they run.
+ reload_token.Cancel();
+ reload_token=CancelToken();
+ reload_ready=false;
+ new_source.reset();
+ if (h==file_hash)
+ {
+  // Back to the loaded content
+  return false;
+ }
+ new_source=src;
+ new_hash=h;
+ Fingerprint none={0,0};
+ SDL_LockMutex(reload_lock);
+ new_fingerprints.assign(src->pages,none);
+ fingerprints.resize(num_pages,none);
+ int n=std::max(src->pages,num_pages);
+ fingerprints_left=n;
+ SDL_UnlockMutex(reload_lock);
+ SourcePtr old_src=source;
+
+ // From the current page outwards. Each job compares a page of both documents (the hashes of the loaded one are kept from former reloads).
+ // The comparison runs behind the rendering of the slides, since the loaded document is still shown meanwhile.
+ for (int d=0;d<n;d++)
+  for (int sign=1;sign>=-1;sign-=2)
+  {
+   int page=current_page+sign*d;
+   if ((page<0) || (page>=n) || ((d==0) && (sign<0)))
+    continue;
+   scheduler.Submit(Scheduler::Thumbnail,reload_token,[this,page,old_src,src](const CancelToken &t)
+   {
+    Fingerprint o={0,0},nw={0,0};
+    SDL_LockMutex(reload_lock);
+    bool cancelled=t.Cancelled();
+    if (!cancelled && (page<int(fingerprints.size())))
+     o=fingerprints[page];
+    SDL_UnlockMutex(reload_lock);
+    if (cancelled)
+     return;
+
+    // Both documents are read without any lock
+    bool in_old=(page<old_src->pages),in_new=(page<src->pages);
+    poppler::document *od=(in_old) ? Borrow(old_src) : nullptr;
+    poppler::document *nd=(in_new) ? Borrow(src) : nullptr;
+    if (in_old && (o.text==0))
+     o.text=TextHash(od,page);
+    if (in_new)
+     nw.text=TextHash(nd,page);
+    // The text tells most changes (a typo, for instance), and then nothing is rendered. The small rendering tells those of the figures.
+    if (in_old && in_new && (o.text==nw.text))
+    {
+     if (o.pixels==0)
+      o.pixels=PixelHash(od,page);
+     nw.pixels=PixelHash(nd,page);
+    }
+    if (od!=nullptr)
+     GiveBack(old_src,od);
+    if (nd!=nullptr)
+     GiveBack(src,nd);
+
+    bool last=false;
+    SDL_LockMutex(reload_lock);
+    if (!t.Cancelled())
+    {
+     if (in_old)
+      fingerprints[page]=o;
+     if (in_new)
+      new_fingerprints[page]=nw;
+     last=(--fingerprints_left==0);
+    }
+    SDL_UnlockMutex(reload_lock);
+    if (last)
+    {
+     CancelToken token=t;
+     scheduler.PostToMain([this,token]()
+     {
+      if (!token.Cancelled())
+       reload_ready=true;
+     });
+    }
+   });
+  }
+ return true;
+}
+
+bool PDFSlides::ReloadArrived(void)
+{
+ bool r=reload_ready;
+ reload_ready=false;
+ return r;
+}
+
+void PDFSlides::FinishReload(std::vector<bool> &changed)
+{
+ changed.clear();
+ if (new_source==nullptr)
+  return;
+
+ int n=new_source->pages;
+ SDL_LockMutex(reload_lock);
+ changed.resize(n);
+ for (int i=0;i<n;i++)
+  changed[i]=((i>=int(fingerprints.size())) || (fingerprints[i].text!=new_fingerprints[i].text) || (fingerprints[i].pixels!=new_fingerprints[i].pixels));
+ fingerprints.swap(new_fingerprints);
+ new_fingerprints.clear();
+ SDL_UnlockMutex(reload_lock);
+
+ // The documents of the former source are freed when the last worker that uses them gives them back
+ SDL_LockMutex(cache_lock);
+ std::map<int,SDL_Surface *>::iterator it=cache.begin();
+ while (it!=cache.end())
+ {
+  if ((it->first>=n) || changed[it->first])
+  {
+   SDL_FreeSurface(it->second);
+   cache.erase(it++);
+  }
+  else
+   ++it;
+ }
+ source=new_source;
+ generation++;
+ SDL_UnlockMutex(cache_lock);
+ new_source.reset();
+ num_pages=n;
+ file_hash=new_hash;
+ costs->Reload(file_hash,changed);
+
+ std::map<ZoomKey,ZoomTile>::iterator zt=zoom_tiles.begin();
+ while (zt!=zoom_tiles.end())
+ {
+  if ((zt->first.page>=n) || changed[zt->first.page])
+  {
+   SDL_FreeSurface(zt->second.s);
+   zoom_tiles.erase(zt++);
+  }
+  else
+   ++zt;
+ }
+
+ if (current_page>=n)
+  current_page=n-1;
+ Schedule();
+}
+
+bool PDFSlides::GoToPage(int pagenum)
+{
+ if (!pdfloaded || (pagenum<0) || (pagenum>=num_pages) || (pagenum==current_page))
+  return false;
+ current_page=pagenum;
+ Schedule();
+ return true;
+}
+
 SDL_Surface *PDFSlides::GetSplashSurface()
 {
- if (splashdoc==nullptr)
+ if (splash==nullptr)
      return(nullptr);
  
- return(GetPageSurface(splashdoc,0,false));
+ poppler::document *doc=Borrow(splash);
+ SDL_Surface *s=GetPageSurface(doc,0,false);
+ GiveBack(splash,doc);
+ return(s);
 }
 
 bool PDFSlides::ExecuteCommand(Config::Commands command)
+{
+ int former_page=current_page;
+ bool done=Go(command);
+ if (done && (current_page!=former_page))
+  Schedule();
+ return done;
+}
+
+bool PDFSlides::Go(Config::Commands command)
 {
  switch (command)
  {
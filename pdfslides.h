@@ -20,7 +20,12 @@
 
 #include "config.h"
 // All usual includes are already included by config
+#include "scheduler.h"
+#include "profiler.h"
+#include "rendercost.h"
 
+#include <set>
+#include <memory>
 #include <SDL.h>
 
 #include <poppler-document.h>
@@ -38,6 +43,29 @@
  *
  * There are only four Gets for this class (the file name, the current page number, the current page surface and the splash surface) 
  * and no setters, since internal values are filled at construction and not altered later.
+ *
+ * Rendered pages are kept in a cache, which owns their surfaces. Each time the current page changes, the jobs of the
+ * former page still waiting are cancelled and the rendering of the new current page (if it is not in the cache) and of
+ * its neighbours is submitted to the scheduler, so that going to the next or previous slide does not have to wait
+ * for poppler. Pages far from the current one are removed from the cache.
+ *
+ * The time that each page takes to be rendered is kept, also between executions (see RenderCosts). Expensive pages are rendered
+ * in advance from further away than the others, and before them, and a few of them are kept in the cache even when they are far
+ * from the current page, so that they are ready when they are shown.
+ *
+ * To zoom into a slide, the pages are also rendered at 2, 4 or 8 times the size at which they are shown, but only by tiles,
+ * each one rendering its own area of the page. The tiles are rendered by the workers, with the priority of refinements, and
+ * the main thread puts them in the view as they arrive. The tiles of every level (the pyramid) are kept in another cache, so
+ * going back to an area, or to a level seen before, does not render again. Its least recently used tiles are removed first.
+ *
+ * poppler documents are not thread-safe, but several documents opened on the same bytes can be used at once. So the file is read
+ * into memory once, and each thread that renders (the workers and the main thread) borrows a document of its own, opened on
+ * those bytes when no other is idle. Rendering of different pages goes on in parallel, and no lock is held while poppler works.
+ *
+ * The document is read into memory when it is loaded, so that it can be reloaded when the file changes on disk (for example,
+ * when it is compiled again) while the loaded one is still shown. Each page of both documents is identified by a hash of its
+ * text, its size and a small rendering, computed by the workers of the scheduler, and only the pages whose hash differs lose
+ * what the caches keep of them. The current page number is kept.
 */
 class PDFSlides
 {
@@ -51,17 +79,54 @@ class PDFSlides
      * The number of slided to advance or go back when Fast Forward or Fast Backward is requested.
      */
     const int   NumSlidesJump=10;
+
+    /**
+     * Number of pages after and before the current one that are rendered in advance
+     */
+    const int   PrefetchWindow=2;
+
+    /**
+     * Pages further than this from the current one are removed from the cache
+     */
+    const int   CacheWindow=4;
+
+    /**
+     * Maximum number of expensive pages kept in the cache beyond CacheWindow
+     */
+    const int   MaxExpensiveKept=6;
+
+    /**
+     * Side of the tiles of the zoomed pages, in pixels
+     */
+    static const int ZoomTileSize=256;
+
+    /**
+     * Maximum number of tiles of zoomed pages in their cache
+     */
+    const int   MaxZoomTiles=192;
+
+    /**
+     * Width of the box where the small rendering that identifies the content of a page fits
+     */
+    static const int FingerprintWidth=256;
+
+    /**
+     * Height of the box where the small rendering that identifies the content of a page fits
+     */
+    static const int FingerprintHeight=192;
     
     /**
      * Constructor
      * \param cfg A reference to a cfg object full with the data got from the configuration file
      * \param fn The PDF file with the slides (it might be the empty string for no file)
+     * \param sc The scheduler to which rendering in advance is submitted
      */
-    PDFSlides(Config &cfg,std::string fn);
+    PDFSlides(Config &cfg,std::string fn,Scheduler &sc);
 
     /**
      * Destructor
-     * It will release the memory booked by the loaded document (if any).
+     * It will release the memory booked by the loaded document (if any) and the surfaces of the cache.
+     * The scheduler must have been stopped before, since its jobs use this object.
      */
     ~PDFSlides();
  
@@ -76,14 +141,98 @@ class PDFSlides
      * \return The current page number, starting from 0
      */
     int GetCurrentPage() { return current_page; };
-    
+
+    /**
+     * Gets the number of pages of the loaded document
+     * \return The number of pages, or 0 if no document has been loaded and the program is being used as an empty blackboard
+     */
+    int GetNumPages() { return (pdfloaded) ? num_pages : 0; };
+
+    /**
+     * Gets a hash of the content of the loaded PDF file. It identifies the document independently of its name or location,
+     * so that data associated to it (like the lines drawn on its slides) can be found again in later executions.
+     * \return The 64-bit hash of the file content, or 0 if no document has been loaded
+     */
+    Uint64 GetFileHash() { return file_hash; };
     
     /**
-     * Obtains the SDL surface of the current page, so it can be drawn.
+     * Obtains the SDL surface of the current page, so it can be drawn. If it is not in the cache it is rendered now (or, if it is being rendered by a worker, this waits for it).
      * \return The SDL surface of the current page of the document (that which has to be shown), or nullptr if no document has been loaded and the program is being used as an empty blackboard.
+     *         The surface belongs to the cache and must not be freed.
      */
     SDL_Surface *GetCurrentPageSurface();
 
+    /**
+     * Waits a limited time for the current page to be in the cache
+     * \param ms Maximum time to wait, in milliseconds
+     * \return true if the current page is already rendered (so GetCurrentPageSurface will return at once) or if there is no document, false otherwise
+     */
+    bool WaitCurrentPage(Uint32 ms);
+
+    /**
+     * Tells if the current page, which was not rendered when it was requested, has arrived to the cache since then. The mark is reset by this call.
+     * \return true if the current page has to be shown now
+     */
+    bool CurrentPageArrived(void);
+
+    /**
+     * Cancels the rendering in advance that has not started yet. To be called before stopping the scheduler at the end of the program.
+     */
+    void CancelJobs(void) { nav_token.Cancel(); };
+
+    /**
+     * Sets the profiler that measures the rendering of pages, done in the workers of the scheduler or in the calling thread
+     * \param p The profiler, or nullptr not to measure anything
+     */
+    void SetProfiler(Profiler *p) { prof=p; };
+
+    /**
+     * Writes the file of the rendering times of the pages, if sessions are kept. To be called once the scheduler is stopped.
+     */
+    void SaveCosts(void) { costs->Save(); };
+
+    /**
+     * Gets the time taken by the last page rendered
+     * \return Nanoseconds, or 0 if no page has been rendered yet
+     */
+    Uint64 GetLastRenderTime(void) { return last_render; };
+
+    /**
+     * Gets how many times a page was asked for (to be shown) and it was already in the cache
+     * \return Number of hits
+     */
+    Uint64 GetCacheHits(void) { return cache_hits; };
+
+    /**
+     * Gets how many times a page was asked for (to be shown) and it had to be rendered, or waited for
+     * \return Number of misses
+     */
+    Uint64 GetCacheMisses(void) { return cache_misses; };
+
+    /**
+     * Obtains a tile of the current page zoomed in, if it is in the cache of tiles. Otherwise, only its area of the page is rendered,
+     * by a worker with the priority of refinements, and ZoomTilesArrived tells when it is in the cache.
+     * \param level The zoom level: the page is 2^level times larger than the surface of the current page (1 or more)
+     * \param tx The column of the tile
+     * \param ty The row of the tile
+     * \return The SDL surface of the tile, which belongs to the cache and must not be freed, or nullptr if it is not rendered yet, if there
+     *         is no document or if the tile is out of the page. Tiles of the right and bottom edges of the page are smaller.
+     */
+    SDL_Surface *GetZoomTile(int level,int tx,int ty);
+
+    /**
+     * Tells if tiles of the zoomed pages have arrived to their cache since the last call, so that the zoomed view has to be drawn again.
+     * The mark is reset by this call.
+     * \return true if some tile has arrived
+     */
+    bool ZoomTilesArrived(void);
+
+    /**
+     * Gets the memory used by the pixels of the pages and of the zoomed tiles in the caches
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void);
+
     /**
      * Obtains the SDL surface of the splash initial screen so it can be drawn.
      * \return The SDL surface of the splash screen, or nullptr if the configuration has indicated that no splash screen is to be shown.
@@ -96,10 +245,108 @@ class PDFSlides
      * \return true if the command has been executed (and therefore, the canvas will have to be updated), false if not.
      */
     bool ExecuteCommand(Config::Commands command);
+
+    /**
+     * Goes to a page, as the navigation commands do
+     * \param pagenum The page number, starting from 0
+     * \return true if the current page has changed, false if it was already that one or there is no such page
+     */
+    bool GoToPage(int pagenum);
+
+    /**
+     * Renders a small image of a page, at the resolution that fits it in a box, without using nor filling the cache. It can be called from the workers of the scheduler.
+     * \param pagenum The page number, starting from 0
+     * \param w Width of the box
+     * \param h Height of the box
+     * \return The SDL surface of the image, which must be freed by the caller, or nullptr if there is no such page
+     */
+    SDL_Surface *RenderThumbnail(int pagenum,int w,int h);
+
+    /**
+     * Extracts the text of a page. It can be called from the workers of the scheduler.
+     * \param pagenum The page number, starting from 0
+     * \return The text, in UTF-8, or the empty string if there is no such page
+     */
+    std::string GetPageText(int pagenum);
+
+    /**
+     * Starts reloading the PDF file, once it has changed on disk. The new document is read, and the workers of the scheduler compare its
+     * pages with those of the loaded one, which is still the one shown. ReloadArrived tells when they are done. A reload that was
+     * being compared is abandoned.
+     * \return true if the file has been read and its content is new, false if it is the same or it cannot be read (then, the loaded document is kept)
+     */
+    bool StartReload(void);
+
+    /**
+     * Tells if the pages of the document being reloaded have been compared since the last call, so that FinishReload has to be called. The mark is reset by this call.
+     * \return true if the reload can be finished
+     */
+    bool ReloadArrived(void);
+
+    /**
+     * Replaces the loaded document by the one being reloaded. The rendered pages and the zoomed tiles of the pages whose content has
+     * changed are removed from the caches, and those of the others are kept. The current page is kept too, unless the document is now shorter.
+     * \param changed For each page of the new document, true if it is not the same as the page with the same number of the former one
+     */
+    void FinishReload(std::vector<bool> &changed);
+
+    /**
+     * Renders a page of the loaded document, without using nor filling the cache (used by the benchmarks to measure poppler plus the conversion)
+     * \param pagenum The page number, starting from 0
+     * \return The SDL surface of the page, which must be freed by the caller, or nullptr if there is no such page
+     */
+    SDL_Surface *RenderPage(int pagenum);
+
+    /**
+     * Converts an image rendered by poppler to a SDL surface with the same size
+     * \param img The image, in format rgb24 or argb32
+     * \return The new SDL surface, which must be freed by the caller
+     */
+    static SDL_Surface *ImageToSurface(const poppler::image &img);
     
  private:
-    poppler::document *InitDoc(std::string fn,bool rot);
+    // The bytes of a PDF file and the documents opened on them that are idle (protected by lock). Those borrowed are given back
+    // to the source they came from, so a source lives while some thread renders from it, even after the file is reloaded.
+    struct Source
+    {
+     std::vector<char> data;
+     int pages;
+     SDL_mutex *lock;
+     std::vector<poppler::document *> idle;
+     Source();
+     ~Source();
+    };
+    typedef std::shared_ptr<Source> SourcePtr;
+
+    SourcePtr InitDoc(std::string fn,bool rot,Uint64 *hash=nullptr);
+    // Reads a whole file into memory and opens a first document on it, so that later changes of the file do not affect the document.
+    // It returns nullptr and the reason if it cannot be loaded.
+    static SourcePtr LoadSource(const std::string &fn,Uint64 &hash,std::string &err);
+    // Gets a document of a source for the calling thread, opening a new one if all are in use
+    static poppler::document *Borrow(const SourcePtr &src);
+    static void GiveBack(const SourcePtr &src,poppler::document *doc);
+    // The source of the loaded document and its generation, for the workers
+    SourcePtr CurrentSource(Uint32 *gen=nullptr);
     SDL_Surface *GetPageSurface(poppler::document *doc,int pagenum,bool rot);
+    // Renders an area of a page that, as a whole, would be scale times larger than the surface of fw x fh pixels returned by GetPageSurface
+    SDL_Surface *GetThumbnailSurface(poppler::document *doc,int pagenum,bool rot,int w,int h);
+    SDL_Surface *GetRegionSurface(poppler::document *doc,int pagenum,bool rot,int fw,int fh,float scale,int x,int y,int w,int h);
+
+    // Renders a page to the cache, unless it is already there. If another thread is rendering it, waits for it (wait==true) or returns at once (wait==false).
+    SDL_Surface *RenderToCache(int pagenum,bool wait);
+    // Changes the current page as asked by a command
+    bool Go(Config::Commands command);
+    // Cancels the jobs of the former page, submits those of the current one and removes from the cache the pages far from it
+    void Schedule(void);
+
+    static const Uint64 FNVOffset=0xcbf29ce484222325ULL;
+    static const Uint64 FNVPrime=0x100000001b3ULL;
+    // FNV-1a hash of some data, computed word by word, going on from a former hash h
+    static Uint64 HashData(const unsigned char *p,size_t len,Uint64 h=FNVOffset);
+    // Hash of the text and the size of a page, never 0
+    Uint64 TextHash(poppler::document *doc,int pagenum);
+    // Hash of a small rendering of a page, never 0. It is only needed when the text and the size have not changed.
+    Uint64 PixelHash(poppler::document *doc,int pagenum);
     /**
      * Advances to the next slide, if possible
      * \return true if the current slide is not the last one, false otherwise. 
@@ -137,13 +384,69 @@ class PDFSlides
     bool GoLast();
 
     std::string filename;
-    poppler::document *slidesdoc,*splashdoc;
+    // The loaded document and the splash screen. source is only changed by the main thread, with cache_lock.
+    SourcePtr source,splash;
+    int num_pages;
     bool default_rot;
     Sint32 sch;
     Sint32 scw;
     bool pdfloaded;
     int current_page;
+    Uint64 file_hash;
     SDL_Surface *splash_surface;
+
+    Scheduler &scheduler;
+    CancelToken nav_token;
+    // cache and rendering are protected by cache_lock; cache_cond is signalled when a page arrives to the cache
+    SDL_mutex *cache_lock;
+    SDL_cond *cache_cond;
+    std::map<int,SDL_Surface *> cache;
+    std::set<int> rendering;
+    // Time taken by each page to be rendered
+    RenderCosts *costs;
+    // Only used by the main thread
+    bool delivered,arrived;
+
+    // The tiles of the zoomed pages, used only by the main thread, and when each one was last asked for
+    struct ZoomKey
+    {
+     int page,level,tx,ty;
+     bool operator<(const ZoomKey &o) const
+     { return (page!=o.page) ? (page<o.page) : (level!=o.level) ? (level<o.level) : (ty!=o.ty) ? (ty<o.ty) : (tx<o.tx); };
+    };
+    struct ZoomTile
+    {
+     SDL_Surface *s;
+     Uint64 used;
+    };
+    std::map<ZoomKey,ZoomTile> zoom_tiles;
+    Uint64 zoom_clock;
+    // The tiles being rendered by the workers, and if any has arrived since ZoomTilesArrived was called
+    std::set<ZoomKey> zoom_pending;
+    bool zoom_arrived;
+    // Keeps a tile rendered by a worker, in the main thread
+    void ZoomTileArrived(const ZoomKey &k,Uint32 gen,SDL_Surface *s);
+
+    // The document being reloaded, and the hashes of the pages of both documents (0 until they are computed), protected by reload_lock.
+    // generation changes with the document, with cache_lock, so that a page rendered from the former one does not enter the cache.
+    struct Fingerprint
+    {
+     Uint64 text,pixels;
+    };
+    SourcePtr new_source;
+    Uint64 new_hash;
+    SDL_mutex *reload_lock;
+    std::vector<Fingerprint> fingerprints,new_fingerprints;
+    int fingerprints_left;
+    Uint32 generation;
+    CancelToken reload_token;
+    // Only used by the main thread
+    bool reload_ready;
+
+    Profiler *prof;
+    // Written by the workers, read by the main thread to show them
+    std::atomic<Uint64> last_render;
+    std::atomic<Uint64> cache_hits,cache_misses;
 };
 
 #endif // PDFSLIDES_H
@@ -0,0 +1,184 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "pointer.h"
+#include "linewalk.h"
+
+#include <iostream>
+#include <algorithm>
+
+PointerTrail::PointerTrail(Uint32 ms,int w,int h,SDL_Color col)
+{
+ life=Uint64(ms)*1000000ULL;
+ width=w;
+ height=h;
+ color=col;
+ overlay=nullptr;
+ origin=0;
+}
+
+PointerTrail::~PointerTrail()
+{
+ if (overlay!=nullptr)
+  SDL_FreeSurface(overlay);
+}
+
+Uint8 PointerTrail::Alpha(Uint64 stamp,Uint64 now)
+{
+ Uint64 age=(now>stamp) ? now-stamp : 0;
+ if (age<life)
+  return SDL_ALPHA_OPAQUE;
+ Uint64 fade=Uint64(FadeTime)*1000000ULL;
+ if (age>=life+fade)
+  return SDL_ALPHA_TRANSPARENT;
+ return Uint8(Uint64(SDL_ALPHA_OPAQUE)*(life+fade-age)/fade);
+}
+
+void PointerTrail::Line(int xa,int ya,int xb,int yb,int size,int offset,SDL_Rect r,Uint64 stamp)
+{
+ if (overlay==nullptr)
+ {
+  overlay=SDL_CreateRGBSurface(SDL_SWSURFACE,width,height,32,0x00FF0000,0x0000FF00,0x000000FF,0xFF000000);
+  if (overlay==nullptr)
+  {
+   std::cerr << "Error creating the SDL surface of the pointer. Exiting.\n";
+   SDL_Quit();
+   exit(1);
+  }
+  SDL_SetAlpha(overlay,SDL_SRCALPHA,SDL_ALPHA_OPAQUE);
+  SDL_FillRect(overlay,nullptr,0);
+  stamps.assign(size_t(width)*size_t(height),0);
+ }
+ // Moments are kept from the first piece of the trail, so that they fit in 32 bits
+ if (pieces.empty())
+  origin=stamp;
+ Uint32 ms=Uint32((stamp-origin)/1000000ULL)+1;
+ Uint32 ink=SDL_MapRGBA(overlay->format,color.r,color.g,color.b,SDL_ALPHA_OPAQUE);
+ int rx2=std::min(int(r.x)+int(r.w),width),ry2=std::min(int(r.y)+int(r.h),height);
+
+ // The brush is put at each point of the line, as the pen does
+ SDL_LockSurface(overlay);
+ WalkLine(xa,ya,xb,yb,[&](int x,int y)
+ {
+  int x1=std::max(x-offset,int(r.x));
+  int y1=std::max(y-offset,int(r.y));
+  int x2=std::min(x-offset+size,rx2);
+  int y2=std::min(y-offset+size,ry2);
+  for (int yy=y1;yy<y2;yy++)
+  {
+   Uint32 *p=(Uint32 *)((Uint8 *)overlay->pixels+yy*overlay->pitch);
+   Uint32 *t=&stamps[size_t(yy)*size_t(width)];
+   for (int xx=x1;xx<x2;xx++)
+   {
+    p[xx]=ink;
+    t[xx]=ms;
+   }
+  }
+ });
+ SDL_UnlockSurface(overlay);
+
+ Piece pc;
+ pc.r=r;
+ pc.stamp=stamp;
+ pc.alpha=SDL_ALPHA_OPAQUE;
+ pieces.push_back(pc);
+}
+
+Uint32 PointerTrail::Wait(Uint64 now)
+{
+ if (pieces.empty())
+  return SDL_MUTEX_MAXWAIT;
+ // The oldest piece is the first one to fade
+ Uint64 age=(now>pieces.front().stamp) ? now-pieces.front().stamp : 0;
+ if (age>=life)
+  return FrameTime;
+ return Uint32((life-age+999999ULL)/1000000ULL);
+}
+
+void PointerTrail::Refresh(const SDL_Rect &r,Uint64 now)
+{
+ Uint32 rgb=SDL_MapRGBA(overlay->format,color.r,color.g,color.b,SDL_ALPHA_TRANSPARENT);
+ Uint32 amask=overlay->format->Amask;
+ int ashift=overlay->format->Ashift;
+ int x2=std::min(int(r.x)+int(r.w),width),y2=std::min(int(r.y)+int(r.h),height);
+ SDL_LockSurface(overlay);
+ for (int y=std::max(int(r.y),0);y<y2;y++)
+ {
+  Uint32 *p=(Uint32 *)((Uint8 *)overlay->pixels+y*overlay->pitch);
+  Uint32 *t=&stamps[size_t(y)*size_t(width)];
+  for (int x=std::max(int(r.x),0);x<x2;x++)
+  {
+   if (t[x]==0)
+    continue;
+   Uint8 a=Alpha(origin+Uint64(t[x]-1)*1000000ULL,now);
+   if (a==SDL_ALPHA_TRANSPARENT)
+    t[x]=0;
+   p[x]=(rgb & ~amask) | (Uint32(a)<<ashift);
+  }
+ }
+ SDL_UnlockSurface(overlay);
+}
+
+void PointerTrail::Advance(Uint64 now,std::vector<SDL_Rect> &dirty)
+{
+ for (size_t i=0;i<pieces.size();i++)
+ {
+  Uint8 a=Alpha(pieces[i].stamp,now);
+  // Pieces are in the order they were drawn, so once one is opaque all the following are
+  if (a==SDL_ALPHA_OPAQUE)
+   break;
+  if (a!=pieces[i].alpha)
+  {
+   pieces[i].alpha=a;
+   Refresh(pieces[i].r,now);
+   dirty.push_back(pieces[i].r);
+  }
+ }
+ while (!pieces.empty() && (pieces.front().alpha==SDL_ALPHA_TRANSPARENT))
+  pieces.pop_front();
+}
+
+void PointerTrail::Draw(SDL_Surface *dst,const SDL_Rect &r)
+{
+ if (pieces.empty())
+  return;
+ // The overlay is blended by SDL with the alpha of each pixel; where there is no ink it is transparent
+ SDL_Rect s=r;
+ SDL_Rect d=r;
+ SDL_BlitSurface(overlay,&s,dst,&d);
+}
+
+void PointerTrail::Clear(std::vector<SDL_Rect> &dirty)
+{
+ for (size_t i=0;i<pieces.size();i++)
+ {
+  dirty.push_back(pieces[i].r);
+  int x2=std::min(int(pieces[i].r.x)+int(pieces[i].r.w),width),y2=std::min(int(pieces[i].r.y)+int(pieces[i].r.h),height);
+  for (int y=std::max(int(pieces[i].r.y),0);y<y2;y++)
+   std::fill(&stamps[size_t(y)*size_t(width)+std::max(int(pieces[i].r.x),0)],&stamps[size_t(y)*size_t(width)]+x2,Uint32(0));
+  SDL_Rect f=pieces[i].r;
+  SDL_FillRect(overlay,&f,0);
+ }
+ pieces.clear();
+}
+
+Uint64 PointerTrail::MemoryUse(void)
+{
+ if (overlay==nullptr)
+  return 0;
+ return Uint64(overlay->pitch)*Uint64(overlay->h)+stamps.capacity()*sizeof(Uint32);
+}
@@ -0,0 +1,139 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef POINTER_H
+#define POINTER_H
+
+#include <deque>
+#include <vector>
+#include <SDL/SDL.h>
+
+/*! \brief Class to keep the ink of the pointer, which fades out by itself some time after being drawn
+ *
+ * The pointer draws only on the screen. Its ink is kept in a single overlay as large as the canvas, with an alpha channel,
+ * together with the moment each pixel was drawn. Each piece of its lines is remembered only by its area and its moment. After
+ * the time given by the configuration, the piece fades out during FadeTime, and then it is dropped: the alpha of the pixels of
+ * its area is taken again from their own moments, so pixels drawn again later by a newer piece do not fade with it. Older pieces
+ * fade first, so the line vanishes from its start, as the trail of a laser pointer.
+ *
+ * The trail does not touch the canvas: it tells which areas have changed, and the canvas restores them (from its copy of the
+ * slide and the traces, without merging the whole canvas) and draws the overlay again over them, with a single blit per area.
+ *
+ * While nothing fades, nothing has to be done until the oldest piece starts fading, so the main loop can sleep until then.
+*/
+class PointerTrail
+{
+ public:
+    /**
+     * Time, in milliseconds, that each piece takes to fade out
+     */
+    static const Uint32 FadeTime = 400;
+
+    /**
+     * Time, in milliseconds, between the frames of the fading
+     */
+    static const Uint32 FrameTime = 20;
+
+    /**
+     * Constructor. The overlay is not allocated until the pointer draws.
+     * \param ms Time, in milliseconds, that each piece is seen before fading out
+     * \param w Width of the canvas
+     * \param h Height of the canvas
+     * \param col Color of the ink
+     */
+    PointerTrail(Uint32 ms,int w,int h,SDL_Color col);
+
+    /**
+     * Destructor. It frees the overlay.
+     */
+    ~PointerTrail();
+
+    /**
+     * Draws a piece of line in the overlay, with a square brush at each of its points except the last one
+     * \param xa Value of coordinate x of the start of the line
+     * \param ya Value of coordinate y of the start of the line
+     * \param xb Value of coordinate x of the end of the line
+     * \param yb Value of coordinate y of the end of the line
+     * \param size Side of the brush, in pixels
+     * \param offset Distance from each point to the upper-left corner of the brush
+     * \param r The area of the piece in the canvas, out of which nothing is drawn
+     * \param stamp The moment it is drawn, as given by InputQueue::Now
+     */
+    void Line(int xa,int ya,int xb,int yb,int size,int offset,SDL_Rect r,Uint64 stamp);
+
+    /**
+     * Tells if there is no ink of the pointer
+     * \return true if there are no pieces
+     */
+    bool Empty(void) { return pieces.empty(); };
+
+    /**
+     * Gets how long the caller may wait before calling Advance again
+     * \param now The current moment, as given by InputQueue::Now
+     * \return Milliseconds, or SDL_MUTEX_MAXWAIT if there is no ink
+     */
+    Uint32 Wait(Uint64 now);
+
+    /**
+     * Updates the transparency of the pieces, dropping those that have faded out
+     * \param now The current moment, as given by InputQueue::Now
+     * \param dirty The areas of the pieces that have changed are appended to it
+     */
+    void Advance(Uint64 now,std::vector<SDL_Rect> &dirty);
+
+    /**
+     * Draws the ink that is inside an area, with its current transparency
+     * \param dst The surface where it is drawn (the canvas)
+     * \param r The area
+     */
+    void Draw(SDL_Surface *dst,const SDL_Rect &r);
+
+    /**
+     * Drops all the pieces
+     * \param dirty The areas of the pieces are appended to it
+     */
+    void Clear(std::vector<SDL_Rect> &dirty);
+
+    /**
+     * Gets the memory used by the overlay and the moments of its pixels
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void);
+
+ private:
+    struct Piece
+    {
+     SDL_Rect r;
+     Uint64 stamp;
+     Uint8 alpha;
+    };
+
+    Uint8 Alpha(Uint64 stamp,Uint64 now);
+    // Takes again the alpha of the pixels of an area from their moments
+    void Refresh(const SDL_Rect &r,Uint64 now);
+
+    Uint64 life;
+    int width,height;
+    SDL_Color color;
+    std::deque<Piece> pieces;
+    // The ink, and the moment each pixel was drawn, in milliseconds from origin plus 1 (0 where there is no ink)
+    SDL_Surface *overlay;
+    std::vector<Uint32> stamps;
+    Uint64 origin;
+};
+
+#endif
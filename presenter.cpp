@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "presenter.h"
+
+#include <SDL/SDL_syswm.h>
+
+Presenter *Presenter::Create(Config &cfg)
+{
+ if (cfg.GetHeadless())
+  return new OffscreenPresenter(cfg.GetXres(),cfg.GetYres(),cfg.GetHeadlessDepth(),cfg.GetHeadlessBGR());
+ return new WindowPresenter(cfg);
+}
+
+WindowPresenter::WindowPresenter(Config &cfg)
+{
+ // SDL is asked to pump the events in a thread of its own, so that the input thread can read them. Not all systems allow that.
+ threaded_events=true;
+ if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTTHREAD)<0)
+ {
+  threaded_events=false;
+  if (SDL_Init(SDL_INIT_VIDEO)<0)
+  {
+   std::cerr << "Error initializing SDL.\n";
+   exit(1);
+  }
+ }
+ const SDL_VideoInfo *inf=SDL_GetVideoInfo();
+ 
+ int scw,sch;
+ int flags=SDL_SWSURFACE;
+ if (!cfg.GetInWin())
+ {
+  flags|=SDL_FULLSCREEN;
+  scw=inf->current_w;
+  sch=inf->current_h;
+  cfg.SetRes(scw,sch);
+ }
+ else
+ {
+  scw=cfg.GetXres();
+  sch=cfg.GetYres();
+  //window=SDL_CreateWindow("VBB",SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, scw, sch, SDL_WINDOW_RESIZABLE);  
+ }
+
+ if ((screen=SDL_SetVideoMode(scw,sch,inf->vfmt->BitsPerPixel,flags))==nullptr)
+ {
+  std::cerr << "Error creating main SDL surface. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+
+ // This code is just to set the window name, so that external programs can locate it for sending events, share it, etc. 
+ SDL_SysWMinfo myinfo;
+ SDL_VERSION(&myinfo.version);
+ if (SDL_GetWMInfo(&myinfo))
+ {
+  if (cfg.GetInWin())
+   XStoreName(myinfo.info.x11.display,myinfo.info.x11.wmwindow,"VirtualBlackboard");
+  else
+   XStoreName(myinfo.info.x11.display,myinfo.info.x11.fswindow,"VirtualBlackboard");
+ 
+ }
+}
+
+OffscreenPresenter::OffscreenPresenter(int w,int h,int bpp,bool bgr)
+{
+ // No subsystem is needed: surfaces in memory, blits and fills work without video.
+ if (SDL_Init(SDL_INIT_NOPARACHUTE)<0)
+ {
+  std::cerr << "Error initializing SDL.\n";
+  exit(1);
+ }
+
+ Uint32 rmask=0,gmask=0,bmask=0;
+ switch (bpp)
+ {
+  case 8: break;
+  case 16: rmask=0xF800; gmask=0x07E0; bmask=0x001F; break;
+  case 24:
+  case 32:
+           rmask=0x00FF0000;
+           gmask=0x0000FF00;
+           bmask=0x000000FF;
+           break;
+  default:
+   std::cerr << "Error: offscreen display with an unsupported depth of " << bpp << " bits per pixel. Exiting.\n";
+   SDL_Quit();
+   exit(1);
+ }
+ if (bgr)
+  std::swap(rmask,bmask);
+ if ((screen=SDL_CreateRGBSurface(SDL_SWSURFACE,w,h,bpp,rmask,gmask,bmask,0))==nullptr)
+ {
+  std::cerr << "Error creating offscreen SDL surface. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+
+ // An 8-bit surface needs a palette with the colors of the canvas: a 3-3-2 cube has all of them
+ if (bpp==8)
+ {
+  SDL_Color pal[256];
+  for (int i=0;i<256;i++)
+  {
+   pal[i].r=Uint8(((i>>5) & 7)*255/7);
+   pal[i].g=Uint8(((i>>2) & 7)*255/7);
+   pal[i].b=Uint8((i & 3)*255/3);
+   pal[i].unused=0;
+  }
+  SDL_SetPalette(screen,SDL_LOGPAL,pal,0,256);
+ }
+}
+
+OffscreenPresenter::~OffscreenPresenter()
+{
+ SDL_FreeSurface(screen);
+}
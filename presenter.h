@@ -0,0 +1,145 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef PRESENTER_H
+#define PRESENTER_H
+
+#include "config.h"
+#include <SDL/SDL.h>
+
+/*! \brief Abstract class for the place where the canvas is presented
+ *
+ * The Canvas draws everything in the surface it gets from its Presenter and tells the Presenter which
+ * rectangles have changed. What the Presenter does with them depends on the implementation:
+ * WindowPresenter shows them in a window or in full screen, and OffscreenPresenter just keeps them in
+ * memory, so that the program can run (and be measured) in a machine without graphical display.
+ *
+ * The Presenter is also who initializes SDL, since how it is done depends on having a real screen or not.
+*/
+class Presenter
+{
+ public:
+    /**
+     * Creates the presenter asked for by the configuration: offscreen if Headless is set, a window or the full screen otherwise.
+     * \param cfg The configuration object. If the full screen is used, its resolution is set in it.
+     * \return The new presenter. It must be deleted before calling SDL_Quit.
+     */
+    static Presenter *Create(Config &cfg);
+
+    /**
+     * Destructor
+     */
+    virtual ~Presenter() {};
+
+    /**
+     * Gets the surface where the canvas has to draw
+     * \return The surface, with the size of the screen or window
+     */
+    SDL_Surface *GetSurface(void) { return screen; };
+
+    /**
+     * Presents a rectangle of the surface that has changed
+     * \param x x coordinate of the upper-left corner
+     * \param y y coordinate of the upper-left corner
+     * \param w Width
+     * \param h Height
+     */
+    void Update(Sint32 x,Sint32 y,Uint32 w,Uint32 h) { updates++; updated_pixels+=Uint64(w)*Uint64(h); Present(x,y,w,h); };
+
+    /**
+     * Tells if there is a user in front of this presenter, who can send events
+     * \return true for a window or a screen, false for an offscreen presenter
+     */
+    virtual bool Interactive(void)=0;
+
+    /**
+     * Tells if SDL pumps the events in its own thread
+     * \return true if SDL was initialized with its event thread
+     */
+    bool ThreadedEvents(void) { return threaded_events; };
+
+    /**
+     * Gets the number of updates done
+     * \return Number of calls to Update
+     */
+    Uint64 GetUpdates(void) { return updates; };
+
+    /**
+     * Gets the number of pixels updated
+     * \return Sum of the areas of all the updated rectangles
+     */
+    Uint64 GetUpdatedPixels(void) { return updated_pixels; };
+
+ protected:
+    Presenter() : screen(nullptr), threaded_events(false), updates(0), updated_pixels(0) {};
+
+    virtual void Present(Sint32 x,Sint32 y,Uint32 w,Uint32 h)=0;
+
+    SDL_Surface *screen;
+    bool threaded_events;
+
+ private:
+    Uint64 updates;
+    Uint64 updated_pixels;
+};
+
+/*! \brief Presenter in a window or in the full screen, through SDL and X11
+*/
+class WindowPresenter : public Presenter
+{
+ public:
+    /**
+     * Constructor. It initializes SDL and opens the window or the full screen, as the configuration says.
+     * \param cfg The configuration object. If the full screen is used, its resolution is set in it.
+     */
+    WindowPresenter(Config &cfg);
+
+    bool Interactive(void) { return true; };
+
+ protected:
+    void Present(Sint32 x,Sint32 y,Uint32 w,Uint32 h) { SDL_UpdateRect(screen,x,y,w,h); };
+};
+
+/*! \brief Presenter in memory, without any screen
+ *
+ * The surface is a plain SDL surface in memory, 32 bits per pixel unless other depth or order of the components is asked for. Updates
+ * are only counted. SDL is initialized without video, so nothing here needs an X server.
+*/
+class OffscreenPresenter : public Presenter
+{
+ public:
+    /**
+     * Constructor. It initializes SDL without video and creates the surface in memory.
+     * \param w Width
+     * \param h Height
+     * \param bpp Bits per pixel (8, 16, 24 or 32)
+     * \param bgr true to put blue in the highest bits of the pixel and red in the lowest (ignored with 8 bits, which use a palette)
+     */
+    OffscreenPresenter(int w,int h,int bpp=32,bool bgr=false);
+
+    /**
+     * Destructor. It frees the surface.
+     */
+    ~OffscreenPresenter();
+
+    bool Interactive(void) { return false; };
+
+ protected:
+    void Present(Sint32,Sint32,Uint32,Uint32) {};
+};
+
+#endif
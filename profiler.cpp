@@ -0,0 +1,140 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "profiler.h"
+
+#include <fstream>
+#include <cstring>
+
+static const char *ProbeNames[Profiler::NumProbes]={ "event handling", "pen to screen", "slide change", "page render",
+                                                    "show", "merge", "update", "save" };
+
+Profiler::Profiler(bool keep_events)
+{
+ keep=keep_events;
+ memset(hist,0,sizeof(hist));
+ origin=InputQueue::Now();
+ lock=SDL_CreateMutex();
+ if (lock==nullptr)
+ {
+  std::cerr << "Error creating the synchronization object of the profiler. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+}
+
+Profiler::~Profiler()
+{
+ SDL_DestroyMutex(lock);
+}
+
+int Profiler::Bucket(Uint64 ns)
+{
+ // Below 2*SubBuckets, one bucket per nanosecond. Then, SubBuckets per power of two.
+ if (ns<Uint64(2*SubBuckets))
+  return int(ns);
+ int e=63-__builtin_clzll(ns);
+ int sub=int((ns>>(e-3)) & (SubBuckets-1));
+ return (e-2)*SubBuckets+sub;
+}
+
+Uint64 Profiler::BucketLimit(int b)
+{
+ if (b<2*SubBuckets)
+  return Uint64(b);
+ int e=b/SubBuckets+2;
+ Uint64 low=Uint64(SubBuckets+b%SubBuckets)<<(e-3);
+ return low+(Uint64(1)<<(e-3))-1;
+}
+
+void Profiler::Record(Probes p,Uint64 start,Uint64 end)
+{
+ Uint64 d=(end>start) ? end-start : 0;
+ SDL_LockMutex(lock);
+ Histogram &h=hist[p];
+ h.count++;
+ h.sum+=d;
+ if (d>h.max)
+  h.max=d;
+ h.buckets[Bucket(d)]++;
+ if (keep && (events.size()<MaxTraceEvents))
+ {
+  Event e;
+  e.start=start;
+  e.duration=d;
+  e.thread=SDL_ThreadID();
+  e.probe=p;
+  events.push_back(e);
+ }
+ SDL_UnlockMutex(lock);
+}
+
+Uint64 Profiler::Percentile(const Histogram &h,double q)
+{
+ Uint64 rank=Uint64(q*double(h.count));
+ if (rank>=h.count)
+  rank=h.count-1;
+ Uint64 seen=0;
+ for (int b=0;b<NumBuckets;b++)
+ {
+  seen+=h.buckets[b];
+  if (seen>rank)
+   return (BucketLimit(b)<h.max) ? BucketLimit(b) : h.max;
+ }
+ return h.max;
+}
+
+void Profiler::PrintStatistics(std::ostream &out)
+{
+ SDL_LockMutex(lock);
+ out << "Profile (times in us):\n";
+ for (int p=0;p<NumProbes;p++)
+ {
+  Histogram &h=hist[p];
+  if (h.count==0)
+   continue;
+  out << "  " << ProbeNames[p] << ": " << h.count << " times, mean " << (h.sum/h.count)/1000
+      << ", p50 " << Percentile(h,0.5)/1000 << ", p99 " << Percentile(h,0.99)/1000 << ", max " << h.max/1000 << "\n";
+ }
+ if (keep && (events.size()>=MaxTraceEvents))
+  out << "  Only the first " << MaxTraceEvents << " measures have been kept for the trace.\n";
+ SDL_UnlockMutex(lock);
+}
+
+bool Profiler::WriteTraceEvents(const std::string &fn)
+{
+ std::ofstream f(fn.c_str());
+ if (!f.is_open())
+  return false;
+
+ SDL_LockMutex(lock);
+ // Complete events ("X"), with times in microseconds since the profiler was created
+ f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+ char line[256];
+ for (size_t i=0;i<events.size();i++)
+ {
+  const Event &e=events[i];
+  Uint64 start=(e.start>origin) ? e.start-origin : 0;
+  snprintf(line,sizeof(line),"{\"name\":\"%s\",\"cat\":\"vbb\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+           ProbeNames[e.probe],e.thread,double(start)/1000.0,double(e.duration)/1000.0,(i+1<events.size()) ? "," : "");
+  f << line;
+ }
+ f << "]}\n";
+ SDL_UnlockMutex(lock);
+ f.close();
+ return !f.fail();
+}
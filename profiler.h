@@ -0,0 +1,156 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include "inputqueue.h"
+
+/*! \brief Class to measure how long the main operations of the program take
+ *
+ * Each measure (a probe) is kept in a histogram of logarithmic buckets (eight per power of two, so that any
+ * percentile is known within 12%), from which the median, the 99th percentile and the maximum are written at exit.
+ * Optionally, every single measure is also kept, to be written as a trace in the Chrome trace-event format
+ * (which can be opened with chrome://tracing or Perfetto), where the work of each thread is seen along the time.
+ *
+ * The profiler is only created if the configuration asks for it. Objects that are measured keep a pointer to
+ * it, which is nullptr otherwise, so that measuring costs a comparison when it is off.
+ *
+ * Measures can be recorded from any thread.
+*/
+class Profiler
+{
+ public:
+    /**
+     * The operations that are measured
+     *
+     * EventHandling: the processing of an input event by the main loop
+     *
+     * PenToScreen: from the moment a pen movement is read to the moment its line has been presented
+     *
+     * SlideChange: a Next, Previous or other slide command, from the event to the slide on the screen
+     *
+     * PageRender: the rendering of a page by poppler and its conversion to a SDL surface, in whichever thread
+     *
+     * Show: the copy of a slide to the canvas
+     *
+     * Merge: the merge of the traces over the slide
+     *
+     * Update: the presentation of the drawing area or of the whole canvas
+     *
+     * Save: the writing of a blackboard to a file
+     */
+    enum Probes { EventHandling, PenToScreen, SlideChange, PageRender, Show, Merge, Update, Save, NumProbes };
+
+    /**
+     * Maximum number of measures kept for the trace. Those beyond it are only counted in the histograms.
+     */
+    static const size_t MaxTraceEvents = 1000000;
+
+    /**
+     * Constructor
+     * \param keep_events true to keep every measure, so that a trace can be written
+     */
+    Profiler(bool keep_events);
+
+    /**
+     * Destructor
+     */
+    ~Profiler();
+
+    /**
+     * Records a measure
+     * \param p The probe
+     * \param start When the operation started, as given by InputQueue::Now
+     * \param end When the operation ended, as given by InputQueue::Now
+     */
+    void Record(Probes p,Uint64 start,Uint64 end);
+
+    /**
+     * Writes, for each probe with measures, their number, mean, median, 99th percentile and maximum
+     * \param out The stream
+     */
+    void PrintStatistics(std::ostream &out);
+
+    /**
+     * Writes the kept measures as a trace in the Chrome trace-event format
+     * \param fn Name of the file
+     * \return true if the file has been written, false on error
+     */
+    bool WriteTraceEvents(const std::string &fn);
+
+ private:
+    static const int SubBuckets = 8;
+    static const int NumBuckets = 62*SubBuckets;
+
+    struct Histogram
+    {
+     Uint64 count;
+     Uint64 sum;
+     Uint64 max;
+     Uint64 buckets[NumBuckets];
+    };
+
+    struct Event
+    {
+     Uint64 start;
+     Uint64 duration;
+     Uint32 thread;
+     Probes probe;
+    };
+
+    // Bucket of a duration in ns, and the largest duration that falls in a bucket
+    static int Bucket(Uint64 ns);
+    static Uint64 BucketLimit(int b);
+    Uint64 Percentile(const Histogram &h,double q);
+
+    SDL_mutex *lock;
+    Histogram hist[NumProbes];
+    bool keep;
+    std::vector<Event> events;
+    Uint64 origin;
+};
+
+/*! \brief Measures the time of the scope in which it is declared
+ *
+ * It does nothing if the profiler is nullptr.
+*/
+class ScopedTimer
+{
+ public:
+    /**
+     * Constructor. The measure starts.
+     * \param p The profiler, or nullptr
+     * \param pr The probe
+     */
+    ScopedTimer(Profiler *p,Profiler::Probes pr) : prof(p), probe(pr), start((p!=nullptr) ? InputQueue::Now() : 0) {};
+
+    /**
+     * Destructor. The measure ends and is recorded.
+     */
+    ~ScopedTimer() { if (prof!=nullptr) prof->Record(probe,start,InputQueue::Now()); };
+
+ private:
+    Profiler *prof;
+    Profiler::Probes probe;
+    Uint64 start;
+};
+
+#endif
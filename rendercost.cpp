@@ -0,0 +1,140 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "rendercost.h"
+#include "cachefile.h"
+
+RenderCosts::RenderCosts(Config &cfg,Uint64 hash,int npages,int w,int h)
+{
+ enabled=(cfg.GetSaveSession() && (npages>0));
+ pdf_hash=hash;
+ width=w;
+ height=h;
+ costs.assign(npages,0);
+ changed=false;
+ lock=SDL_CreateMutex();
+ if (lock==nullptr)
+ {
+  std::cerr << "Error creating the synchronization object of the rendering times. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+
+ if (enabled)
+ {
+  dir=cfg.GetCacheDir();
+  SetFileName();
+  Load();
+ }
+}
+
+RenderCosts::~RenderCosts()
+{
+ SDL_DestroyMutex(lock);
+}
+
+void RenderCosts::SetFileName(void)
+{
+ // The size is part of the name, as in the session files
+ char n[64];
+ snprintf(n,sizeof(n),"%016llx_%dx%d",(unsigned long long)pdf_hash,width,height);
+ fname=dir+std::string(n)+CostExtension;
+}
+
+void RenderCosts::Load(void)
+{
+ std::ifstream f(fname.c_str(),std::ios::binary);
+ if (!f.is_open())
+  return;
+ Header h;
+ std::vector<Uint32> c(costs.size());
+ bool valid=(f.read(reinterpret_cast<char *>(&h),sizeof(Header)) &&
+             (h.magic==CostMagic) && (h.version==CostVersion) && (h.pdf_hash==pdf_hash) && (h.pages==costs.size()) &&
+             (int(h.width)==width) && (int(h.height)==height) &&
+             f.read(reinterpret_cast<char *>(c.data()),std::streamsize(c.size()*sizeof(Uint32))));
+ if (!valid)
+ {
+  std::cerr << "Warning: rendering times file " << fname << " is not valid for this document and screen. It will be ignored and overwritten.\n";
+  return;
+ }
+ costs.swap(c);
+}
+
+void RenderCosts::Record(int page,Uint64 ns)
+{
+ Uint64 t=ns/1000;
+ Uint32 us=(t>0xFFFFFFFFULL) ? 0xFFFFFFFFU : (t==0) ? 1 : Uint32(t);
+ SDL_LockMutex(lock);
+ if ((page>=0) && (page<int(costs.size())))
+ {
+  // Three quarters of the former time and one of the new one
+  Uint32 &c=costs[page];
+  Uint32 n=(c==0) ? us : Uint32((3*Uint64(c)+Uint64(us))/4);
+  if (n!=c)
+  {
+   c=n;
+   changed=true;
+  }
+ }
+ SDL_UnlockMutex(lock);
+}
+
+Uint32 RenderCosts::Get(int page)
+{
+ SDL_LockMutex(lock);
+ Uint32 c=((page>=0) && (page<int(costs.size()))) ? costs[page] : 0;
+ SDL_UnlockMutex(lock);
+ return c;
+}
+
+void RenderCosts::Reload(Uint64 hash,const std::vector<bool> &changed_pages)
+{
+ SDL_LockMutex(lock);
+ costs.resize(changed_pages.size(),0);
+ for (size_t i=0;i<costs.size();i++)
+  if (changed_pages[i])
+   costs[i]=0;
+ pdf_hash=hash;
+ if (enabled)
+  SetFileName();
+ // The times that are still valid go to the file of the new content
+ changed=true;
+ SDL_UnlockMutex(lock);
+}
+
+void RenderCosts::Save(void)
+{
+ if (!enabled || !changed)
+  return;
+
+ Header h;
+ h.magic=CostMagic;
+ h.version=CostVersion;
+ h.pdf_hash=pdf_hash;
+ h.pages=Uint32(costs.size());
+ h.width=width;
+ h.height=height;
+ h.reserved=0;
+
+ bool ok=CacheFile::Write(dir,fname,"rendering times file","Rendering times",[&](std::ofstream &f)
+ {
+  f.write(reinterpret_cast<const char *>(&h),sizeof(Header));
+  f.write(reinterpret_cast<const char *>(costs.data()),std::streamsize(costs.size()*sizeof(Uint32)));
+ });
+ if (ok)
+  changed=false;
+}
@@ -0,0 +1,126 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef RENDERCOST_H
+#define RENDERCOST_H
+
+#include "config.h"
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_mutex.h>
+
+/*! \brief Class to keep how long each page of a document takes to be rendered, between executions
+ *
+ * Some pages (for instance, those with large images) take much longer to render than the others. The time of each page is
+ * measured whenever it is rendered to be shown, and kept (smoothed, so that a slow moment of the machine does not count too
+ * much), so that the rendering in advance can start earlier with the expensive pages and the cache can keep them longer.
+ *
+ * If sessions are kept, the times are stored in a small file beside the session file, whose name is built from the hash of
+ * the content of the PDF file and from the size at which pages are rendered, since the time depends on both. The file is read
+ * whole when the object is constructed, and written at the end of the program if any time has changed.
+*/
+class RenderCosts
+{
+ public:
+    /**
+     * Extension of the files of rendering times
+     */
+    static constexpr const char* CostExtension = ".cost";
+
+    /**
+     * Pages that take at least this to render, in microseconds, are expensive
+     */
+    static const Uint32 ExpensiveRender = 100000;
+
+    /**
+     * Constructor. If the configuration asks for saving sessions and there is a document, it reads its file of rendering times, if it exists.
+     * \param cfg The configuration object (to know if sessions are used and where they are stored)
+     * \param hash The hash of the content of the PDF file, or 0 if there is no document
+     * \param npages The number of pages of the document
+     * \param w The width of the box where the pages are rendered
+     * \param h The height of the box where the pages are rendered
+     */
+    RenderCosts(Config &cfg,Uint64 hash,int npages,int w,int h);
+
+    /**
+     * Destructor. It does not save anything; Save must be called explicitly for that.
+     */
+    ~RenderCosts();
+
+    /**
+     * Takes the time of a rendering of a page. It can be called from the workers of the scheduler.
+     * \param page The page number, starting from 0
+     * \param ns The time, in nanoseconds
+     */
+    void Record(int page,Uint64 ns);
+
+    /**
+     * Gets the time that a page takes to be rendered. It can be called from the workers of the scheduler.
+     * \param page The page number, starting from 0
+     * \return Microseconds, or 0 if the page has never been rendered
+     */
+    Uint32 Get(int page);
+
+    /**
+     * Tells if a page is expensive to render
+     * \param page The page number, starting from 0
+     * \return true if it takes at least ExpensiveRender
+     */
+    bool Expensive(int page) { return (Get(page)>=ExpensiveRender); };
+
+    /**
+     * Follows the document once it has been reloaded: the times of the pages that have changed are forgotten, and the others are kept
+     * \param hash The hash of the new content of the PDF file
+     * \param changed_pages For each page of the new document, true if it has changed
+     */
+    void Reload(Uint64 hash,const std::vector<bool> &changed_pages);
+
+    /**
+     * Writes the file of rendering times, if sessions are kept and any time has changed. To be called once the scheduler is stopped.
+     */
+    void Save(void);
+
+ private:
+    static const Uint32 CostMagic = 0x43424256;   // "VBBC" read as little-endian
+    static const Uint32 CostVersion = 1;
+
+    struct Header
+    {
+     Uint32 magic;
+     Uint32 version;
+     Uint64 pdf_hash;
+     Uint32 pages;
+     Uint32 width;
+     Uint32 height;
+     Uint32 reserved;
+    };
+
+    void SetFileName(void);
+    void Load(void);
+
+    bool enabled;
+    std::string dir,fname;
+    Uint64 pdf_hash;
+    int width,height;
+
+    // Microseconds per page (0 if unknown), protected by lock
+    SDL_mutex *lock;
+    std::vector<Uint32> costs;
+    bool changed;
+};
+
+#endif
@@ -0,0 +1,268 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "scheduler.h"
+
+#include <unistd.h>
+#include <time.h>
+
+static Uint64 Microseconds(void)
+{
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC,&ts);
+ return Uint64(ts.tv_sec)*1000000ULL+Uint64(ts.tv_nsec)/1000ULL;
+}
+
+Scheduler::Scheduler(int nworkers)
+{
+ if (nworkers<=0)
+ {
+  nworkers=int(sysconf(_SC_NPROCESSORS_ONLN))-1;
+  if (nworkers<1)
+   nworkers=1;
+  if (nworkers>MaxWorkers)
+   nworkers=MaxWorkers;
+ }
+
+ next=0;
+ pending=0;
+ stopping=false;
+ for (int p=0;p<NumPriorities;p++)
+ {
+  stats[p].submitted=stats[p].done=stats[p].cancelled=0;
+  stats[p].wait_sum=stats[p].wait_max=0;
+  stats[p].run_sum=stats[p].run_max=0;
+  stats[p].max_depth=0;
+ }
+
+ idle_lock=SDL_CreateMutex();
+ idle_cond=SDL_CreateCond();
+ main_lock=SDL_CreateMutex();
+ stats_lock=SDL_CreateMutex();
+ if ((idle_lock==nullptr) || (idle_cond==nullptr) || (main_lock==nullptr) || (stats_lock==nullptr))
+ {
+  std::cerr << "Error creating the synchronization objects of the scheduler. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+
+ // All workers must exist before any of them starts stealing from the others
+ for (int i=0;i<nworkers;i++)
+ {
+  Worker *w=new Worker;
+  w->sched=this;
+  w->id=i;
+  w->thread=nullptr;
+  if ((w->lock=SDL_CreateMutex())==nullptr)
+  {
+   std::cerr << "Error creating the synchronization objects of the scheduler. Exiting.\n";
+   SDL_Quit();
+   exit(1);
+  }
+  workers.push_back(w);
+ }
+ for (int i=0;i<nworkers;i++)
+  if ((workers[i]->thread=SDL_CreateThread(Run,workers[i]))==nullptr)
+  {
+   std::cerr << "Error creating the worker threads of the scheduler. Exiting.\n";
+   SDL_Quit();
+   exit(1);
+  }
+}
+
+Scheduler::~Scheduler()
+{
+ Stop();
+ for (unsigned int i=0;i<workers.size();i++)
+ {
+  SDL_DestroyMutex(workers[i]->lock);
+  delete workers[i];
+ }
+ SDL_DestroyMutex(stats_lock);
+ SDL_DestroyMutex(main_lock);
+ SDL_DestroyCond(idle_cond);
+ SDL_DestroyMutex(idle_lock);
+}
+
+void Scheduler::Stop(void)
+{
+ if (stopping)
+  return;
+ SDL_LockMutex(idle_lock);
+ stopping=true;
+ SDL_CondBroadcast(idle_cond);
+ SDL_UnlockMutex(idle_lock);
+ for (unsigned int i=0;i<workers.size();i++)
+  if (workers[i]->thread!=nullptr)
+  {
+   SDL_WaitThread(workers[i]->thread,nullptr);
+   workers[i]->thread=nullptr;
+  }
+}
+
+void Scheduler::Submit(Priority p,const CancelToken &t,Job j)
+{
+ if (stopping)
+  return;
+
+ Entry e;
+ e.job=j;
+ e.token=t;
+ e.submitted=Microseconds();
+
+ Worker *w=workers[next++ % workers.size()];
+ SDL_LockMutex(w->lock);
+ w->queue[p].push_back(e);
+ SDL_UnlockMutex(w->lock);
+
+ int d=++pending;
+ SDL_LockMutex(stats_lock);
+ stats[p].submitted++;
+ if (d>stats[p].max_depth)
+  stats[p].max_depth=d;
+ SDL_UnlockMutex(stats_lock);
+
+ // Any idle worker can run it: the one that has it in its queue or another one by stealing it
+ SDL_LockMutex(idle_lock);
+ SDL_CondSignal(idle_cond);
+ SDL_UnlockMutex(idle_lock);
+}
+
+bool Scheduler::Take(int id,Entry &e,Priority &p)
+{
+ int n=workers.size();
+ for (int pr=0;pr<NumPriorities;pr++)
+  // The worker's own queue first, from the front (oldest first)...
+  for (int k=0;k<n;k++)
+  {
+   Worker *w=workers[(id+k)%n];
+   SDL_LockMutex(w->lock);
+   std::deque<Entry> &q=w->queue[pr];
+   if (!q.empty())
+   {
+    // ... and then the queues of the others, from the back (so that the owner and the thief do not fight for the same jobs)
+    if (k==0)
+    {
+     e=q.front();
+     q.pop_front();
+    }
+    else
+    {
+     e=q.back();
+     q.pop_back();
+    }
+    SDL_UnlockMutex(w->lock);
+    pending--;
+    p=Priority(pr);
+    return true;
+   }
+   SDL_UnlockMutex(w->lock);
+  }
+ return false;
+}
+
+void Scheduler::Execute(Entry &e,Priority p)
+{
+ Uint64 start=Microseconds();
+ bool cancelled=e.token.Cancelled();
+ if (!cancelled)
+  e.job(e.token);
+ Uint64 end=Microseconds();
+
+ SDL_LockMutex(stats_lock);
+ Stats &s=stats[p];
+ if (cancelled)
+  s.cancelled++;
+ else
+ {
+  s.done++;
+  Uint64 w=start-e.submitted;
+  Uint64 r=end-start;
+  s.wait_sum+=w;
+  s.run_sum+=r;
+  if (w>s.wait_max)
+   s.wait_max=w;
+  if (r>s.run_max)
+   s.run_max=r;
+ }
+ SDL_UnlockMutex(stats_lock);
+}
+
+int Scheduler::Run(void *data)
+{
+ Worker *w=static_cast<Worker *>(data);
+ Scheduler *s=w->sched;
+ Entry e;
+ Priority p;
+ while (true)
+ {
+  if (s->Take(w->id,e,p))
+  {
+   s->Execute(e,p);
+   // The job (and what it keeps) is released now, not when the next one arrives
+   e.job=nullptr;
+   continue;
+  }
+  // Workers only leave when there is nothing left to do, so that no save is lost when the program ends
+  if (s->stopping)
+   break;
+  SDL_LockMutex(s->idle_lock);
+  while ((s->pending==0) && !s->stopping)
+   SDL_CondWait(s->idle_cond,s->idle_lock);
+  SDL_UnlockMutex(s->idle_lock);
+ }
+ return 0;
+}
+
+void Scheduler::PostToMain(std::function<void()> task)
+{
+ SDL_LockMutex(main_lock);
+ main_tasks.push_back(task);
+ SDL_UnlockMutex(main_lock);
+ if (wakeup)
+  wakeup();
+}
+
+void Scheduler::RunMainTasks(void)
+{
+ std::deque< std::function<void()> > tasks;
+ SDL_LockMutex(main_lock);
+ tasks.swap(main_tasks);
+ SDL_UnlockMutex(main_lock);
+ for (unsigned int i=0;i<tasks.size();i++)
+  tasks[i]();
+}
+
+void Scheduler::PrintStatistics(std::ostream &out)
+{
+ static const char *names[NumPriorities]={ "visible slide", "refinement", "prefetch", "thumbnail", "export" };
+ SDL_LockMutex(stats_lock);
+ out << "Scheduler: " << workers.size() << " workers\n";
+ for (int p=0;p<NumPriorities;p++)
+ {
+  Stats &s=stats[p];
+  if (s.submitted==0)
+   continue;
+  out << "  " << names[p] << ": " << s.submitted << " submitted, " << s.done << " done, " << s.cancelled << " cancelled, "
+      << "max queue depth " << s.max_depth;
+  if (s.done>0)
+   out << ", wait mean " << s.wait_sum/s.done << " us max " << s.wait_max << " us"
+       << ", run mean " << s.run_sum/s.done << " us max " << s.run_max << " us";
+  out << "\n";
+ }
+ SDL_UnlockMutex(stats_lock);
+}
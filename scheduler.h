@@ -0,0 +1,198 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <iostream>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include <SDL/SDL_mutex.h>
+
+/*! \brief A mark shared by a group of jobs, that allows to cancel all of them at once
+ *
+ * Copies of a token share the same mark. Jobs whose token has been cancelled before they start are
+ * never run; long jobs should check Cancelled from time to time and return as soon as it is true.
+*/
+class CancelToken
+{
+ public:
+    /**
+     * Constructor. The new token is not cancelled.
+     */
+    CancelToken() : flag(std::make_shared< std::atomic<bool> >(false)) {};
+
+    /**
+     * Cancels all the jobs that share this token
+     */
+    void Cancel(void) { *flag=true; };
+
+    /**
+     * \return true if the token has been cancelled
+     */
+    bool Cancelled(void) const { return *flag; };
+
+ private:
+    std::shared_ptr< std::atomic<bool> > flag;
+};
+
+/*! \brief A pool of threads that runs the background work of the program by order of priority
+ *
+ * Each worker thread has a queue of jobs per priority. Jobs are submitted to the workers in turn and
+ * each worker runs first the jobs of its own queues, but before running a job of lower priority it
+ * steals (from the other end of the queue) any job of higher priority waiting in the queues of other
+ * workers. So no worker is idle while there is work, and work is always done in order of priority.
+ *
+ * Jobs must not touch the screen nor the canvas. What has to be done in the main thread when a job
+ * ends (for instance, showing a message) is posted with PostToMain and run by the main loop with
+ * RunMainTasks. PostToMain wakes the main loop up if it is waiting for events.
+ *
+ * The number of jobs submitted, done and cancelled, the maximum depth of the queues and the time that
+ * jobs of each priority wait before starting and take to run are kept to tune the program.
+*/
+class Scheduler
+{
+ public:
+    /**
+     * The classes of jobs, from the most to the least urgent
+     *
+     * VisibleSlide: rendering of the slide that has to be shown now
+     *
+     * Refinement: work to improve what is already shown (like a better rendering of the visible slide)
+     *
+     * Prefetch: rendering of slides that will probably be shown soon (the neighbours of the visible one)
+     *
+     * Thumbnail: rendering of small images of the slides
+     *
+     * Export: writing of images and files to disk
+     */
+    enum Priority { VisibleSlide, Refinement, Prefetch, Thumbnail, Export, NumPriorities };
+
+    /**
+     * A job receives its own token, so it can check if it has been cancelled while running
+     */
+    typedef std::function<void(const CancelToken &)> Job;
+
+    /**
+     * Maximum number of worker threads
+     */
+    static const int MaxWorkers = 4;
+
+    /**
+     * Constructor. It starts the workers.
+     * \param nworkers Number of worker threads. 0 to use one less than the number of processors (but at least one and no more than MaxWorkers).
+     */
+    Scheduler(int nworkers=0);
+
+    /**
+     * Destructor. It stops the workers, if they were not already stopped.
+     */
+    ~Scheduler();
+
+    /**
+     * Sets the function that wakes the main loop up when a task is posted to it
+     * \param w The function. It will be called from the worker threads.
+     */
+    void SetWakeup(std::function<void()> w) { wakeup=w; };
+
+    /**
+     * Submits a job
+     * \param p Priority class of the job
+     * \param t Cancellation token of the job
+     * \param j The job
+     */
+    void Submit(Priority p,const CancelToken &t,Job j);
+
+    /**
+     * Asks the main thread to run a task. To be called from the jobs.
+     * \param task The task
+     */
+    void PostToMain(std::function<void()> task);
+
+    /**
+     * Runs the tasks posted to the main thread. To be called only by the main thread.
+     */
+    void RunMainTasks(void);
+
+    /**
+     * Gets the number of jobs waiting to be run
+     * \return The number of jobs in all the queues
+     */
+    int Depth(void) { return pending; };
+
+    /**
+     * Stops the workers, once they have run all the jobs submitted (those cancelled are discarded without running them).
+     * No job can be submitted after this call and tasks posted to the main thread are no longer run.
+     */
+    void Stop(void);
+
+    /**
+     * Writes the statistics of each priority class
+     * \param out The stream to write to
+     */
+    void PrintStatistics(std::ostream &out);
+
+ private:
+    struct Entry
+    {
+     Job job;
+     CancelToken token;
+     Uint64 submitted;       // Microseconds of the monotonic clock
+    };
+
+    struct Worker
+    {
+     Scheduler *sched;
+     int id;
+     SDL_Thread *thread;
+     SDL_mutex *lock;
+     std::deque<Entry> queue[NumPriorities];
+    };
+
+    struct Stats
+    {
+     Uint32 submitted,done,cancelled;
+     Uint64 wait_sum,wait_max;     // Microseconds
+     Uint64 run_sum,run_max;
+     int max_depth;
+    };
+
+    static int Run(void *data);
+    bool Take(int id,Entry &e,Priority &p);
+    void Execute(Entry &e,Priority p);
+
+    std::vector<Worker *> workers;
+    std::atomic<unsigned int> next;
+    std::atomic<int> pending;
+    std::atomic<bool> stopping;
+    SDL_mutex *idle_lock;
+    SDL_cond *idle_cond;
+
+    SDL_mutex *main_lock;
+    std::deque< std::function<void()> > main_tasks;
+    std::function<void()> wakeup;
+
+    SDL_mutex *stats_lock;
+    Stats stats[NumPriorities];
+};
+
+#endif
@@ -0,0 +1,321 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "search.h"
+
+#include <algorithm>
+
+SlideSearch::SlideSearch(Config &cfg,PDFSlides &sld,Scheduler &sc) : slides(sld),scheduler(sc)
+{
+ for (int i=0;i<Config::NumSearchMessages;i++)
+  messages.push_back(cfg.GetSearchMessage(Config::SearchMessages(i)));
+ pages=sld.GetNumPages();
+ indexed=0;
+ active=false;
+ canvas=nullptr;
+ chosen=0;
+ lock=SDL_CreateMutex();
+ if (lock==nullptr)
+ {
+  std::cerr << "Error creating the synchronization object of the search index. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+
+ done.assign(pages,false);
+ for (int i=0;i<pages;i++)
+  Submit(i);
+}
+
+SlideSearch::~SlideSearch()
+{
+ SDL_DestroyMutex(lock);
+}
+
+void SlideSearch::Submit(int page)
+{
+ scheduler.Submit(Scheduler::Thumbnail,token,[this,page](const CancelToken &t)
+ {
+  if (t.Cancelled())
+   return;
+  IndexPage(page,t);
+  scheduler.PostToMain([this]() { Indexed(); });
+ });
+}
+
+void SlideSearch::Words(const std::string &t,std::vector<std::string> &w)
+{
+ std::string cur;
+ for (size_t i=0;i<=t.size();i++)
+ {
+  unsigned char b=(i<t.size()) ? (unsigned char)t[i] : ' ';
+  if ((b>='A') && (b<='Z'))
+   cur.push_back(char(b-'A'+'a'));
+  else if (((b>='a') && (b<='z')) || ((b>='0') && (b<='9')))
+   cur.push_back(char(b));
+  else if (b>=0x80)
+  {
+   // Capital Latin-1 letters (but the multiplication sign) are C3 80 to C3 9E in UTF-8, and their small ones are 0x20 further
+   if ((b==0xC3) && (i+1<t.size()) && ((unsigned char)t[i+1]>=0x80) && ((unsigned char)t[i+1]<=0x9E) && ((unsigned char)t[i+1]!=0x97))
+   {
+    cur.push_back(char(b));
+    cur.push_back(char((unsigned char)t[++i]+0x20));
+   }
+   else
+    cur.push_back(char(b));
+  }
+  else if (!cur.empty())
+  {
+   w.push_back(cur);
+   cur.clear();
+  }
+ }
+}
+
+void SlideSearch::IndexPage(int page,const CancelToken &tk)
+{
+ std::vector<std::string> w;
+ Words(slides.GetPageText(page),w);
+ std::sort(w.begin(),w.end());
+ w.erase(std::unique(w.begin(),w.end()),w.end());
+
+ SDL_LockMutex(lock);
+ // If the document has been reloaded meanwhile, the text may be of the former one
+ if (!tk.Cancelled() && !done[page])
+ {
+  for (size_t i=0;i<w.size();i++)
+  {
+   // Pages are indexed by several workers, so they do not arrive in order
+   std::vector<int> &p=index[w[i]];
+   p.insert(std::lower_bound(p.begin(),p.end(),page),page);
+  }
+  done[page]=true;
+  indexed++;
+ }
+ SDL_UnlockMutex(lock);
+}
+
+void SlideSearch::Query(const std::string &q,std::vector<int> &res)
+{
+ res.clear();
+ std::vector<std::string> w;
+ Words(q,w);
+ if (w.empty())
+  return;
+
+ std::vector<char> in(pages,1);
+ std::vector<char> word(pages);
+ SDL_LockMutex(lock);
+ for (size_t k=0;k<w.size();k++)
+ {
+  std::fill(word.begin(),word.end(),0);
+  // The words of the index that start with this one are together in the map
+  for (std::map< std::string,std::vector<int> >::const_iterator it=index.lower_bound(w[k]);
+       (it!=index.end()) && (it->first.compare(0,w[k].size(),w[k])==0);++it)
+   for (size_t i=0;i<it->second.size();i++)
+    word[it->second[i]]=1;
+  for (int i=0;i<pages;i++)
+   in[i]&=word[i];
+ }
+ SDL_UnlockMutex(lock);
+ for (int i=0;i<pages;i++)
+  if (in[i])
+   res.push_back(i);
+}
+
+void SlideSearch::Reload(const std::vector<bool> &changed)
+{
+ SDL_LockMutex(lock);
+ token.Cancel();
+ token=CancelToken();
+ pages=int(changed.size());
+ // The pages that have changed, or no longer exist, leave the index
+ std::map< std::string,std::vector<int> >::iterator it=index.begin();
+ while (it!=index.end())
+ {
+  std::vector<int> &p=it->second;
+  size_t k=0;
+  for (size_t i=0;i<p.size();i++)
+   if ((p[i]<pages) && !changed[p[i]])
+    p[k++]=p[i];
+  p.resize(k);
+  if (p.empty())
+   index.erase(it++);
+  else
+   ++it;
+ }
+ done.resize(pages,false);
+ std::vector<int> missing;
+ for (int i=0;i<pages;i++)
+ {
+  if (changed[i])
+   done[i]=false;
+  if (!done[i])
+   missing.push_back(i);
+ }
+ indexed=pages-int(missing.size());
+ SDL_UnlockMutex(lock);
+
+ for (size_t i=0;i<missing.size();i++)
+  Submit(missing[i]);
+ if (active && (canvas!=nullptr))
+ {
+  Update();
+  Draw(*canvas);
+ }
+}
+
+void SlideSearch::Open(Canvas &cnv)
+{
+ if (pages==0)
+  return;
+ active=true;
+ canvas=&cnv;
+ query.clear();
+ found.clear();
+ chosen=0;
+ // The query needs the characters, not only the keys
+ SDL_EnableUNICODE(1);
+ Draw(cnv);
+}
+
+void SlideSearch::Close(Canvas &cnv)
+{
+ active=false;
+ SDL_EnableUNICODE(0);
+ if (!cnv.HudActive())
+  cnv.RedrawMenu();
+}
+
+void SlideSearch::Update(void)
+{
+ Query(query,found);
+ // The first slide found from the current one on is chosen
+ int cur=slides.GetCurrentPage();
+ chosen=int(std::lower_bound(found.begin(),found.end(),cur)-found.begin());
+ if (chosen>=int(found.size()))
+  chosen=0;
+}
+
+int SlideSearch::Key(const SDL_keysym &k,Canvas &cnv)
+{
+ switch (k.sym)
+ {
+  case SDLK_ESCAPE:
+        Close(cnv);
+        return -1;
+  case SDLK_RETURN:
+  case SDLK_KP_ENTER:
+        Close(cnv);
+        return (found.empty()) ? -1 : found[chosen];
+  case SDLK_DOWN:
+  case SDLK_RIGHT:
+        if (found.empty())
+         return -1;
+        chosen=(chosen+1)%int(found.size());
+        Draw(cnv);
+        return found[chosen];
+  case SDLK_UP:
+  case SDLK_LEFT:
+        if (found.empty())
+         return -1;
+        chosen=(chosen+int(found.size())-1)%int(found.size());
+        Draw(cnv);
+        return found[chosen];
+  case SDLK_BACKSPACE:
+        // The last character, with all its bytes
+        while (!query.empty() && (((unsigned char)query[query.size()-1] & 0xC0)==0x80))
+         query.erase(query.size()-1);
+        if (!query.empty())
+         query.erase(query.size()-1);
+        break;
+  default:
+        {
+         Uint16 u=k.unicode;
+         if ((u<32) || (u==127) || (query.size()+3>MaxQuery))
+          return -1;
+         if (u<0x80)
+          query.push_back(char(u));
+         else if (u<0x800)
+         {
+          query.push_back(char(0xC0 | (u>>6)));
+          query.push_back(char(0x80 | (u & 0x3F)));
+         }
+         else
+         {
+          query.push_back(char(0xE0 | (u>>12)));
+          query.push_back(char(0x80 | ((u>>6) & 0x3F)));
+          query.push_back(char(0x80 | (u & 0x3F)));
+         }
+        }
+        break;
+ }
+ Update();
+ Draw(cnv);
+ return -1;
+}
+
+void SlideSearch::Indexed(void)
+{
+ // The slides found may grow while the index is built
+ if (!active || (canvas==nullptr) || canvas->OverlayActive())
+  return;
+ int page=(found.empty()) ? -1 : found[chosen];
+ Update();
+ std::vector<int>::iterator it=std::find(found.begin(),found.end(),page);
+ if (it!=found.end())
+  chosen=int(it-found.begin());
+ Draw(*canvas);
+}
+
+void SlideSearch::Draw(Canvas &cnv)
+{
+ std::string s=Message(Config::SearchPrompt,query+"_")+" | ";
+ if (query.empty())
+  s+=Message(Config::SearchHint);
+ else if (found.empty())
+  s+=Message(Config::SearchNone);
+ else
+ {
+  s+=Message((found.size()==1) ? Config::SearchOne : Config::SearchMany,std::to_string(found.size()));
+  int first=std::max(0,std::min(chosen-ShownResults/2,int(found.size())-ShownResults));
+  for (int i=first;(i<first+ShownResults) && (i<int(found.size()));i++)
+   s+=(i==chosen) ? " ["+std::to_string(found[i]+1)+"]" : " "+std::to_string(found[i]+1);
+ }
+ if (indexed<pages)
+  s+=" | "+Message(Config::SearchIndexed,std::to_string(int(indexed))+"/"+std::to_string(pages));
+ cnv.DrawHud(s);
+}
+
+std::string SlideSearch::Message(Config::SearchMessages m,const std::string &v)
+{
+ std::string s=messages[m];
+ size_t pos=s.find("%s");
+ if (pos!=std::string::npos)
+  s.replace(pos,2,v);
+ return s;
+}
+
+Uint64 SlideSearch::MemoryUse(void)
+{
+ Uint64 m=0;
+ SDL_LockMutex(lock);
+ for (std::map< std::string,std::vector<int> >::const_iterator it=index.begin();it!=index.end();++it)
+  m+=it->first.capacity()+it->second.capacity()*sizeof(int);
+ SDL_UnlockMutex(lock);
+ return m;
+}
@@ -0,0 +1,152 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "canvas.h"
+#include "pdfslides.h"
+
+/*! \brief Class to find the slides that contain some words, as they are typed
+ *
+ * The text of each page is extracted once, by the workers of the scheduler (one job per page, with the priority of the
+ * thumbnails, and with a document of its own, so that navigation is never blocked by it), and its words
+ * go to an inverted index: for each word, the sorted list of the pages that contain it. A query is answered with the index
+ * alone: every word of the query is taken as the beginning of a word of the slides (so that results appear while typing),
+ * the pages of all the words of the index that start with it are joined, and the pages of the different words are
+ * intersected. Words are compared without case (only for ASCII and Latin-1 letters).
+ *
+ * While searching, the query, the slides found and how much of the document is indexed are shown in the menu bar. The keys
+ * are the text of the query, except the arrows, which go to the next or former slide found, Enter, which goes to the one
+ * chosen and ends the search, and Escape, which ends it on the current slide.
+*/
+class SlideSearch
+{
+ public:
+    /**
+     * Maximum length of the query, in bytes
+     */
+    static const size_t MaxQuery = 64;
+
+    /**
+     * Number of slides found that are listed in the menu bar, around the one chosen
+     */
+    static const int ShownResults = 8;
+
+    /**
+     * Constructor. It submits the extraction of the text of every page.
+     * \param cfg The configuration object (to know the messages of the search in the language of the menu)
+     * \param sld The slides object, which extracts the text
+     * \param sc The scheduler to which extraction is submitted
+     */
+    SlideSearch(Config &cfg,PDFSlides &sld,Scheduler &sc);
+
+    /**
+     * Destructor. The scheduler must have been stopped before, since its jobs use this object.
+     */
+    ~SlideSearch();
+
+    /**
+     * Tells if the user is searching
+     * \return true if the keys go to the query
+     */
+    bool Active(void) { return active; };
+
+    /**
+     * Starts searching, with an empty query
+     * \param cnv The canvas, whose menu bar shows the search
+     */
+    void Open(Canvas &cnv);
+
+    /**
+     * Ends the search, and shows the menu (or the HUD, when it is refreshed) again
+     * \param cnv The canvas
+     */
+    void Close(Canvas &cnv);
+
+    /**
+     * Takes a key pressed while searching
+     * \param k The key
+     * \param cnv The canvas, whose menu bar shows the search
+     * \return The slide to go to (the one chosen with the arrows or Enter), or -1 to stay in the current one
+     */
+    int Key(const SDL_keysym &k,Canvas &cnv);
+
+    /**
+     * Finds the pages that contain all the words of a text, as beginnings of their words
+     * \param q The text, in UTF-8
+     * \param pages The pages found, from 0 and in order
+     */
+    void Query(const std::string &q,std::vector<int> &pages);
+
+    /**
+     * Gets the number of pages whose text is already in the index
+     * \return Number of pages
+     */
+    int GetIndexed(void) { return indexed; };
+
+    /**
+     * Cancels the extraction that has not started yet. To be called before stopping the scheduler at the end of the program.
+     */
+    void CancelJobs(void) { token.Cancel(); };
+
+    /**
+     * Gets the memory used by the index
+     * \return Bytes (approximately, without the overhead of the map)
+     */
+    Uint64 MemoryUse(void);
+
+    /**
+     * Follows the document once it has been reloaded: the text of the slides that have changed is indexed again, and that of the others is kept
+     * \param changed For each slide of the new document, true if it has changed
+     */
+    void Reload(const std::vector<bool> &changed);
+
+ private:
+    // Splits a text in words, without case, and adds them to w
+    static void Words(const std::string &t,std::vector<std::string> &w);
+    void Submit(int page);
+    // Extracts the text of a page and puts its words in the index, unless tk has been cancelled meanwhile. Run by the workers.
+    void IndexPage(int page,const CancelToken &tk);
+    // Called in the main thread when a page has been indexed
+    void Indexed(void);
+    void Update(void);
+    void Draw(Canvas &cnv);
+    // A message of the language file with its %s replaced by a value
+    std::string Message(Config::SearchMessages m,const std::string &v=std::string());
+
+    std::vector<std::string> messages;
+    PDFSlides &slides;
+    Scheduler &scheduler;
+    CancelToken token;
+    int pages;
+
+    // The index, protected by lock
+    SDL_mutex *lock;
+    std::map< std::string,std::vector<int> > index;
+    std::vector<bool> done;
+    std::atomic<int> indexed;
+
+    // The search, only used by the main thread. The canvas is kept while searching, for the pages that are indexed meanwhile.
+    bool active;
+    Canvas *canvas;
+    std::string query;
+    std::vector<int> found;
+    int chosen;
+};
+
+#endif
@@ -0,0 +1,489 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "session.h"
+#include "cachefile.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+SessionStore::SessionStore(Config &cfg,PDFSlides &sld,Canvas &cnv,Scheduler &sched) : scheduler(sched)
+{
+ enabled=(cfg.GetSaveSession() && (sld.GetNumPages()>0));
+ mapped=nullptr;
+ map_len=0;
+ index=nullptr;
+ mapped_pages=0;
+ changed=false;
+
+ SDL_Surface *ink=cnv.GetInk();
+ pdf_hash=sld.GetFileHash();
+ pages=sld.GetNumPages();
+ width=ink->w;
+ height=ink->h;
+ bpp=ink->format->BytesPerPixel;
+ lock=SDL_CreateMutex();
+ if (lock==nullptr)
+ {
+  std::cerr << "Error creating the synchronization object of the session. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+
+ // The canvas keeps the strokes only if they are going to be stored
+ cnv.SetKeepStrokes(enabled);
+ if (!enabled)
+  return;
+
+ dir=cfg.GetCacheDir();
+ SetFileName();
+ Map();
+}
+
+void SessionStore::SetFileName(void)
+{
+ // The resolution is part of the name, so that sessions done in different screens do not overwrite each other.
+ char n[64];
+ snprintf(n,sizeof(n),"%016llx_%dx%d",(unsigned long long)pdf_hash,width,height);
+ fname=dir+std::string(n)+SessionExtension;
+}
+
+SessionStore::~SessionStore()
+{
+ Unmap();
+ SDL_DestroyMutex(lock);
+}
+
+void SessionStore::Map(void)
+{
+ if (!CacheFile::Map(fname,sizeof(Header),mapped,map_len))
+  return;
+
+ const Header *h=(const Header *)mapped;
+ bool valid=((h->magic==SessionMagic) && (h->version==SessionVersion) && (h->pdf_hash==pdf_hash) &&
+             (int(h->pages)==pages) && (int(h->width)==width) && (int(h->height)==height) && (int(h->bpp)==bpp) &&
+             (sizeof(Header)+pages*sizeof(IndexEntry)<=map_len));
+ if (valid)
+ {
+  index=(const IndexEntry *)(mapped+sizeof(Header));
+  mapped_pages=pages;
+  for (int i=0;i<pages && valid;i++)
+   valid=((index[i].offset<=map_len) && (index[i].length<=map_len-index[i].offset));
+ }
+ if (!valid)
+ {
+  std::cerr << "Warning: session file " << fname << " is not valid for this document and screen. It will be ignored and overwritten.\n";
+  Unmap();
+ }
+}
+
+void SessionStore::Unmap(void)
+{
+ CacheFile::Unmap(mapped,map_len);
+ mapped=nullptr;
+ map_len=0;
+ index=nullptr;
+ mapped_pages=0;
+}
+
+void SessionStore::Encode(SDL_Surface *s,const unsigned char *back,std::vector<unsigned char> &out)
+{
+ // The buffer is seen as a single sequence of w*h pixels. Each record is the number of background pixels to skip,
+ // the number of traced pixels that follow and then the bytes of these pixels. They are appended to out.
+ int inc=s->format->BytesPerPixel;
+ Uint32 skip=0,count=0;
+ size_t count_pos=0;
+ SDL_LockSurface(s);
+ for (int y=0;y<s->h;y++)
+ {
+  const unsigned char *p=(const unsigned char *)s->pixels+y*s->pitch;
+  for (int x=0;x<s->w;x++,p+=inc)
+  {
+   if (memcmp(p,back,inc)==0)
+   {
+    if (count>0)
+    {
+     memcpy(&out[count_pos],&count,sizeof(Uint32));
+     count=0;
+    }
+    skip++;
+   }
+   else
+   {
+    if (count==0)
+    {
+     size_t o=out.size();
+     out.resize(o+2*sizeof(Uint32));
+     memcpy(&out[o],&skip,sizeof(Uint32));
+     count_pos=o+sizeof(Uint32);
+     skip=0;
+    }
+    out.insert(out.end(),p,p+inc);
+    count++;
+   }
+  }
+ }
+ SDL_UnlockSurface(s);
+ if (count>0)
+  memcpy(&out[count_pos],&count,sizeof(Uint32));
+}
+
+void SessionStore::Decode(const unsigned char *data,Uint64 len,SDL_Surface *s)
+{
+ int inc=s->format->BytesPerPixel;
+ Uint64 total=Uint64(s->w)*Uint64(s->h);
+ Uint64 i=0,pos=0;
+ SDL_LockSurface(s);
+ while (pos+2*sizeof(Uint32)<=len)
+ {
+  Uint32 skip,count;
+  memcpy(&skip,data+pos,sizeof(Uint32));
+  memcpy(&count,data+pos+sizeof(Uint32),sizeof(Uint32));
+  pos+=2*sizeof(Uint32);
+  i+=skip;
+  if ((i+count>total) || (pos+Uint64(count)*inc>len))
+  {
+   std::cerr << "Warning: corrupted traces in session file " << fname << ". They are partially lost.\n";
+   break;
+  }
+  // A run can go on through several rows
+  while (count>0)
+  {
+   int y=int(i/s->w);
+   int x=int(i%s->w);
+   Uint32 n=Uint32(s->w-x);
+   if (n>count)
+    n=count;
+   memcpy((unsigned char *)s->pixels+y*s->pitch+x*inc,data+pos,n*inc);
+   pos+=n*inc;
+   i+=n;
+   count-=n;
+  }
+ }
+ SDL_UnlockSurface(s);
+}
+
+void SessionStore::EncodeStrokes(const std::vector<Stroke> &st,std::vector<unsigned char> &out)
+{
+ // Each stroke is its brush (color, size, offset and tool), its number of points and then the points, as 16-bit coordinates
+ auto put=[&out](const void *v,size_t n) { out.insert(out.end(),(const unsigned char *)v,(const unsigned char *)v+n); };
+ Uint32 kind=Strokes;
+ Uint32 n=Uint32(st.size());
+ put(&kind,sizeof(Uint32));
+ put(&n,sizeof(Uint32));
+ for (size_t k=0;k<st.size();k++)
+ {
+  Uint32 np=Uint32(st[k].points.size());
+  put(&st[k].color,sizeof(Uint32));
+  put(&st[k].size,sizeof(Uint16));
+  put(&st[k].offset,sizeof(Uint8));
+  put(&st[k].tool,sizeof(Uint8));
+  put(&np,sizeof(Uint32));
+  for (size_t i=0;i<st[k].points.size();i++)
+  {
+   Sint16 xy[2]={ Sint16(st[k].points[i].x),Sint16(st[k].points[i].y) };
+   put(xy,sizeof(xy));
+  }
+ }
+}
+
+bool SessionStore::DecodeStrokes(const unsigned char *data,Uint64 len,std::vector<Stroke> &st)
+{
+ const Uint64 StrokeHeader=2*sizeof(Uint32)+2*sizeof(Uint16);
+ Uint64 pos=0;
+ Uint32 n;
+ if (len<sizeof(Uint32))
+  return false;
+ memcpy(&n,data,sizeof(Uint32));
+ pos+=sizeof(Uint32);
+ for (Uint32 k=0;k<n;k++)
+ {
+  if (pos+StrokeHeader>len)
+   return false;
+  Stroke s;
+  Uint32 np;
+  memcpy(&s.color,data+pos,sizeof(Uint32));
+  memcpy(&s.size,data+pos+sizeof(Uint32),sizeof(Uint16));
+  memcpy(&s.offset,data+pos+sizeof(Uint32)+sizeof(Uint16),sizeof(Uint8));
+  memcpy(&s.tool,data+pos+sizeof(Uint32)+sizeof(Uint16)+sizeof(Uint8),sizeof(Uint8));
+  memcpy(&np,data+pos+sizeof(Uint32)+2*sizeof(Uint16),sizeof(Uint32));
+  pos+=StrokeHeader;
+  if ((pos+Uint64(np)*2*sizeof(Sint16)>len) || (s.size>width) || (s.tool>Stroke::Highlighter))
+   return false;
+  s.points.resize(np);
+  for (Uint32 i=0;i<np;i++)
+  {
+   Sint16 xy[2];
+   memcpy(xy,data+pos,sizeof(xy));
+   pos+=sizeof(xy);
+   s.points[i].x=xy[0];
+   s.points[i].y=xy[1];
+  }
+  st.push_back(s);
+ }
+ return true;
+}
+
+void SessionStore::Keep(int page,Canvas &cnv)
+{
+ if (!enabled || (page<0) || (page>=pages) || !cnv.GetInkChanged())
+  return;
+
+ Pack(cnv,kept[page]);
+ cnv.SetInkChanged(false);
+ changed=true;
+}
+
+void SessionStore::KeepPacked(int page,const std::vector<unsigned char> &data)
+{
+ if (!enabled || (page<0) || (page>=pages))
+  return;
+
+ kept[page]=data;
+ changed=true;
+}
+
+bool SessionStore::GetPacked(int page,std::vector<unsigned char> &out)
+{
+ if (!enabled || (page<0) || (page>=pages))
+  return false;
+
+ std::map< int,std::vector<unsigned char> >::const_iterator it=kept.find(page);
+ if (it!=kept.end())
+  out=it->second;
+ else if ((index!=nullptr) && (page<mapped_pages) && (index[page].length>0))
+  out.assign(mapped+index[page].offset,mapped+index[page].offset+index[page].length);
+ else
+  out.clear();
+ return true;
+}
+
+void SessionStore::Pack(Canvas &cnv,std::vector<unsigned char> &out)
+{
+ // Strokes are stored when the canvas knows them. Empty traces keep no data at all.
+ out.clear();
+ if (cnv.GetStrokesValid())
+ {
+  const std::vector<Stroke> &st=cnv.GetStrokes();
+  if (!st.empty())
+   EncodeStrokes(st,out);
+ }
+ else
+ {
+  Uint32 kind=PixelRuns;
+  out.resize(sizeof(Uint32));
+  memcpy(&out[0],&kind,sizeof(Uint32));
+  Encode(cnv.GetInk(),cnv.GetInkBackground(),out);
+  if (out.size()==sizeof(Uint32))
+   out.clear();
+ }
+}
+
+void SessionStore::Unpack(const std::vector<unsigned char> &data,Canvas &cnv)
+{
+ cnv.Erase(Canvas::Buffer);
+ if (!data.empty())
+  RestoreData(&data[0],data.size(),cnv);
+}
+
+void SessionStore::RestoreData(const unsigned char *data,Uint64 len,Canvas &cnv)
+{
+ Uint32 kind;
+ if (len<sizeof(Uint32))
+  return;
+ memcpy(&kind,data,sizeof(Uint32));
+ data+=sizeof(Uint32);
+ len-=sizeof(Uint32);
+ if (kind==Strokes)
+ {
+  std::vector<Stroke> st;
+  if (!DecodeStrokes(data,len,st))
+   std::cerr << "Warning: corrupted strokes in session file " << fname << ". They are partially lost.\n";
+  cnv.DrawStrokes(st);
+ }
+ else
+ {
+  Decode(data,len,cnv.GetInk());
+  cnv.ForgetStrokes();
+ }
+}
+
+bool SessionStore::Restore(int page,Canvas &cnv)
+{
+ if (!enabled || (page<0) || (page>=pages))
+  return false;
+
+ cnv.Erase(Canvas::Buffer);
+ cnv.SetInkChanged(false);
+
+ std::map< int,std::vector<unsigned char> >::const_iterator it=kept.find(page);
+ if (it!=kept.end())
+ {
+  if (it->second.empty())
+   return false;
+  RestoreData(&(it->second[0]),it->second.size(),cnv);
+  return true;
+ }
+
+ Prefetch(page);
+ if ((index==nullptr) || (page>=mapped_pages) || (index[page].length==0))
+  return false;
+
+ // The strokes may have been decoded in advance, while the former slide was shown
+ std::vector<Stroke> st;
+ SDL_LockMutex(lock);
+ std::map< int,std::vector<Stroke> >::iterator r=ready.find(page);
+ bool found=(r!=ready.end());
+ if (found)
+ {
+  st.swap(r->second);
+  ready.erase(r);
+ }
+ SDL_UnlockMutex(lock);
+ if (found)
+  cnv.DrawStrokes(st);
+ else
+  RestoreData(mapped+index[page].offset,index[page].length,cnv);
+ return true;
+}
+
+void SessionStore::Prefetch(int page)
+{
+ SDL_LockMutex(lock);
+ std::map< int,std::vector<Stroke> >::iterator it=ready.begin();
+ while (it!=ready.end())
+ {
+  if ((it->first<page-1) || (it->first>page+1))
+   it=ready.erase(it);
+  else
+   ++it;
+ }
+ SDL_UnlockMutex(lock);
+
+ if (index==nullptr)
+  return;
+ for (int p=page-1;p<=page+1;p+=2)
+ {
+  // Slides kept during this execution do not use the mapped file any longer
+  if ((p<0) || (p>=pages) || (p>=mapped_pages) || (index[p].length==0) || (kept.find(p)!=kept.end()))
+   continue;
+  SDL_LockMutex(lock);
+  bool wanted=((ready.find(p)==ready.end()) && (decoding.find(p)==decoding.end()));
+  if (wanted)
+   decoding.insert(p);
+  SDL_UnlockMutex(lock);
+  if (wanted)
+   scheduler.Submit(Scheduler::Prefetch,token,[this,p](const CancelToken &t) { DecodeInAdvance(p,t); });
+ }
+}
+
+void SessionStore::DecodeInAdvance(int page,const CancelToken &tk)
+{
+ const unsigned char *data=mapped+index[page].offset;
+ Uint64 len=index[page].length;
+ Uint32 kind=PixelRuns;
+ if (len>=sizeof(Uint32))
+  memcpy(&kind,data,sizeof(Uint32));
+
+ // Pixel runs are drawn straight from the file, so only their pages are read in advance. Corrupted strokes
+ // are left for Restore, which warns about them.
+ std::vector<Stroke> st;
+ bool valid=false;
+ if (kind==Strokes)
+  valid=DecodeStrokes(data+sizeof(Uint32),len-sizeof(Uint32),st);
+ else
+ {
+  uintptr_t mask=uintptr_t(sysconf(_SC_PAGESIZE))-1;
+  uintptr_t start=uintptr_t(data)&~mask;
+  madvise((void *)start,size_t(uintptr_t(data)+len-start),MADV_WILLNEED);
+ }
+
+ SDL_LockMutex(lock);
+ decoding.erase(page);
+ if (valid && !tk.Cancelled())
+  ready[page].swap(st);
+ SDL_UnlockMutex(lock);
+}
+
+void SessionStore::Reload(PDFSlides &sld)
+{
+ if (!enabled)
+  return;
+ pdf_hash=sld.GetFileHash();
+ pages=sld.GetNumPages();
+ // The slides that no longer exist lose their traces
+ kept.erase(kept.lower_bound(pages),kept.end());
+ SetFileName();
+ // The traces of the former file go to the new one at the end, even if none is drawn
+ changed=true;
+}
+
+Uint64 SessionStore::MemoryUse(void)
+{
+ Uint64 m=0;
+ for (std::map< int,std::vector<unsigned char> >::const_iterator it=kept.begin();it!=kept.end();++it)
+  m+=it->second.capacity();
+ return m;
+}
+
+void SessionStore::Save(void)
+{
+ if (!enabled || !changed)
+  return;
+
+ std::vector<IndexEntry> idx(pages);
+ Uint64 offset=sizeof(Header)+pages*sizeof(IndexEntry);
+ for (int i=0;i<pages;i++)
+ {
+  std::map< int,std::vector<unsigned char> >::const_iterator it=kept.find(i);
+  idx[i].offset=offset;
+  if (it!=kept.end())
+   idx[i].length=it->second.size();
+  else if ((index!=nullptr) && (i<mapped_pages) && (index[i].length>0))
+   idx[i].length=index[i].length;
+  else
+   idx[i].length=0;
+  offset+=idx[i].length;
+ }
+
+ Header h;
+ h.magic=SessionMagic;
+ h.version=SessionVersion;
+ h.pdf_hash=pdf_hash;
+ h.pages=pages;
+ h.width=width;
+ h.height=height;
+ h.bpp=bpp;
+
+ bool ok=CacheFile::Write(dir,fname,"session file","Session",[&](std::ofstream &f)
+ {
+  f.write(reinterpret_cast<const char *>(&h),sizeof(Header));
+  f.write(reinterpret_cast<const char *>(&idx[0]),pages*sizeof(IndexEntry));
+  for (int i=0;i<pages;i++)
+  {
+   if (idx[i].length==0)
+    continue;
+   std::map< int,std::vector<unsigned char> >::const_iterator it=kept.find(i);
+   if (it!=kept.end())
+    f.write(reinterpret_cast<const char *>(&(it->second[0])),idx[i].length);
+   else
+    f.write(reinterpret_cast<const char *>(mapped+index[i].offset),index[i].length);
+  }
+ });
+ if (ok)
+  changed=false;
+}
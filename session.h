@@ -0,0 +1,217 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef SESSION_H
+#define SESSION_H
+
+// config.h is included by canvas.h and pdfslides.h
+#include "canvas.h"
+#include "pdfslides.h"
+
+/*! \brief Class to keep the traces drawn on each slide and to store them in a session file between executions
+ *
+ * The session file lives in the cache directory and its name is built from the hash of the content of the PDF
+ * file (not of its name) and from the screen resolution, since traces are kept as they are drawn, in screen pixels.
+ *
+ * The file is memory-mapped when the SessionStore is constructed and nothing is decoded at that moment. The traces
+ * of a slide are decoded only when that slide or one of its neighbours is shown, so reopening a heavily annotated document
+ * costs the same as opening a clean one. The strokes of the neighbours are decoded by the scheduler in the background, and
+ * the pixel runs are only brought into memory, so that going to the next slide finds them ready. Traces of the slides visited during the execution are encoded in memory when the slide is
+ * left, and the whole file is rewritten only at the end of the program, and only if something has changed.
+ *
+ * The traces of a slide are stored as the strokes that drew them, simplified, when the canvas knows them (that is, when only
+ * the pen, the eraser and the highlighter have touched them since they were last erased), and redrawn when restored. Otherwise
+ * (for example, traces of a board that has been panned), they are encoded as runs of non-background pixels, since
+ * most of the buffer of traces is always background; highlights are then lost. The data of each slide starts with its kind.
+*/
+class SessionStore
+{
+ public:
+    /**
+     * Extension of the session files
+     */
+    static constexpr const char* SessionExtension = ".session";
+
+    /**
+     * Constructor. If the configuration asks for saving sessions and a PDF file has been loaded, it maps the session file of that document, if it exists.
+     * \param cfg The configuration object (to know if sessions are used and where they are stored)
+     * \param sld The slides object (to know the hash of the loaded document and its number of pages)
+     * \param cnv The canvas (to know the size and pixel format of its buffer of traces)
+     * \param sched The scheduler that decodes in advance the traces of the neighbours of the slide shown
+     */
+    SessionStore(Config &cfg,PDFSlides &sld,Canvas &cnv,Scheduler &sched);
+
+    /**
+     * Destructor. It unmaps the session file, if it was mapped. It does not save anything; Save must be called explicitly for that.
+     * The scheduler must have been stopped before, since its jobs read the mapped file.
+     */
+    ~SessionStore();
+
+    /**
+     * Tells if sessions are being kept
+     * \return true if the configuration asked for sessions and a PDF file has been loaded
+     */
+    bool Enabled(void) { return enabled; };
+
+    /**
+     * Keeps in memory the traces currently in the canvas as those of a slide, if they have changed since they were restored.
+     * \param page The slide to which the current traces belong
+     * \param cnv The canvas that contains the traces
+     */
+    void Keep(int page,Canvas &cnv);
+
+    /**
+     * Puts in the canvas the traces of a slide, erasing those it had, and starts decoding those of its neighbours.
+     * \param page The slide whose traces are wanted
+     * \param cnv The canvas that will receive them
+     * \return true if the slide had traces (so that the canvas will need a merge), false otherwise
+     */
+    bool Restore(int page,Canvas &cnv);
+
+    /**
+     * Keeps in memory traces encoded by Pack as those of a slide, as Keep does with those of the canvas (for the traces of the slide
+     * that are kept aside while the boards are shown)
+     * \param page The slide to which the traces belong
+     * \param data The encoded traces
+     */
+    void KeepPacked(int page,const std::vector<unsigned char> &data);
+
+    /**
+     * Gets the traces of a slide encoded as Pack does, without putting them in any canvas
+     * \param page The slide whose traces are wanted
+     * \param out The encoded traces, which are empty if the slide has none
+     * \return false if sessions are not kept or there is no such slide (out is left as it was), true otherwise
+     */
+    bool GetPacked(int page,std::vector<unsigned char> &out);
+
+    /**
+     * Encodes the traces currently in the canvas, as they are kept for a slide (strokes if the canvas knows them, runs of pixels otherwise).
+     * It works even if sessions are not kept, so that other parts of the program can keep traces compressed in memory.
+     * \param cnv The canvas that contains the traces
+     * \param out The encoded traces, which are empty if there are none
+     */
+    void Pack(Canvas &cnv,std::vector<unsigned char> &out);
+
+    /**
+     * Puts in the canvas traces encoded by Pack, erasing those it had
+     * \param data The encoded traces
+     * \param cnv The canvas that will receive them
+     */
+    void Unpack(const std::vector<unsigned char> &data,Canvas &cnv);
+
+    /**
+     * Encodes a surface as runs of the pixels that are not background, which are appended to out. It is how the traces are kept when
+     * their strokes are not known, and other parts of the program use it to keep compressed surfaces that are mostly background.
+     * \param s The surface, of any pixel format
+     * \param back The bytes of a background pixel of the surface
+     * \param out The vector where the runs are appended
+     */
+    void Encode(SDL_Surface *s,const unsigned char *back,std::vector<unsigned char> &out);
+
+    /**
+     * Puts in a surface the pixels encoded by Encode. The background pixels are left as they are.
+     * \param data The runs
+     * \param len Length of the runs, in bytes
+     * \param s The surface, with the size and pixel format of the one encoded
+     */
+    void Decode(const unsigned char *data,Uint64 len,SDL_Surface *s);
+
+    /**
+     * Writes the session file, if any of the slides has been modified during this execution.
+     */
+    void Save(void);
+
+    /**
+     * Follows the document once it has been reloaded: the session is from then on that of the new content of the file. The traces stay
+     * with the number of their slide, also on the slides that have changed (correcting a typo in a slide should not erase what was drawn on it),
+     * and those of the slides that no longer exist are lost. The traces of the current slide must have been kept before.
+     * \param sld The slides object, with the new document
+     */
+    void Reload(PDFSlides &sld);
+
+    /**
+     * Cancels the decoding in advance that has not started yet. To be called before stopping the scheduler at the end of the program.
+     */
+    void CancelJobs(void) { token.Cancel(); };
+
+    /**
+     * Gets the memory used by the traces kept during this execution
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void);
+
+ private:
+    static const Uint32 SessionMagic = 0x53424256;   // "VBBS" read as little-endian
+    static const Uint32 SessionVersion = 1;
+
+    enum DataKinds { PixelRuns, Strokes };
+
+    struct Header
+    {
+     Uint32 magic;
+     Uint32 version;
+     Uint64 pdf_hash;
+     Uint32 pages;
+     Uint32 width;
+     Uint32 height;
+     Uint32 bpp;
+    };
+
+    struct IndexEntry
+    {
+     Uint64 offset;
+     Uint64 length;
+    };
+
+    void SetFileName(void);
+    void Map(void);
+    void Unmap(void);
+    void EncodeStrokes(const std::vector<Stroke> &st,std::vector<unsigned char> &out);
+    bool DecodeStrokes(const unsigned char *data,Uint64 len,std::vector<Stroke> &st);
+    void RestoreData(const unsigned char *data,Uint64 len,Canvas &cnv);
+    // Submits the decoding of the traces of the neighbours of a slide that are in the mapped file, and forgets those decoded for other slides
+    void Prefetch(int page);
+    // Decodes the traces of a slide of the mapped file, unless tk has been cancelled meanwhile. Run by the workers.
+    void DecodeInAdvance(int page,const CancelToken &tk);
+
+    bool enabled;
+    std::string dir;
+    std::string fname;
+    Uint64 pdf_hash;
+    int pages;
+    int width,height,bpp;
+
+    // The mapped file, and its index, or nullptr if there is no (valid) session file
+    unsigned char *mapped;
+    size_t map_len;
+    const IndexEntry *index;
+    // Slides in the mapped file, which may be more or less than those of the document after it is reloaded
+    int mapped_pages;
+
+    // Traces of the slides that have been kept during this execution. They override those of the mapped file.
+    std::map< int,std::vector<unsigned char> > kept;
+    bool changed;
+
+    // Strokes of the mapped file decoded in advance, and slides being decoded, protected by lock
+    Scheduler &scheduler;
+    CancelToken token;
+    SDL_mutex *lock;
+    std::map< int,std::vector<Stroke> > ready;
+    std::set<int> decoding;
+};
+
+#endif
@@ -0,0 +1,218 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "stroke.h"
+
+#include <cmath>
+#include <algorithm>
+
+void Stroke::Simplify(double tolerance)
+{
+ size_t n=points.size();
+ if (n<3)
+  return;
+
+ // The ranges still to be examined are kept in a stack, instead of recursing, so that very long strokes are not a problem
+ std::vector<bool> keep(n,false);
+ keep[0]=keep[n-1]=true;
+ std::vector< std::pair<size_t,size_t> > ranges;
+ ranges.push_back(std::make_pair(size_t(0),n-1));
+ while (!ranges.empty())
+ {
+  size_t a=ranges.back().first;
+  size_t b=ranges.back().second;
+  ranges.pop_back();
+  if (b<=a+1)
+   continue;
+  // The farthest point from the chord splits the range if it is too far. The distance is to the chord itself, not to its line,
+  // so that a stroke that goes back over itself keeps its turning point.
+  double cx=points[b].x-points[a].x;
+  double cy=points[b].y-points[a].y;
+  double len2=cx*cx+cy*cy;
+  double worst=-1.0;
+  size_t split=a;
+  for (size_t i=a+1;i<b;i++)
+  {
+   double px=points[i].x-points[a].x;
+   double py=points[i].y-points[a].y;
+   double t=(len2>0.0) ? std::min(std::max((px*cx+py*cy)/len2,0.0),1.0) : 0.0;
+   double d=hypot(px-t*cx,py-t*cy);
+   if (d>worst)
+   {
+    worst=d;
+    split=i;
+   }
+  }
+  if (worst>tolerance)
+  {
+   keep[split]=true;
+   ranges.push_back(std::make_pair(a,split));
+   ranges.push_back(std::make_pair(split,b));
+  }
+ }
+
+ size_t k=0;
+ for (size_t i=0;i<n;i++)
+  if (keep[i])
+   points[k++]=points[i];
+ points.resize(k);
+}
+
+StrokePredictor::StrokePredictor(Uint32 ms)
+{
+ horizon=Uint64(ms)*1000000ULL;
+ last=0;
+ count=0;
+}
+
+void StrokePredictor::AddSample(int x,int y,Uint64 stamp)
+{
+ last=(last+1)%MaxSamples;
+ samples[last].x=x;
+ samples[last].y=y;
+ samples[last].stamp=stamp;
+ if (count<MaxSamples)
+  count++;
+}
+
+bool StrokePredictor::Predict(int &x,int &y)
+{
+ if ((count<2) || (horizon==0))
+  return false;
+
+ // The oldest sample within the window gives the mean velocity. Events read together share their stamp,
+ // so a sample with the same stamp as the last one says nothing about the velocity.
+ const Sample &l=samples[last];
+ int oldest=-1;
+ for (int i=1;i<count;i++)
+ {
+  int k=(last-i+MaxSamples)%MaxSamples;
+  if (l.stamp-samples[k].stamp>VelocityWindow)
+   break;
+  if (samples[k].stamp<l.stamp)
+   oldest=k;
+ }
+ if (oldest<0)
+  return false;
+
+ const Sample &o=samples[oldest];
+ double f=double(horizon)/double(l.stamp-o.stamp);
+ double dx=(l.x-o.x)*f;
+ double dy=(l.y-o.y)*f;
+ double d=sqrt(dx*dx+dy*dy);
+ if (d<1.0)
+  return false;
+ if (d>MaxDistance)
+ {
+  dx*=MaxDistance/d;
+  dy*=MaxDistance/d;
+ }
+ x=l.x+int(lround(dx));
+ y=l.y+int(lround(dy));
+ return true;
+}
+
+StrokeSmoother::StrokeSmoother()
+{
+ count=0;
+}
+
+void StrokeSmoother::Begin(int x,int y)
+{
+ last[2].x=x;
+ last[2].y=y;
+ count=1;
+}
+
+void StrokeSmoother::AddPoint(int x,int y,std::vector<StrokePoint> &out)
+{
+ if (count==0)
+ {
+  Begin(x,y);
+  return;
+ }
+ StrokePoint p;
+ p.x=x;
+ p.y=y;
+ // The span between the two former positions is now known. The first one of the stroke has no position before it, so it is repeated.
+ if (count==2)
+  Span(last[1],last[1],last[2],p,out);
+ else if (count==3)
+  Span(last[0],last[1],last[2],p,out);
+ last[0]=last[1];
+ last[1]=last[2];
+ last[2]=p;
+ if (count<3)
+  count++;
+}
+
+void StrokeSmoother::End(std::vector<StrokePoint> &out)
+{
+ // The last position has none after it, so it is repeated
+ if (count==2)
+  Span(last[1],last[1],last[2],last[2],out);
+ else if (count==3)
+  Span(last[0],last[1],last[2],last[2],out);
+ count=0;
+}
+
+void StrokeSmoother::Span(const StrokePoint &p0,const StrokePoint &p1,const StrokePoint &p2,const StrokePoint &p3,std::vector<StrokePoint> &out)
+{
+ // Centripetal parameterization: the knots are spaced as the square root of the distance between positions.
+ // Repeated positions would give equal knots, so a minimum spacing is kept; their weight is then multiplied by a null difference.
+ const double MinKnot=1e-4;
+ double t0=0.0;
+ double t1=t0+std::max(sqrt(hypot(p1.x-p0.x,p1.y-p0.y)),MinKnot);
+ double t2=t1+std::max(sqrt(hypot(p2.x-p1.x,p2.y-p1.y)),MinKnot);
+ double t3=t2+std::max(sqrt(hypot(p3.x-p2.x,p3.y-p2.y)),MinKnot);
+
+ // Barry and Goldman's pyramidal evaluation of the spline at t, between t1 and t2
+ auto eval=[&](double t,double &x,double &y)
+ {
+  double a1x=((t1-t)*p0.x+(t-t0)*p1.x)/(t1-t0),a1y=((t1-t)*p0.y+(t-t0)*p1.y)/(t1-t0);
+  double a2x=((t2-t)*p1.x+(t-t1)*p2.x)/(t2-t1),a2y=((t2-t)*p1.y+(t-t1)*p2.y)/(t2-t1);
+  double a3x=((t3-t)*p2.x+(t-t2)*p3.x)/(t3-t2),a3y=((t3-t)*p2.y+(t-t2)*p3.y)/(t3-t2);
+  double b1x=((t2-t)*a1x+(t-t0)*a2x)/(t2-t0),b1y=((t2-t)*a1y+(t-t0)*a2y)/(t2-t0);
+  double b2x=((t3-t)*a2x+(t-t1)*a3x)/(t3-t1),b2y=((t3-t)*a2y+(t-t1)*a3y)/(t3-t1);
+  x=((t2-t)*b1x+(t-t1)*b2x)/(t2-t1);
+  y=((t2-t)*b1y+(t-t1)*b2y)/(t2-t1);
+ };
+
+ // If the middle of the span is close to the line of the chord, one straight piece is enough
+ double chord=hypot(p2.x-p1.x,p2.y-p1.y);
+ double mx,my;
+ eval((t1+t2)/2.0,mx,my);
+ double dev=(chord>0.0) ? fabs((p2.x-p1.x)*(my-p1.y)-(p2.y-p1.y)*(mx-p1.x))/chord : 0.0;
+ int pieces=(dev<Flatness) ? 1 : std::max(2,int(ceil(chord/SegmentLength)));
+
+ StrokePoint q,prev=p1;
+ for (int i=1;i<=pieces;i++)
+ {
+  if (i==pieces)
+   q=p2;
+  else
+  {
+   double x,y;
+   eval(t1+(t2-t1)*i/pieces,x,y);
+   q.x=int(lround(x));
+   q.y=int(lround(y));
+  }
+  if ((q.x!=prev.x) || (q.y!=prev.y))
+   out.push_back(q);
+  prev=q;
+ }
+}
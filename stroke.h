@@ -0,0 +1,182 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef STROKE_H
+#define STROKE_H
+
+#include <vector>
+#include <SDL/SDL.h>
+
+/**
+ * A point of a stroke, in screen pixels
+ */
+struct StrokePoint
+{
+ int x,y;
+};
+
+/*! \brief A finished stroke: the polyline drawn by the pen (or the eraser, or the highlighter) and the brush it was drawn with
+ *
+ * The brush is a square of size pixels, whose upper-left corner is offset pixels up and left of each point of the line,
+ * filled with color (a pixel value of the format of the canvas). Strokes of the highlighter are not drawn in the traces
+ * but in the highlight layer, and their color is that of the highlighter.
+*/
+struct Stroke
+{
+ /**
+  * What drew the stroke
+  */
+ enum Tools { Pen, Eraser, Highlighter };
+
+ Uint32 color;
+ Uint16 size;
+ Uint8 offset;
+ Uint8 tool;
+ std::vector<StrokePoint> points;
+
+ /**
+  * Removes the points that are not needed to draw the polyline within a tolerance (Ramer-Douglas-Peucker).
+  * The first and the last points are always kept.
+  * \param tolerance Maximum distance, in pixels, from any removed point to the simplified polyline
+  */
+ void Simplify(double tolerance);
+};
+
+/*! \brief Class to guess where the pen will be in a few milliseconds
+ *
+ * Between the moment the pen moves and the moment its line is on the screen, the tablet, SDL and the display add some
+ * delay, and the ink trails behind the tip of the pen. The predictor keeps the last positions of the pen, with the time
+ * they were read, and extrapolates the movement a few milliseconds ahead with the mean velocity of the recent ones.
+ *
+ * The predicted point is only used to draw a provisional segment on the screen, which is removed when the next real
+ * position arrives. Nothing predicted is ever written in the traces.
+*/
+class StrokePredictor
+{
+ public:
+    /**
+     * Number of positions that are kept
+     */
+    static const int MaxSamples = 8;
+
+    /**
+     * Only the positions read within this time (in nanoseconds) before the last one are used to compute the velocity
+     */
+    static const Uint64 VelocityWindow = 40000000ULL;
+
+    /**
+     * Maximum distance, in pixels, from the last position to the predicted one, so that a wrong guess is never too visible
+     */
+    static const int MaxDistance = 48;
+
+    /**
+     * Constructor
+     * \param ms How far ahead the movement is extrapolated, in milliseconds
+     */
+    StrokePredictor(Uint32 ms);
+
+    /**
+     * Forgets all the positions, as it is done when the pen is pressed or lifted
+     */
+    void Reset(void) { count=0; };
+
+    /**
+     * Adds a position of the pen
+     * \param x The x coordinate
+     * \param y The y coordinate
+     * \param stamp The moment it was read, in nanoseconds of InputQueue::Now
+     */
+    void AddSample(int x,int y,Uint64 stamp);
+
+    /**
+     * Gets the predicted position of the pen
+     * \param x The x coordinate, returned by reference
+     * \param y The y coordinate, returned by reference
+     * \return true if there is a prediction, false if there are not enough positions or the pen is not moving
+     */
+    bool Predict(int &x,int &y);
+
+ private:
+    struct Sample
+    {
+     int x,y;
+     Uint64 stamp;
+    };
+
+    Uint64 horizon;
+    Sample samples[MaxSamples];
+    // The samples form a ring. last is the position of the newest one.
+    int last,count;
+};
+
+/*! \brief Class to turn the positions of the pen into a smooth curve
+ *
+ * The positions read from the pen are joined with a centripetal Catmull-Rom spline, which passes through all of them
+ * without loops nor cusps, even when they are unevenly spaced. Each span of the curve, between two positions, needs the
+ * position before and the one after, so it is final (and given to be drawn) only when the next position has arrived.
+ * The last span is given when the pen is lifted.
+ *
+ * Each span is given as straight pieces of about SegmentLength pixels, or as a single one if it is almost straight.
+ * The points are given in the order they have to be joined; the first one of each span is the last of the former one,
+ * and it is not repeated.
+*/
+class StrokeSmoother
+{
+ public:
+    /**
+     * Approximate length, in pixels, of the straight pieces into which a curved span is cut
+     */
+    static const int SegmentLength = 6;
+
+    /**
+     * Constructor
+     */
+    StrokeSmoother();
+
+    /**
+     * Starts a stroke
+     * \param x The x coordinate of the first position
+     * \param y The y coordinate of the first position
+     */
+    void Begin(int x,int y);
+
+    /**
+     * Adds a position to the stroke
+     * \param x The x coordinate
+     * \param y The y coordinate
+     * \param out The points of the span that has become final, if any, are appended to it
+     */
+    void AddPoint(int x,int y,std::vector<StrokePoint> &out);
+
+    /**
+     * Ends the stroke
+     * \param out The points up to the last position are appended to it
+     */
+    void End(std::vector<StrokePoint> &out);
+
+ private:
+    // Below this deviation from the chord, in pixels, a span is drawn as a straight line
+    static constexpr double Flatness = 0.5;
+
+    void Span(const StrokePoint &p0,const StrokePoint &p1,const StrokePoint &p2,const StrokePoint &p3,std::vector<StrokePoint> &out);
+
+    // The last three positions, the newest one at the end, and how many of them belong to the stroke (0 if there is no stroke)
+    StrokePoint last[3];
+    int count;
+};
+
+#endif
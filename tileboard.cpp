@@ -0,0 +1,256 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "tileboard.h"
+#include "session.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+TileBoard::TileBoard(SDL_PixelFormat *fmt)
+{
+ format=fmt;
+ // The background of the traces is white
+ background=SDL_MapRGB(format,0xFF,0xFF,0xFF);
+ vx=vy=0;
+ packed=false;
+}
+
+TileBoard::~TileBoard()
+{
+ Clear();
+}
+
+void TileBoard::Clear(void)
+{
+ for (std::map<TileKey,Tile>::iterator it=tiles.begin();it!=tiles.end();++it)
+  if (it->second.s!=nullptr)
+   SDL_FreeSurface(it->second.s);
+ tiles.clear();
+ packed=false;
+}
+
+SDL_Surface *TileBoard::NewTileSurface(void)
+{
+ SDL_Surface *t=SDL_CreateRGBSurface(SDL_SWSURFACE,TileSize,TileSize,format->BitsPerPixel,
+                                     format->Rmask,format->Gmask,format->Bmask,format->Amask);
+ if (t==nullptr)
+ {
+  std::cerr << "Error creating the SDL surface of a tile of the board. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+ if (format->palette!=nullptr)
+  SDL_SetPalette(t,SDL_LOGPAL,format->palette->colors,0,format->palette->ncolors);
+ SDL_FillRect(t,nullptr,background);
+ return t;
+}
+
+SDL_Surface *TileBoard::PlaneSurface(std::vector<Uint8> &plane)
+{
+ SDL_Surface *t=SDL_CreateRGBSurfaceFrom(&plane[0],TileSize,TileSize,8,TileSize,0,0,0,0);
+ if (t==nullptr)
+ {
+  std::cerr << "Error creating the SDL surface of a tile of the board. Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+ return t;
+}
+
+void TileBoard::Pack(SessionStore &ses,const unsigned char *vback)
+{
+ if (packed)
+  return;
+ const unsigned char uncovered=0;
+ for (std::map<TileKey,Tile>::iterator it=tiles.begin();it!=tiles.end();++it)
+ {
+  Tile &t=it->second;
+  ses.Encode(t.s,vback,t.runs[0]);
+  SDL_FreeSurface(t.s);
+  t.s=nullptr;
+  for (int k=0;k<NumPlanes;k++)
+  {
+   if (t.planes[k].empty())
+    continue;
+   SDL_Surface *p=PlaneSurface(t.planes[k]);
+   ses.Encode(p,&uncovered,t.runs[1+k]);
+   SDL_FreeSurface(p);
+   std::vector<Uint8>().swap(t.planes[k]);
+  }
+ }
+ packed=true;
+}
+
+void TileBoard::Unpack(SessionStore &ses)
+{
+ if (!packed)
+  return;
+ for (std::map<TileKey,Tile>::iterator it=tiles.begin();it!=tiles.end();++it)
+ {
+  Tile &t=it->second;
+  t.s=NewTileSurface();
+  if (!t.runs[0].empty())
+   ses.Decode(&t.runs[0][0],t.runs[0].size(),t.s);
+  std::vector<unsigned char>().swap(t.runs[0]);
+  for (int k=0;k<NumPlanes;k++)
+  {
+   // A plane with no runs was not covered at all
+   if (t.runs[1+k].empty())
+    continue;
+   t.planes[k].assign(size_t(TileSize)*size_t(TileSize),0);
+   SDL_Surface *p=PlaneSurface(t.planes[k]);
+   ses.Decode(&t.runs[1+k][0],t.runs[1+k].size(),p);
+   SDL_FreeSurface(p);
+   std::vector<unsigned char>().swap(t.runs[1+k]);
+  }
+ }
+ packed=false;
+}
+
+void TileBoard::Store(SDL_Surface *ink,const unsigned char *vback,Uint8 *const planes[NumPlanes],SDL_Rect r,int bx,int by)
+{
+ int bpp=format->BytesPerPixel;
+ for (int ty=TileOf(by);ty*TileSize<by+int(r.h);ty++)
+  for (int tx=TileOf(bx);tx*TileSize<bx+int(r.w);tx++)
+  {
+   // The part of the area that falls in this tile, in coordinates of the board
+   int x1=std::max(bx,tx*TileSize),x2=std::min(bx+int(r.w),(tx+1)*TileSize);
+   int y1=std::max(by,ty*TileSize),y2=std::min(by+int(r.h),(ty+1)*TileSize);
+   SDL_Rect src;
+   src.x=Sint16(r.x+x1-bx);
+   src.y=Sint16(r.y+y1-by);
+   src.w=Uint16(x2-x1);
+   src.h=Uint16(y2-y1);
+   // Which planes have some pixel covered here
+   bool covered[NumPlanes];
+   bool any=false;
+   for (int k=0;k<NumPlanes;k++)
+   {
+    covered[k]=false;
+    if (planes[k]==nullptr)
+     continue;
+    for (int y=src.y;(y<src.y+src.h) && !covered[k];y++)
+    {
+     const Uint8 *p=planes[k]+size_t(y)*size_t(ink->w)+src.x;
+     for (int x=0;(x<src.w) && !covered[k];x++)
+      covered[k]=(p[x]!=0);
+    }
+    any=any || covered[k];
+   }
+   std::map<TileKey,Tile>::iterator it=tiles.find(TileKey(tx,ty));
+   if (it==tiles.end())
+   {
+    // Only background here: there is nothing to keep
+    bool traced=any;
+    SDL_LockSurface(ink);
+    for (int y=src.y;(y<src.y+src.h) && !traced;y++)
+    {
+     const unsigned char *p=(const unsigned char *)ink->pixels+y*ink->pitch+src.x*bpp;
+     for (int x=0;(x<src.w) && !traced;x++,p+=bpp)
+      traced=(memcmp(p,vback,bpp)!=0);
+    }
+    SDL_UnlockSurface(ink);
+    if (!traced)
+     continue;
+    Tile t;
+    t.s=NewTileSurface();
+    it=tiles.insert(std::make_pair(TileKey(tx,ty),t)).first;
+   }
+   SDL_Rect dst;
+   dst.x=Sint16(x1-tx*TileSize);
+   dst.y=Sint16(y1-ty*TileSize);
+   SDL_BlitSurface(ink,&src,it->second.s,&dst);
+   for (int k=0;k<NumPlanes;k++)
+   {
+    std::vector<Uint8> &tp=it->second.planes[k];
+    // A plane that the tile does not have is not covered, so it only has to be created if something is covered now
+    if (tp.empty() && !covered[k])
+     continue;
+    if (tp.empty())
+     tp.assign(size_t(TileSize)*size_t(TileSize),0);
+    for (int y=0;y<src.h;y++)
+     memcpy(&tp[size_t(dst.y+y)*TileSize+dst.x],planes[k]+size_t(src.y+y)*size_t(ink->w)+src.x,src.w);
+   }
+  }
+}
+
+int TileBoard::Load(SDL_Surface *ink,Uint8 *const planes[NumPlanes],SDL_Rect r,int bx,int by)
+{
+ int loaded=0;
+ for (int ty=TileOf(by);ty*TileSize<by+int(r.h);ty++)
+  for (int tx=TileOf(bx);tx*TileSize<bx+int(r.w);tx++)
+  {
+   int x1=std::max(bx,tx*TileSize),x2=std::min(bx+int(r.w),(tx+1)*TileSize);
+   int y1=std::max(by,ty*TileSize),y2=std::min(by+int(r.h),(ty+1)*TileSize);
+   SDL_Rect dst;
+   dst.x=Sint16(r.x+x1-bx);
+   dst.y=Sint16(r.y+y1-by);
+   dst.w=Uint16(x2-x1);
+   dst.h=Uint16(y2-y1);
+   SDL_Rect src;
+   src.x=Sint16(x1-tx*TileSize);
+   src.y=Sint16(y1-ty*TileSize);
+   src.w=dst.w;
+   src.h=dst.h;
+   std::map<TileKey,Tile>::iterator it=tiles.find(TileKey(tx,ty));
+   if (it==tiles.end())
+   {
+    SDL_Rect d=dst;
+    SDL_FillRect(ink,&d,background);
+   }
+   else
+   {
+    SDL_Rect d=dst;
+    SDL_BlitSurface(it->second.s,&src,ink,&d);
+   }
+   for (int k=0;k<NumPlanes;k++)
+   {
+    if (planes[k]==nullptr)
+     continue;
+    const std::vector<Uint8> *tp=(it!=tiles.end()) ? &(it->second.planes[k]) : nullptr;
+    bool kept=((tp!=nullptr) && !tp->empty());
+    for (int y=0;y<dst.h;y++)
+    {
+     Uint8 *p=planes[k]+size_t(dst.y+y)*size_t(ink->w)+dst.x;
+     if (kept)
+      memcpy(p,&(*tp)[size_t(src.y+y)*TileSize+src.x],dst.w);
+     else
+      memset(p,0,dst.w);
+    }
+    if (kept)
+     loaded|=(1<<k);
+   }
+  }
+ return loaded;
+}
+
+Uint64 TileBoard::MemoryUse(void)
+{
+ Uint64 m=0;
+ for (std::map<TileKey,Tile>::const_iterator it=tiles.begin();it!=tiles.end();++it)
+ {
+  if (it->second.s!=nullptr)
+   m+=Uint64(it->second.s->pitch)*Uint64(it->second.s->h);
+  for (int k=0;k<NumPlanes;k++)
+   m+=it->second.planes[k].capacity();
+  for (int k=0;k<=NumPlanes;k++)
+   m+=it->second.runs[k].capacity();
+ }
+ return m;
+}
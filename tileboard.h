@@ -0,0 +1,165 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef TILEBOARD_H
+#define TILEBOARD_H
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <SDL/SDL.h>
+
+class SessionStore;
+
+/*! \brief Class to keep the traces of a blackboard larger than the screen, which is panned to see each part of it
+ *
+ * The board has no limits in any direction. What is seen (the view) is in the buffer of traces of the canvas, as usual;
+ * what is out of it is kept here, in square tiles of TileSize pixels that are only allocated where there are traces. When
+ * the view is panned, the canvas stores here the part of the traces that leaves the screen and loads from here the part
+ * that enters it, so the tiles are always exact outside the view (and may be stale inside it).
+ *
+ * Beside the traces, a tile keeps the planes that tell how much of each pixel is covered by the highlighter and by the
+ * antialiased ink, since the traces alone would come back as opaque ink without highlights. A plane is only allocated in the
+ * tiles where some pixel is covered.
+ *
+ * While the board is not shown, its tiles are packed: the traces and the planes of each tile are encoded as runs of what is not
+ * background, as the session store does with the traces of the slides, and the surfaces are freed.
+ *
+ * Coordinates of the board are those of the view when it was first shown, with the origin at the upper-left corner of the drawing area.
+*/
+class TileBoard
+{
+ public:
+    /**
+     * Side of the tiles, in pixels
+     */
+    static const int TileSize = 256;
+
+    /**
+     * The planes of coverage kept with the traces: that of the highlighter and that of the antialiased ink
+     */
+    enum Planes { HighlightPlane, InkPlane, NumPlanes };
+
+    /**
+     * Constructor. The board is empty and the view is at the origin.
+     * \param fmt The pixel format of the buffer of traces
+     */
+    TileBoard(SDL_PixelFormat *fmt);
+
+    /**
+     * Destructor. It frees the tiles.
+     */
+    ~TileBoard();
+
+    /**
+     * Keeps an area of the buffer of traces, and of the planes of coverage, in the tiles. Tiles are allocated only if the area has traces or
+     * coverage where there are none.
+     * \param ink The buffer of traces
+     * \param vback The bytes of a background pixel of the buffer
+     * \param planes The planes of coverage, one byte per pixel and as wide as the buffer, addressed as it is; nullptr for those not used
+     * \param r The area of the buffer
+     * \param bx Coordinate x of the board of the upper-left corner of the area
+     * \param by Coordinate y of the board of the upper-left corner of the area
+     */
+    void Store(SDL_Surface *ink,const unsigned char *vback,Uint8 *const planes[NumPlanes],SDL_Rect r,int bx,int by);
+
+    /**
+     * Puts in an area of the buffer of traces, and of the planes of coverage, what the tiles keep (background and no coverage where there are no tiles)
+     * \param ink The buffer of traces
+     * \param planes The planes of coverage, as in Store
+     * \param r The area of the buffer
+     * \param bx Coordinate x of the board of the upper-left corner of the area
+     * \param by Coordinate y of the board of the upper-left corner of the area
+     * \return For each plane, bit 1<<plane is set if coverage has been taken from the tiles (so some pixels may be covered)
+     */
+    int Load(SDL_Surface *ink,Uint8 *const planes[NumPlanes],SDL_Rect r,int bx,int by);
+
+    /**
+     * Packs the tiles, when the board stops being shown. Store and Load cannot be used until Unpack is called.
+     * \param ses The session store, which encodes the runs
+     * \param vback The bytes of a background pixel of the buffer of traces
+     */
+    void Pack(SessionStore &ses,const unsigned char *vback);
+
+    /**
+     * Unpacks the tiles, when the board is shown again. Nothing is done if they are not packed.
+     * \param ses The session store, which decodes the runs
+     */
+    void Unpack(SessionStore &ses);
+
+    /**
+     * Drops all the tiles, as when the board is erased. The view does not move.
+     */
+    void Clear(void);
+
+    /**
+     * Tells if there are no tiles (so there are no traces out of the view)
+     * \return true if there are none
+     */
+    bool Empty(void) { return tiles.empty(); };
+
+    /**
+     * Gets the position of the view
+     * \return Coordinate x of the board of the upper-left corner of the view
+     */
+    int GetX(void) { return vx; };
+
+    /**
+     * Gets the position of the view
+     * \return Coordinate y of the board of the upper-left corner of the view
+     */
+    int GetY(void) { return vy; };
+
+    /**
+     * Moves the view
+     * \param dx Pixels to the right (negative to the left)
+     * \param dy Pixels down (negative up)
+     */
+    void Move(int dx,int dy) { vx+=dx; vy+=dy; };
+
+    /**
+     * Gets the memory used by the tiles
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void);
+
+ private:
+    typedef std::pair<int,int> TileKey;
+
+    struct Tile
+    {
+     SDL_Surface *s;
+     // TileSize*TileSize bytes, or empty if nothing of the tile is covered
+     std::vector<Uint8> planes[NumPlanes];
+     // While the board is packed, the runs of the traces and of each plane (s is nullptr and the planes are empty then)
+     std::vector<unsigned char> runs[1+NumPlanes];
+    };
+
+    SDL_Surface *NewTileSurface(void);
+    // A plane of a tile seen as a surface of 8 bits per pixel, to be encoded and decoded as the traces
+    static SDL_Surface *PlaneSurface(std::vector<Uint8> &plane);
+
+    static int TileOf(int c) { return (c>=0) ? c/TileSize : -((-c+TileSize-1)/TileSize); };
+
+    SDL_PixelFormat *format;
+    Uint32 background;
+    int vx,vy;
+    std::map<TileKey,Tile> tiles;
+    bool packed;
+};
+
+#endif
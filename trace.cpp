@@ -0,0 +1,144 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "trace.h"
+
+#include <sstream>
+
+InputTrace::InputTrace(const std::string &fn,int w,int h)
+{
+ fname=fn;
+ started=false;
+ first=0;
+ f.open(fname.c_str());
+ if (!f.is_open())
+ {
+  std::cerr << "Cannot create the trace file " << fname << ". Exiting.\n";
+  SDL_Quit();
+  exit(1);
+ }
+ f << Magic << " " << Version << " " << w << " " << h << "\n";
+}
+
+InputTrace::~InputTrace()
+{
+ f.close();
+ if (f.fail())
+  std::cerr << "Warning: error writing the trace file " << fname << ". It may be incomplete.\n";
+}
+
+void InputTrace::Record(const InputEvent &ie)
+{
+ const SDL_Event &ev=ie.event;
+ std::ostringstream line;
+ switch (ev.type)
+ {
+  case SDL_MOUSEBUTTONDOWN:
+             line << "down " << ev.button.x << " " << ev.button.y << " " << int(ev.button.button);
+             break;
+  case SDL_MOUSEBUTTONUP:
+             line << "up " << ev.button.x << " " << ev.button.y << " " << int(ev.button.button);
+             break;
+  case SDL_MOUSEMOTION:
+             line << "motion " << ev.motion.x << " " << ev.motion.y << " " << int(ev.motion.state);
+             break;
+  case SDL_KEYDOWN:
+             line << "key " << int(ev.key.keysym.sym) << " " << int(ev.key.keysym.unicode);
+             break;
+  default: return;
+ }
+ if (!started)
+ {
+  first=ie.stamp;
+  started=true;
+ }
+ f << (ie.stamp-first)/1000 << " " << line.str() << "\n";
+}
+
+void InputTrace::Load(const std::string &fn,std::vector<InputEvent> &events,int &w,int &h)
+{
+ std::ifstream in(fn.c_str());
+ if (!in.is_open())
+ {
+  std::cerr << "Cannot open the trace file " << fn << ". Exiting.\n";
+  exit(1);
+ }
+
+ std::string magic;
+ int version=0;
+ if (!(in >> magic >> version >> w >> h) || (magic!=Magic) || (version!=Version))
+ {
+  std::cerr << "The file " << fn << " is not a trace of this version of the program. Exiting.\n";
+  exit(1);
+ }
+
+ events.clear();
+ std::string l;
+ int nline=1;
+ std::getline(in,l);
+ while (std::getline(in,l))
+ {
+  nline++;
+  if (l.empty())
+   continue;
+  std::istringstream ls(l);
+  Uint64 us;
+  std::string kind;
+  InputEvent ie;
+  memset(&ie,0,sizeof(InputEvent));
+  bool ok=bool(ls >> us >> kind);
+  int a=0,b=0,c=0;
+  if (ok && (kind=="key"))
+  {
+   // The character is what the search reads
+   ok=bool(ls >> a >> b);
+   ie.event.type=SDL_KEYDOWN;
+   ie.event.key.type=SDL_KEYDOWN;
+   ie.event.key.state=SDL_PRESSED;
+   ie.event.key.keysym.sym=SDLKey(a);
+   ie.event.key.keysym.unicode=Uint16(b);
+  }
+  else if (ok && ((kind=="down") || (kind=="up")))
+  {
+   ok=bool(ls >> a >> b >> c);
+   ie.event.type=(kind=="down") ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+   ie.event.button.type=ie.event.type;
+   ie.event.button.state=(kind=="down") ? SDL_PRESSED : SDL_RELEASED;
+   ie.event.button.x=Uint16(a);
+   ie.event.button.y=Uint16(b);
+   ie.event.button.button=Uint8(c);
+  }
+  else if (ok && (kind=="motion"))
+  {
+   ok=bool(ls >> a >> b >> c);
+   ie.event.type=SDL_MOUSEMOTION;
+   ie.event.motion.type=SDL_MOUSEMOTION;
+   ie.event.motion.x=Uint16(a);
+   ie.event.motion.y=Uint16(b);
+   ie.event.motion.state=Uint8(c);
+  }
+  else
+   ok=false;
+  if (!ok)
+  {
+   std::cerr << "Error in line " << nline << " of the trace file " << fn << ". Exiting.\n";
+   exit(1);
+  }
+  ie.stamp=us*1000ULL;
+  events.push_back(ie);
+ }
+}
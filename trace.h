@@ -0,0 +1,91 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "inputqueue.h"
+
+/*! \brief Class to record the input events of a session to a trace file, and to read them back to replay them
+ *
+ * A trace is a text file. The first line is the magic word, the version and the resolution of the screen in
+ * which it was recorded (events carry screen coordinates, so a trace must be replayed at the same resolution
+ * to give the same result). Then there is a line per event:
+ *
+ *     <microseconds since the first event> <kind> <values>
+ *
+ * where kind and values are one of:
+ *
+ *     down <x> <y> <button>    a mouse or pen button has been pressed
+ *     up <x> <y> <button>      a mouse or pen button has been released
+ *     motion <x> <y> <state>   the mouse or pen has moved, with the state of its buttons
+ *     key <sym> <unicode>      a key has been pressed (its SDL key symbol, and the character it types, or 0)
+ *
+ * Only the events processed by the main loop are recorded.
+*/
+class InputTrace
+{
+ public:
+    /**
+     * First word of a trace file
+     */
+    static constexpr const char* Magic = "VBBTRACE";
+
+    /**
+     * Version of the format
+     */
+    static const int Version = 1;
+
+    /**
+     * Constructor. It creates the trace file to record the events. If it cannot be created, the program ends.
+     * \param fn Name of the file
+     * \param w Width of the screen or window
+     * \param h Height of the screen or window
+     */
+    InputTrace(const std::string &fn,int w,int h);
+
+    /**
+     * Destructor. It closes the file.
+     */
+    ~InputTrace();
+
+    /**
+     * Writes an event to the trace, if it is of a kind that is recorded
+     * \param ie The event, with the time it was read
+     */
+    void Record(const InputEvent &ie);
+
+    /**
+     * Reads a trace file. If it cannot be read or its format is wrong, the program ends.
+     * \param fn Name of the file
+     * \param events The events, returned by reference. Their stamps are the nanoseconds since the first one.
+     * \param w Width of the screen or window in which the trace was recorded, returned by reference
+     * \param h Height of the screen or window in which the trace was recorded, returned by reference
+     */
+    static void Load(const std::string &fn,std::vector<InputEvent> &events,int &w,int &h);
+
+ private:
+    std::string fname;
+    std::ofstream f;
+    bool started;
+    Uint64 first;
+};
+
+#endif
@@ -0,0 +1,869 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+
+// The benchmarks of the kernels that do the heavy work of the program: rendering and conversion of the slides,
+// merge of the traces, drawing of lines, erasing and writing of images. Everything is done in memory, with the
+// same classes as the program, at several resolutions. Results are written to the standard output, one JSON object
+// per line, so that they can be compared between versions.
+//
+// With -c, instead of measuring, the kernels are checked: in every pixel format the program may find, each one is
+// compared with a plain reference implementation, and what is drawn with golden images recorded before.
+
+#include "canvas.h"
+#include "pdfslides.h"
+#include "scheduler.h"
+#include "trace.h"
+#include "antialias.h"
+
+#include <sstream>
+#include <unistd.h>
+#include <time.h>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+
+/**
+ * Deck used when none is given. It is copied to the build directory by cmake.
+ */
+static constexpr const char* DefaultDeck = "vbb_bench_deck.pdf";
+
+/**
+ * Number of samples taken of each kernel. The median is reported.
+ */
+static const int Samples = 5;
+
+/**
+ * Default time, in milliseconds, that each kernel runs at each resolution
+ */
+static const int DefaultMinTime = 500;
+
+/**
+ * Resolution of the checks, unless another one is given or a trace is used
+ */
+static const int CheckXRes = 320;
+static const int CheckYRes = 180;
+
+/**
+ * Difference allowed between a rendered slide and its golden image, since antialiasing may change between versions of poppler
+ */
+static const int RenderTolerance = 8;
+
+/**
+ * Writes how the program is called, and ends it
+ * \param prog Name of the program
+ */
+static void Usage(const char *prog)
+{
+ std::cerr << "Usage: " << prog << " [-d deck.pdf] [-r WxH]... [-t ms] [-k kernel]\n";
+ std::cerr << "       " << prog << " -c golden_dir [-u] [-d deck.pdf] [-r WxH] [-p trace_file]\n";
+ std::cerr << "       -d  the PDF file whose pages are rendered (default: " << DefaultDeck << ")\n";
+ std::cerr << "       -r  a resolution to measure at. It can be repeated. Default: 1024x576, 1920x1080 and 3840x2160\n";
+ std::cerr << "       -t  time in milliseconds that each kernel runs at each resolution (default: " << DefaultMinTime << ")\n";
+ std::cerr << "       -k  measure only the kernels whose name starts with this (render, convert, merge, drawline, erase, writepnm)\n";
+ std::cerr << "       -c  do not measure, but check the kernels and compare what they draw with the golden images in golden_dir\n";
+ std::cerr << "       -u  record the golden images (drawn with 32 bits per pixel) instead of comparing with them\n";
+ std::cerr << "       -p  draw the traces of a recorded trace file, at its resolution, instead of the synthetic ones\n";
+ std::cerr << "       The checks are done at " << CheckXRes << "x" << CheckYRes << " unless -r or -p say otherwise.\n";
+ exit(1);
+}
+
+/**
+ * Gets the time of a monotonic clock
+ * \return Nanoseconds since an arbitrary point
+ */
+static Uint64 Now(void)
+{
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC,&ts);
+ return Uint64(ts.tv_sec)*1000000000ULL+Uint64(ts.tv_nsec);
+}
+
+/**
+ * Measures the time of a kernel. The number of calls per sample is doubled until a sample takes its share of the total time,
+ * and then Samples samples are taken.
+ * \param f The kernel, which does one operation per call
+ * \param min_time Time in nanoseconds to spend in the measure
+ * \param runs Returns the number of calls done in the samples
+ * \return The median of the samples, in nanoseconds per call
+ */
+static double Measure(const std::function<void(void)> &f,Uint64 min_time,Uint64 &runs)
+{
+ // The first call is never measured: it finds cold caches and, maybe, lazy initializations
+ f();
+
+ Uint64 batch=1,t;
+ while (true)
+ {
+  Uint64 t0=Now();
+  for (Uint64 i=0;i<batch;i++)
+   f();
+  t=Now()-t0;
+  if ((t*Samples>=min_time) || (batch>=(1ULL<<30)))
+   break;
+  batch*=2;
+ }
+
+ std::vector<double> s;
+ s.push_back(double(t)/double(batch));
+ for (int i=1;i<Samples;i++)
+ {
+  Uint64 t0=Now();
+  for (Uint64 j=0;j<batch;j++)
+   f();
+  s.push_back(double(Now()-t0)/double(batch));
+ }
+ runs=batch*Samples;
+ std::sort(s.begin(),s.end());
+ return s[Samples/2];
+}
+
+/**
+ * Measures a kernel, if it has been selected, and writes its result
+ * \param kernel Name of the kernel
+ * \param param Parameter of the kernel (like the line width), or 0
+ * \param w Horizontal resolution
+ * \param h Vertical resolution
+ * \param pixels Pixels processed by each call, to compute the throughput
+ * \param f The kernel
+ * \param only Prefix of the selected kernels
+ * \param min_time Time in nanoseconds to spend in the measure
+ */
+static void Bench(const std::string &kernel,int param,int w,int h,Uint64 pixels,const std::function<void(void)> &f,
+                  const std::string &only,Uint64 min_time)
+{
+ if (kernel.compare(0,only.size(),only)!=0)
+  return;
+
+ Uint64 runs;
+ double ns=Measure(f,min_time,runs);
+ char line[256];
+ snprintf(line,sizeof(line),"{\"kernel\":\"%s\",\"param\":%d,\"width\":%d,\"height\":%d,\"runs\":%llu,\"ns_per_op\":%.1f,\"pixels_per_op\":%llu,\"mpixels_per_s\":%.2f}",
+          kernel.c_str(),param,w,h,(unsigned long long)runs,ns,(unsigned long long)pixels,(ns>0.0) ? double(pixels)*1000.0/ns : 0.0);
+ std::cout << line << std::endl;
+}
+
+/**
+ * Runs all the benchmarks at one resolution
+ * \param w Horizontal resolution
+ * \param h Vertical resolution
+ * \param deck The PDF file whose pages are rendered
+ * \param only Prefix of the selected kernels
+ * \param min_time Time in nanoseconds to spend in the measure of each kernel
+ */
+static void BenchResolution(int w,int h,const std::string &deck,const std::string &only,Uint64 min_time)
+{
+ Config cfg(w,h);
+ Canvas *cnv=new Canvas(cfg);
+ int area_h=h-cfg.GetMenuHeight();
+ Uint64 area=Uint64(w)*Uint64(area_h);
+
+ // The slides are rendered in the calling thread only. Rendering in advance, submitted by the constructor, is cancelled at once.
+ Scheduler sched(1);
+ PDFSlides *sld=new PDFSlides(cfg,deck,sched);
+ sld->CancelJobs();
+ sched.Stop();
+
+ int pages=sld->GetNumPages();
+ if (pages>0)
+ {
+  SDL_Surface *s=sld->RenderPage(0);
+  Uint64 page_pixels=Uint64(s->w)*Uint64(s->h);
+  SDL_FreeSurface(s);
+  int page=0;
+  Bench("render",pages,w,h,page_pixels,[&]()
+  {
+   SDL_FreeSurface(sld->RenderPage(page));
+   page=(page+1)%pages;
+  },only,min_time);
+ }
+
+ poppler::image img(w,area_h,poppler::image::format_argb32);
+ Uint32 *px=(Uint32 *)img.data();
+ for (Uint64 i=0;i<area;i++)
+  px[i]=0xFF000000 | Uint32(i*2654435761U>>8);
+ Bench("convert",0,w,h,area,[&]()
+ {
+  SDL_FreeSurface(PDFSlides::ImageToSurface(img));
+ },only,min_time);
+
+ // Traces over a part of the area, so that the merge finds both kinds of pixels
+ cnv->Erase(Canvas::Both);
+ cnv->SetCoords(0,cfg.GetMenuHeight()+1);
+ for (int x=16;x<w;x+=16)
+  cnv->Drawline(x,(x/16)%2 ? h-2 : cfg.GetMenuHeight()+1);
+ Bench("merge",0,w,h,area,[&]()
+ {
+  cnv->Merge();
+ },only,min_time);
+
+ // Highlights over about half of the area, blended with each kind of kernel
+ {
+  SDL_Surface *c=cnv->GetPresenter()->GetSurface();
+  SDL_Surface *slide=SDL_ConvertSurface(c,c->format,SDL_SWSURFACE);
+  SDL_Color col={ 0xFF,0xE0,0x00,0x00 };
+  HighlightLayer hl(c->format,w,h,col);
+  for (int y=cfg.GetMenuHeight();y<h;y+=2*HighlightLayer::TipSize)
+   hl.Line(0,y,w,y+HighlightLayer::TipSize/2,HighlightLayer::TipSize,0,true);
+  SDL_Rect r;
+  r.x=0;
+  r.y=cfg.GetMenuHeight();
+  r.w=w;
+  r.h=area_h;
+  for (int v=(HighlightLayer::HasVectorized()) ? 1 : 0;v>=0;v--)
+  {
+   HighlightLayer::SetVectorized(v==1);
+   Bench("highlight",v,w,h,area,[&]()
+   {
+    hl.Compose(c,slide,r);
+   },only,min_time);
+  }
+  HighlightLayer::SetVectorized(true);
+  SDL_FreeSurface(slide);
+ }
+
+ // Each call draws a segment of dx pixels, going and coming back between the same two points
+ int dx=w/2,dy=area_h/3;
+ int xa=w/4,ya=cfg.GetMenuHeight()+area_h/3;
+ for (int lw=1;lw<=Canvas::MaxLWidth;lw++)
+ {
+  cnv->SetLineWidth(lw);
+  cnv->SetCoords(xa,ya);
+  bool back=false;
+  Bench("drawline",lw,w,h,Uint64(dx)*Uint64(lw)*Uint64(lw),[&]()
+  {
+   if (back)
+    cnv->Drawline(xa,ya);
+   else
+    cnv->Drawline(xa+dx,ya+dy);
+   back=!back;
+  },only,min_time);
+ }
+
+ // The same segments, antialiased, with the blending of the area they touch
+ {
+  SDL_Surface *c=cnv->GetPresenter()->GetSurface();
+  InkCoverage aa(c->format,w,h);
+  Uint32 black=SDL_MapRGB(c->format,0,0,0);
+  for (int lw=1;lw<=Canvas::MaxLWidth;lw++)
+  {
+   SDL_Rect r;
+   r.x=xa-lw;
+   r.y=ya-lw;
+   r.w=dx+2*lw+2;
+   r.h=dy+2*lw+2;
+   Bench("aaline",lw,w,h,Uint64(dx)*Uint64(lw)*Uint64(lw),[&]()
+   {
+    aa.Line(cnv->GetInk(),cnv->GetInkBackground(),xa,ya,xa+dx,ya+dy,lw,lw/2,black);
+    aa.Compose(c,cnv->GetInk(),cnv->GetInkBackground(),r);
+   },only,min_time);
+  }
+ }
+
+ // Slide and traces are erased
+ Bench("erase",0,w,h,2*area,[&]()
+ {
+  cnv->Erase(Canvas::Both);
+ },only,min_time);
+
+ Bench("writepnm",0,w,h,area,[&]()
+ {
+  cnv->WriteImage("/dev/null");
+ },only,min_time);
+
+ delete sld;
+ cnv->EndSDL();
+ delete cnv;
+}
+
+/**
+ * An image as RGB bytes, the form in which the results of the kernels are compared whatever the pixel format they were drawn in
+ */
+struct Image
+{
+ int w,h;
+ std::vector<unsigned char> rgb;
+};
+
+/**
+ * The result of comparing two images
+ */
+struct Diff
+{
+ int max;          // Largest difference in any component of any pixel (256 if the images have different sizes)
+ Uint64 count;     // Number of pixels that differ in something
+};
+
+/**
+ * A kernel of the program, to be compared with its reference implementation. Faster variants of a kernel (vectorized, threaded...)
+ * are added to Kernels as new entries with the same reference.
+ */
+struct KernelCheck
+{
+ const char *name;
+ int tolerance;
+ int format_steps;  // Times the error of the pixel format (FormatTolerance) added to the tolerance, for references computed in RGB
+ std::function<Image(Canvas &)> variant;
+ std::function<Image(Canvas &)> reference;
+};
+
+/**
+ * Reads an image in binary pnm format (P6, with 255 as maximum value)
+ * \param f The stream
+ * \param img The image, returned by reference
+ * \return true if the image has been read, false if the stream does not have such an image
+ */
+static bool ReadPnm(std::istream &f,Image &img)
+{
+ std::string magic;
+ int maxval;
+ if (!(f >> magic >> img.w >> img.h >> maxval) || (magic!="P6") || (maxval!=255) || (img.w<=0) || (img.h<=0))
+  return false;
+ f.get();
+ img.rgb.resize(size_t(img.w)*size_t(img.h)*3);
+ f.read(reinterpret_cast<char *>(&img.rgb[0]),img.rgb.size());
+ return bool(f);
+}
+
+/**
+ * Gets the colors of some rows of a surface, pixel by pixel with SDL_GetRGB
+ * \param s The surface
+ * \param y0 First row
+ * \param h Number of rows
+ * \return The image
+ */
+static Image SurfaceImage(SDL_Surface *s,int y0,int h)
+{
+ Image img;
+ img.w=s->w;
+ img.h=h;
+ img.rgb.resize(size_t(img.w)*size_t(img.h)*3);
+ int bpp=s->format->BytesPerPixel;
+ SDL_LockSurface(s);
+ unsigned char *q=&img.rgb[0];
+ for (int y=y0;y<y0+h;y++)
+ {
+  const Uint8 *p=(const Uint8 *)s->pixels+y*s->pitch;
+  for (int x=0;x<s->w;x++,p+=bpp,q+=3)
+  {
+   Uint32 v=0;
+   switch (bpp)
+   {
+    case 1: v=*p; break;
+    case 2: v=*(const Uint16 *)p; break;
+    case 3:
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+            v=(Uint32(p[0])<<16) | (Uint32(p[1])<<8) | Uint32(p[2]);
+#else
+            v=Uint32(p[0]) | (Uint32(p[1])<<8) | (Uint32(p[2])<<16);
+#endif
+            break;
+    default: v=*(const Uint32 *)p; break;
+   }
+   SDL_GetRGB(v,s->format,q,q+1,q+2);
+  }
+ }
+ SDL_UnlockSurface(s);
+ return img;
+}
+
+/**
+ * Gets the largest error that a pixel format can introduce in a color component
+ * \param fmt The pixel format
+ * \return The error: 0 for 8 bits per component, the step of the least significant bit kept otherwise, and that of blue (two bits) for the 3-3-2 palette
+ */
+static int FormatTolerance(SDL_PixelFormat *fmt)
+{
+ if (fmt->palette!=nullptr)
+  return 255/3;
+ int l=std::max(std::max(fmt->Rloss,fmt->Gloss),fmt->Bloss);
+ return (1<<l)-1;
+}
+
+/**
+ * Compares two images
+ * \param a One image
+ * \param b The other one
+ * \return The differences
+ */
+static Diff Compare(const Image &a,const Image &b)
+{
+ Diff d;
+ d.max=0;
+ d.count=0;
+ if ((a.w!=b.w) || (a.h!=b.h))
+ {
+  d.max=256;
+  d.count=Uint64(a.w)*Uint64(a.h);
+  return d;
+ }
+ for (size_t i=0;i<a.rgb.size();i+=3)
+ {
+  int m=0;
+  for (int k=0;k<3;k++)
+   m=std::max(m,abs(int(a.rgb[i+k])-int(b.rgb[i+k])));
+  if (m>0)
+   d.count++;
+  d.max=std::max(d.max,m);
+ }
+ return d;
+}
+
+/**
+ * Writes the result of a check, as a JSON object in a line
+ * \param check What is checked (a kernel, or golden for the comparison with the golden image)
+ * \param scenario What was drawn
+ * \param format Name of the pixel format
+ * \param d The differences found
+ * \param tol The tolerance
+ * \return true if the differences are within the tolerance
+ */
+static bool Report(const std::string &check,const std::string &scenario,const std::string &format,const Diff &d,int tol)
+{
+ bool pass=(d.max<=tol);
+ char line[256];
+ snprintf(line,sizeof(line),"{\"check\":\"%s\",\"scenario\":\"%s\",\"format\":\"%s\",\"max_diff\":%d,\"differing_pixels\":%llu,\"tolerance\":%d,\"result\":\"%s\"}",
+          check.c_str(),scenario.c_str(),format.c_str(),d.max,(unsigned long long)d.count,tol,pass ? "pass" : "FAIL");
+ std::cout << line << std::endl;
+ return pass;
+}
+
+/**
+ * Merges the traces onto a copy of the canvas, pixel by pixel. It is the reference of Canvas::Merge, including the rows it covers.
+ * \param dst The copy of the canvas
+ * \param ink The buffer of traces
+ * \param back The bytes of a background pixel of the buffer
+ * \param top Height of the menu
+ */
+static void ReferenceMerge(SDL_Surface *dst,SDL_Surface *ink,const unsigned char *back,int top)
+{
+ int bpp=ink->format->BytesPerPixel;
+ for (int y=top;y<ink->h;y++)
+  for (int x=0;x<ink->w;x++)
+  {
+   const Uint8 *p=(const Uint8 *)ink->pixels+y*ink->pitch+x*bpp;
+   if (memcmp(p,back,bpp)!=0)
+    memcpy((Uint8 *)dst->pixels+y*dst->pitch+x*bpp,p,bpp);
+  }
+}
+
+/**
+ * Blends highlights over a copy of the canvas, with strokes of several sizes and directions so that groups of pixels are cut anywhere
+ * \param cnv The canvas
+ * \param vectorized true to use the vectorized kernels (if there are), false for the scalar ones, which are their reference
+ * \return The image
+ */
+static Image HighlightImage(Canvas &cnv,bool vectorized)
+{
+ SDL_Surface *c=cnv.GetPresenter()->GetSurface();
+ SDL_Color col={ 0xFF,0xE0,0x00,0x00 };
+ HighlightLayer hl(c->format,c->w,c->h,col);
+ for (int k=0;k<16;k++)
+  hl.Line(k*c->w/16+k,0,c->w-1-k*c->w/32,c->h-1,HighlightLayer::TipSize+k,k,true);
+ hl.Line(0,c->h/2,c->w-1,c->h/2+3,HighlightLayer::TipSize,0,true);
+ hl.Line(c->w/3,0,c->w/3+5,c->h-1,3,1,false);
+ SDL_Surface *copy=SDL_ConvertSurface(c,c->format,SDL_SWSURFACE);
+ SDL_Rect r;
+ r.x=0;
+ r.y=0;
+ r.w=c->w;
+ r.h=c->h;
+ HighlightLayer::SetVectorized(vectorized);
+ hl.Compose(copy,c,r);
+ HighlightLayer::SetVectorized(true);
+ Image img=SurfaceImage(copy,0,copy->h);
+ SDL_FreeSurface(copy);
+ return img;
+}
+
+/**
+ * Draws antialiased lines of every width, in several directions, over a copy of the canvas, as the pen does with antialiasing
+ * \param cnv The canvas
+ * \param reference false to draw them with InkCoverage, true to compute the coverage of each pixel from its distance to the lines
+ *        and blend it in RGB, without the pixel format, which is the reference
+ * \return The image
+ */
+static Image AntialiasImage(Canvas &cnv,bool reference)
+{
+ SDL_Surface *c=cnv.GetPresenter()->GetSurface();
+ int w=c->w,h=c->h;
+ int bpp=c->format->BytesPerPixel;
+ const unsigned char *vback=cnv.GetInkBackground();
+ Uint32 color=SDL_MapRGB(c->format,0x20,0x40,0xC0);
+ if (memcmp(&color,vback,bpp)==0)
+  color=SDL_MapRGB(c->format,0xC0,0x20,0x20);
+
+ struct Segment
+ {
+  int xa,ya,xb,yb,size;
+ };
+ std::vector<Segment> segs;
+ const int n=Canvas::MaxLWidth;
+ for (int lw=1;lw<=n;lw++)
+ {
+  Segment flat={ 4,h/8+lw*h/(2*n),w-5,h/8+lw*h/(2*n)+lw,lw };
+  Segment steep={ lw*w/(n+2),h/10,lw*w/(n+2)+lw*3,h-5,lw };
+  Segment slant={ w-lw*w/(n+2),4,lw*w/(2*n+4),h-1-lw*2,lw };
+  segs.push_back(flat);
+  segs.push_back(steep);
+  segs.push_back(slant);
+ }
+ Segment dot={ w/2,h/2,w/2,h/2,n };
+ segs.push_back(dot);
+
+ if (!reference)
+ {
+  SDL_Surface *copy=SDL_ConvertSurface(c,c->format,SDL_SWSURFACE);
+  SDL_Surface *ink=SDL_ConvertSurface(c,c->format,SDL_SWSURFACE);
+  SDL_LockSurface(ink);
+  for (int y=0;y<h;y++)
+   for (int x=0;x<w;x++)
+    memcpy((Uint8 *)ink->pixels+y*ink->pitch+x*bpp,vback,bpp);
+  SDL_UnlockSurface(ink);
+  InkCoverage aa(c->format,w,h);
+  for (size_t i=0;i<segs.size();i++)
+   aa.Line(ink,vback,segs[i].xa,segs[i].ya,segs[i].xb,segs[i].yb,segs[i].size,segs[i].size/2,color);
+  SDL_Rect r;
+  r.x=0;
+  r.y=0;
+  r.w=w;
+  r.h=h;
+  aa.Compose(copy,ink,vback,r);
+  Image img=SurfaceImage(copy,0,h);
+  SDL_FreeSurface(ink);
+  SDL_FreeSurface(copy);
+  return img;
+ }
+
+ // Each pixel takes the largest coverage of the lines: that of its center, softened over one pixel
+ Image img=SurfaceImage(c,0,h);
+ Uint8 ink_rgb[3];
+ SDL_GetRGB(color,c->format,&ink_rgb[0],&ink_rgb[1],&ink_rgb[2]);
+ for (int y=0;y<h;y++)
+  for (int x=0;x<w;x++)
+  {
+   int cover=0;
+   for (size_t i=0;i<segs.size();i++)
+   {
+    double rad=segs[i].size/2.0;
+    double ax=segs[i].xa-segs[i].size/2+rad,ay=segs[i].ya-segs[i].size/2+rad;
+    double vx=segs[i].xb-segs[i].xa,vy=segs[i].yb-segs[i].ya;
+    double len2=vx*vx+vy*vy;
+    double px=x+0.5-ax,py=y+0.5-ay;
+    double t=(len2>0.0) ? std::min(std::max((px*vx+py*vy)/len2,0.0),1.0) : 0.0;
+    double a=rad+0.5-sqrt((px-t*vx)*(px-t*vx)+(py-t*vy)*(py-t*vy));
+    if (a>0.0)
+     cover=std::max(cover,(a>=1.0) ? 255 : int(a*255.0+0.5));
+   }
+   if (cover==0)
+    continue;
+   unsigned char *q=&img.rgb[(size_t(y)*size_t(w)+size_t(x))*3];
+   for (int k=0;k<3;k++)
+    q[k]=Uint8(floor((q[k]*(255.0-cover)+ink_rgb[k]*double(cover))/255.0+0.5));
+  }
+ return img;
+}
+
+/**
+ * Draws traces with every line width, and erases across them. If a trace is given, what it draws is drawn instead.
+ * \param cnv The canvas
+ * \param trace The events of a recorded trace, or nullptr
+ */
+static void DrawStrokes(Canvas &cnv,const std::vector<InputEvent> *trace)
+{
+ SDL_Surface *c=cnv.GetPresenter()->GetSurface();
+ int w=c->w,h=c->h;
+ int top=h/10;
+
+ if (trace!=nullptr)
+ {
+  bool pressed=false;
+  for (size_t i=0;i<trace->size();i++)
+  {
+   const SDL_Event &ev=(*trace)[i].event;
+   if ((ev.type==SDL_MOUSEBUTTONDOWN) && cnv.InsideCanvas(ev.button.y))
+   {
+    cnv.SetCoords(ev.button.x,ev.button.y);
+    pressed=true;
+   }
+   else if (ev.type==SDL_MOUSEBUTTONUP)
+    pressed=false;
+   else if ((ev.type==SDL_MOUSEMOTION) && pressed)
+    cnv.Drawline(ev.motion.x,ev.motion.y);
+  }
+  return;
+ }
+
+ // A zigzag per line width, with flat and steep segments in both directions
+ int band=(h-top)/(Canvas::MaxLWidth+2);
+ for (int lw=1;lw<=Canvas::MaxLWidth;lw++)
+ {
+  int y=top+lw*band;
+  cnv.SetLineWidth(lw);
+  cnv.SetCoords(2,y);
+  for (int k=1;k<=16;k++)
+   cnv.Drawline(2+k*(w-4)/16,(k%2) ? y+band-1 : ((k%4) ? y-band/2 : y));
+  cnv.Drawline(w/2,y+band/2);
+ }
+ cnv.ExecuteCommand(Config::DrawErase,nullptr);
+ cnv.SetCoords(w-1,top+1);
+ cnv.Drawline(0,h-1);
+ cnv.ExecuteCommand(Config::DrawErase,nullptr);
+}
+
+/**
+ * The kernels that are checked against their reference. The reference is always called first, on a copy of the canvas.
+ */
+static const KernelCheck Kernels[] =
+{
+ { "merge", 0, 0,
+   [](Canvas &cnv)
+   {
+    cnv.Merge();
+    SDL_Surface *c=cnv.GetPresenter()->GetSurface();
+    return SurfaceImage(c,0,c->h);
+   },
+   [](Canvas &cnv)
+   {
+    SDL_Surface *c=cnv.GetPresenter()->GetSurface();
+    SDL_Surface *copy=SDL_ConvertSurface(c,c->format,SDL_SWSURFACE);
+    ReferenceMerge(copy,cnv.GetInk(),cnv.GetInkBackground(),c->h-cnv.GetInk()->h);
+    Image img=SurfaceImage(copy,0,copy->h);
+    SDL_FreeSurface(copy);
+    return img;
+   } },
+ { "highlight", 0, 0,
+   [](Canvas &cnv)
+   {
+    return HighlightImage(cnv,true);
+   },
+   [](Canvas &cnv)
+   {
+    return HighlightImage(cnv,false);
+   } },
+ { "aaline", 1, 2,
+   [](Canvas &cnv)
+   {
+    return AntialiasImage(cnv,false);
+   },
+   [](Canvas &cnv)
+   {
+    return AntialiasImage(cnv,true);
+   } },
+ { "writepnm", 0, 0,
+   [](Canvas &cnv)
+   {
+    std::stringstream s;
+    cnv.WriteImage(s);
+    Image img;
+    if (!ReadPnm(s,img))
+     img.w=img.h=0;
+    return img;
+   },
+   [](Canvas &cnv)
+   {
+    SDL_Surface *c=cnv.GetPresenter()->GetSurface();
+    int top=c->h-cnv.GetInk()->h;
+    return SurfaceImage(c,top,c->h-top);
+   } }
+};
+
+/**
+ * Checks the conversion of poppler images against its reference, on a synthetic image
+ * \param w Width
+ * \param h Height
+ * \return true if the check passes
+ */
+static bool CheckConvert(int w,int h)
+{
+ poppler::image img(w,h,poppler::image::format_argb32);
+ Uint32 *px=(Uint32 *)img.data();
+ Image ref;
+ ref.w=w;
+ ref.h=h;
+ ref.rgb.resize(size_t(w)*size_t(h)*3);
+ for (int i=0;i<w*h;i++)
+ {
+  px[i]=0xFF000000 | Uint32(i*2654435761U>>8);
+  ref.rgb[3*i]=Uint8(px[i]>>16);
+  ref.rgb[3*i+1]=Uint8(px[i]>>8);
+  ref.rgb[3*i+2]=Uint8(px[i]);
+ }
+ SDL_Surface *s=PDFSlides::ImageToSurface(img);
+ Diff d=Compare(SurfaceImage(s,0,s->h),ref);
+ SDL_FreeSurface(s);
+ return Report("convert","synthetic","argb32",d,0);
+}
+
+/**
+ * Draws every scenario (the traces alone, and over each slide of the deck) in every pixel format. In each one, the kernels are
+ * compared with their reference, and the result with the golden image.
+ * \param w Horizontal resolution
+ * \param h Vertical resolution
+ * \param deck The PDF file with the slides
+ * \param trace The events of a recorded trace to draw, or nullptr to draw the synthetic traces
+ * \param golden Directory of the golden images
+ * \param update true to write the golden images (from the first format, 32 bits RGB) instead of checking against them
+ * \return true if all the checks pass
+ */
+static bool CheckAll(int w,int h,const std::string &deck,const std::vector<InputEvent> *trace,const std::string &golden,bool update)
+{
+ struct Format
+ {
+  const char *name;
+  int bpp;
+  bool bgr;
+ };
+ // The first one is the reference for the golden images
+ static const Format formats[] = { { "32rgb",32,false }, { "32bgr",32,true }, { "24rgb",24,false }, { "24bgr",24,true },
+                                   { "16rgb",16,false }, { "16bgr",16,true }, { "8pal",8,false } };
+
+ bool ok=CheckConvert(w,h);
+ char res[32];
+ snprintf(res,sizeof(res),"_%dx%d.pnm",w,h);
+
+ for (size_t f=0;f<sizeof(formats)/sizeof(Format);f++)
+ {
+  Config cfg(w,h,formats[f].bpp,formats[f].bgr);
+  Canvas *cnv=new Canvas(cfg);
+  Scheduler sched(1);
+  PDFSlides *sld=new PDFSlides(cfg,deck,sched);
+  sld->CancelJobs();
+  sched.Stop();
+  int tol=FormatTolerance(cnv->GetPresenter()->GetSurface()->format);
+
+  for (int p=-1;p<sld->GetNumPages();p++)
+  {
+   std::string scenario=(p<0) ? std::string("traces") : "page"+std::to_string(p+1);
+   cnv->Erase(Canvas::Both);
+   if (p>=0)
+   {
+    SDL_Surface *s=sld->RenderPage(p);
+    cnv->Show(s);
+    SDL_FreeSurface(s);
+   }
+   DrawStrokes(*cnv,trace);
+
+   for (size_t k=0;k<sizeof(Kernels)/sizeof(KernelCheck);k++)
+   {
+    Image ref=Kernels[k].reference(*cnv);
+    Image out=Kernels[k].variant(*cnv);
+    ok&=Report(Kernels[k].name,scenario,formats[f].name,Compare(out,ref),Kernels[k].tolerance+Kernels[k].format_steps*tol);
+   }
+
+   std::stringstream s;
+   cnv->WriteImage(s);
+   std::string gname=golden+scenario+res;
+   if (update && (f==0))
+   {
+    std::ofstream g(gname.c_str(),std::ios::binary);
+    g << s.str();
+    g.close();
+    if (g.fail())
+    {
+     std::cerr << "Cannot write the golden image " << gname << ".\n";
+     ok=false;
+    }
+    continue;
+   }
+   Image out,gold;
+   std::ifstream g(gname.c_str(),std::ios::binary);
+   if (!ReadPnm(g,gold))
+   {
+    std::cerr << "The golden image " << gname << " is missing or wrong. Record it with -u.\n";
+    gold.w=gold.h=0;
+   }
+   ReadPnm(s,out);
+   ok&=Report("golden",scenario,formats[f].name,Compare(out,gold),tol+((p>=0) ? RenderTolerance : 0));
+  }
+
+  delete sld;
+  cnv->EndSDL();
+  delete cnv;
+ }
+ return ok;
+}
+
+/**
+ * The main function of the benchmarks
+ * \param argc The number of arguments
+ * \param argv The arguments (see Usage)
+ * \return 0, or 1 if a check fails (a golden image that is missing fails too)
+ */
+int main(int argc,char *argv[])
+{
+ std::string deck=DefaultDeck;
+ std::string only;
+ int min_ms=DefaultMinTime;
+ std::vector< std::pair<int,int> > res;
+ std::string golden,trace_file;
+ bool update=false;
+
+ int opt;
+ while ((opt=getopt(argc,argv,"d:r:t:k:c:up:"))!=-1)
+ {
+  switch (opt)
+  {
+   case 'd': deck=optarg; break;
+   case 'r':
+   {
+    int w,h;
+    if ((sscanf(optarg,"%dx%d",&w,&h)!=2) || (w<=0) || (h<=0))
+     Usage(argv[0]);
+    res.push_back(std::make_pair(w,h));
+    break;
+   }
+   case 't': min_ms=atoi(optarg); break;
+   case 'k': only=optarg; break;
+   case 'c': golden=optarg; break;
+   case 'u': update=true; break;
+   case 'p': trace_file=optarg; break;
+   default: Usage(argv[0]); break;
+  }
+ }
+ if ((optind<argc) || (min_ms<=0) || (golden.empty() && (update || !trace_file.empty())))
+  Usage(argv[0]);
+ if (access(deck.c_str(),R_OK)!=0)
+ {
+  std::cerr << "The deck " << deck << " does not exist or is not readable. Exiting.\n";
+  exit(1);
+ }
+
+ if (!golden.empty())
+ {
+  if (golden.find_last_of('/')!=golden.size()-1)
+   golden+="/";
+  int w=(res.empty()) ? CheckXRes : res[0].first;
+  int h=(res.empty()) ? CheckYRes : res[0].second;
+  std::vector<InputEvent> events;
+  if (!trace_file.empty())
+   InputTrace::Load(trace_file,events,w,h);
+  return CheckAll(w,h,deck,trace_file.empty() ? nullptr : &events,golden,update) ? 0 : 1;
+ }
+
+ if (res.empty())
+ {
+  res.push_back(std::make_pair(1024,576));
+  res.push_back(std::make_pair(1920,1080));
+  res.push_back(std::make_pair(3840,2160));
+ }
+
+ for (size_t i=0;i<res.size();i++)
+  BenchResolution(res[i].first,res[i].second,deck,only,Uint64(min_ms)*1000000ULL);
+
+ return 0;
+}
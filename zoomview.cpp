@@ -0,0 +1,254 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#include "zoomview.h"
+
+ZoomView::ZoomView()
+{
+ level=0;
+ ox=oy=0;
+ slide.x=slide.y=0;
+ slide.w=slide.h=0;
+ vw=vh=0;
+ view=nullptr;
+ scaled=nullptr;
+ dragging=false;
+ drag_x=drag_y=0;
+}
+
+ZoomView::~ZoomView()
+{
+ if (view!=nullptr)
+  SDL_FreeSurface(view);
+ if (scaled!=nullptr)
+  SDL_FreeSurface(scaled);
+}
+
+bool ZoomView::ZoomIn(Canvas &cnv,PDFSlides &sld)
+{
+ if (level>=MaxLevel)
+  return false;
+ if (level==0)
+ {
+  SDL_Surface *s=sld.GetCurrentPageSurface();
+  if (s==nullptr)
+   return false;
+  SDL_Rect a=cnv.GetDrawingArea();
+  slide=cnv.SlideRect(s);
+  vw=a.w;
+  vh=a.h;
+  // At level 0, the view is the drawing area, with the slide where the canvas shows it
+  ox=a.x-slide.x;
+  oy=a.y-slide.y;
+ }
+ SetLevel(level+1,cnv,sld);
+ return true;
+}
+
+bool ZoomView::ZoomOut(Canvas &cnv,PDFSlides &sld)
+{
+ if (level==0)
+  return false;
+ if (level==1)
+ {
+  Close();
+  return true;
+ }
+ SetLevel(level-1,cnv,sld);
+ return true;
+}
+
+void ZoomView::SetLevel(int l,Canvas &cnv,PDFSlides &sld)
+{
+ int cx=ox+vw/2,cy=oy+vh/2;
+ if (l>level)
+ {
+  cx<<=(l-level);
+  cy<<=(l-level);
+ }
+ else
+ {
+  cx>>=(level-l);
+  cy>>=(level-l);
+ }
+ level=l;
+ ox=cx-vw/2;
+ oy=cy-vh/2;
+ Clamp();
+ Draw(cnv,sld);
+}
+
+void ZoomView::Clamp(void)
+{
+ int w=int(slide.w)<<level,h=int(slide.h)<<level;
+ ox=(w<=vw) ? -(vw-w)/2 : std::min(std::max(ox,0),w-vw);
+ oy=(h<=vh) ? -(vh-h)/2 : std::min(std::max(oy,0),h-vh);
+}
+
+void ZoomView::Pan(int dx,int dy,Canvas &cnv,PDFSlides &sld)
+{
+ if (!Active())
+  return;
+ int fx=ox,fy=oy;
+ ox+=dx;
+ oy+=dy;
+ Clamp();
+ if ((ox!=fx) || (oy!=fy))
+  Draw(cnv,sld);
+}
+
+void ZoomView::DragTo(int x,int y,Canvas &cnv,PDFSlides &sld)
+{
+ if (!dragging)
+  return;
+ Pan(drag_x-x,drag_y-y,cnv,sld);
+ drag_x=x;
+ drag_y=y;
+}
+
+void ZoomView::Draw(Canvas &cnv,PDFSlides &sld)
+{
+ SDL_Surface *ink=cnv.GetInk();
+ SDL_PixelFormat *fmt=ink->format;
+ if (view==nullptr)
+ {
+  view=SDL_CreateRGBSurface(SDL_SWSURFACE,vw,vh,fmt->BitsPerPixel,fmt->Rmask,fmt->Gmask,fmt->Bmask,fmt->Amask);
+  if (view==nullptr)
+  {
+   std::cerr << "Error creating the SDL surface of the zoomed view. Exiting.\n";
+   SDL_Quit();
+   exit(1);
+  }
+  if (fmt->palette!=nullptr)
+   SDL_SetPalette(view,SDL_LOGPAL,fmt->palette->colors,0,fmt->palette->ncolors);
+ }
+ SDL_FillRect(view,nullptr,SDL_MapRGB(fmt,0xFF,0xFF,0xFF));
+
+ // The tiles that are seen, and only them. Those that are being rendered are replaced by the slide scaled up.
+ const int ts=PDFSlides::ZoomTileSize;
+ SDL_Surface *page=sld.GetCurrentPageSurface();
+ int zw=int(slide.w)<<level,zh=int(slide.h)<<level;
+ for (int ty=std::max(oy,0)/ts;(ty*ts<oy+vh) && (ty*ts<zh);ty++)
+  for (int tx=std::max(ox,0)/ts;(tx*ts<ox+vw) && (tx*ts<zw);tx++)
+  {
+   SDL_Rect d;
+   d.x=Sint16(tx*ts-ox);
+   d.y=Sint16(ty*ts-oy);
+   SDL_Surface *t=sld.GetZoomTile(level,tx,ty);
+   if (t!=nullptr)
+    SDL_BlitSurface(t,nullptr,view,&d);
+   else if (page!=nullptr)
+    Placeholder(page,tx,ty,d);
+  }
+
+ // Each pixel of the view takes the highlight and the trace of the point of the slide below it. The columns of the buffer are the
+ // same for every row.
+ HighlightLayer *hl=cnv.GetHighlights();
+ const Uint8 *mask=((hl!=nullptr) && !hl->Empty()) ? hl->GetMask() : nullptr;
+ std::vector<Uint8> cover((mask!=nullptr) ? vw : 0);
+ const unsigned char *vback=cnv.GetInkBackground();
+ int bpp=fmt->BytesPerPixel;
+ SDL_Rect a=cnv.GetDrawingArea();
+ std::vector<int> cols(vw,-1);
+ for (int x=0;x<vw;x++)
+ {
+  int px=(ox+x)>>level;
+  if ((px>=0) && (px<slide.w) && (slide.x+px<ink->w))
+   cols[x]=slide.x+px;
+ }
+ SDL_LockSurface(view);
+ SDL_LockSurface(ink);
+ for (int y=0;y<vh;y++)
+ {
+  int py=(oy+y)>>level;
+  int iy=slide.y+py;
+  if ((py<0) || (py>=slide.h) || (iy<a.y) || (iy>=ink->h))
+   continue;
+  const unsigned char *src=(const unsigned char *)ink->pixels+iy*ink->pitch;
+  unsigned char *dst=(unsigned char *)view->pixels+y*view->pitch;
+  if (mask!=nullptr)
+  {
+   // The mask has the coordinates of the screen, like the buffer of traces
+   const Uint8 *m=mask+size_t(iy)*size_t(ink->w);
+   for (int x=0;x<vw;x++)
+    cover[x]=(cols[x]<0) ? 0 : m[cols[x]];
+   hl->BlendInPlace(dst,&cover[0],vw);
+  }
+  for (int x=0;x<vw;x++)
+  {
+   if (cols[x]<0)
+    continue;
+   const unsigned char *p=src+cols[x]*bpp;
+   if (memcmp(p,vback,bpp)!=0)
+    memcpy(dst+x*bpp,p,bpp);
+  }
+ }
+ SDL_UnlockSurface(ink);
+ SDL_UnlockSurface(view);
+
+ cnv.ShowView(view);
+}
+
+void ZoomView::Placeholder(SDL_Surface *page,int tx,int ty,SDL_Rect d)
+{
+ const int ts=PDFSlides::ZoomTileSize;
+ SDL_PixelFormat *fmt=page->format;
+ if ((scaled!=nullptr) && (scaled->format->BitsPerPixel!=fmt->BitsPerPixel))
+ {
+  SDL_FreeSurface(scaled);
+  scaled=nullptr;
+ }
+ if (scaled==nullptr)
+ {
+  scaled=SDL_CreateRGBSurface(SDL_SWSURFACE,ts,ts,fmt->BitsPerPixel,fmt->Rmask,fmt->Gmask,fmt->Bmask,fmt->Amask);
+  if (scaled==nullptr)
+  {
+   std::cerr << "Error creating the SDL surface of the zoomed view. Exiting.\n";
+   SDL_Quit();
+   exit(1);
+  }
+ }
+
+ // Each pixel takes that of the point of the slide below it (the page is as large as the slide where it is shown)
+ int x0=tx*ts,y0=ty*ts;
+ int w=std::min(ts,(page->w<<level)-x0),h=std::min(ts,(page->h<<level)-y0);
+ if ((w<=0) || (h<=0))
+  return;
+ int bpp=fmt->BytesPerPixel;
+ SDL_LockSurface(page);
+ SDL_LockSurface(scaled);
+ for (int y=0;y<h;y++)
+ {
+  const unsigned char *src=(const unsigned char *)page->pixels+((y0+y)>>level)*page->pitch;
+  unsigned char *dst=(unsigned char *)scaled->pixels+y*scaled->pitch;
+  for (int x=0;x<w;x++)
+   memcpy(dst+x*bpp,src+((x0+x)>>level)*bpp,bpp);
+ }
+ SDL_UnlockSurface(scaled);
+ SDL_UnlockSurface(page);
+
+ SDL_Rect r;
+ r.x=r.y=0;
+ r.w=Uint16(w);
+ r.h=Uint16(h);
+ SDL_BlitSurface(scaled,&r,view,&d);
+}
+
+Uint64 ZoomView::MemoryUse(void)
+{
+ return (view!=nullptr) ? Uint64(view->pitch)*Uint64(view->h) : 0;
+}
@@ -0,0 +1,153 @@
+/***************************************************************************
+ *   Copyright (C) 2020 by Juan Domingo Esteve                             *
+ *   Juan.Domingo@uv.es                                                    *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 3 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, see <https://www.gnu.org/licenses/>. *
+ ***************************************************************************/
+#ifndef ZOOMVIEW_H
+#define ZOOMVIEW_H
+
+#include "canvas.h"
+#include "pdfslides.h"
+
+/*! \brief Class to show a part of the current slide zoomed in, and to move it
+ *
+ * The view is composed with the tiles of the zoomed page, which PDFSlides renders (only those that are seen) and keeps
+ * in its cache, so moving the view or going back to a former level renders only what has not been seen before. The tiles
+ * are rendered by the workers: until one arrives, its area is the slide as it is shown, scaled up, and the view is drawn
+ * again when it is there (Refresh).
+ *
+ * The traces are not zoomed: they stay in the buffer of the canvas, in the coordinates of the slide shown whole, and each
+ * pixel of the view takes the trace (if any) of the point of the slide below it. So they are always over what they were
+ * drawn on, at any level, and they are the same when the whole slide is shown again. The highlights are taken in the same
+ * way, and blended under the traces. The pen does not draw on the zoomed view.
+*/
+class ZoomView
+{
+ public:
+    /**
+     * Maximum zoom level: the slide is zoomed up to 2^MaxLevel times
+     */
+    static const int MaxLevel = 3;
+
+    /**
+     * Constructor. The whole slide is shown (level 0).
+     */
+    ZoomView();
+
+    /**
+     * Destructor. It frees the surface of the view.
+     */
+    ~ZoomView();
+
+    /**
+     * Tells if a slide is zoomed
+     * \return true if the zoom level is 1 or more
+     */
+    bool Active(void) { return (level>0); };
+
+    /**
+     * Zooms into the current slide, doubling the level, keeping the center of the view where it is
+     * \param cnv The canvas, where the view is shown
+     * \param sld The slides, which render the tiles
+     * \return true if the level has changed, false if there is no slide or the level was already the maximum
+     */
+    bool ZoomIn(Canvas &cnv,PDFSlides &sld);
+
+    /**
+     * Zooms out, halving the level, keeping the center of the view where it is
+     * \param cnv The canvas, where the view is shown
+     * \param sld The slides, which render the tiles
+     * \return true if the level has changed. If it is now 0, the view is not shown and the slide must be shown again.
+     */
+    bool ZoomOut(Canvas &cnv,PDFSlides &sld);
+
+    /**
+     * Goes back to the whole slide. The view is not shown any longer, so the slide must be shown again.
+     */
+    void Close(void) { level=0; dragging=false; };
+
+    /**
+     * Moves the view over the zoomed slide, which never leaves the screen more than needed
+     * \param dx Pixels to the right (negative to the left)
+     * \param dy Pixels down (negative up)
+     * \param cnv The canvas, where the view is shown
+     * \param sld The slides, which render the tiles
+     */
+    void Pan(int dx,int dy,Canvas &cnv,PDFSlides &sld);
+
+    /**
+     * Starts dragging the zoomed slide with the mouse
+     * \param x Value of coordinate x of the mouse
+     * \param y Value of coordinate y of the mouse
+     */
+    void StartDrag(int x,int y) { if (Active()) { dragging=true; drag_x=x; drag_y=y; } };
+
+    /**
+     * Drags the zoomed slide, so that the point under the mouse when dragging started follows it
+     * \param x Value of coordinate x of the mouse
+     * \param y Value of coordinate y of the mouse
+     * \param cnv The canvas, where the view is shown
+     * \param sld The slides, which render the tiles
+     */
+    void DragTo(int x,int y,Canvas &cnv,PDFSlides &sld);
+
+    /**
+     * Stops dragging the zoomed slide
+     */
+    void EndDrag(void) { dragging=false; };
+
+    /**
+     * Tells if the zoomed slide is being dragged
+     * \return true if it is
+     */
+    bool GetDragging(void) { return dragging; };
+
+    /**
+     * Draws the view again, if a slide is zoomed (when tiles that were missing have arrived)
+     * \param cnv The canvas, where the view is shown
+     * \param sld The slides, which keep the tiles
+     */
+    void Refresh(Canvas &cnv,PDFSlides &sld) { if (Active()) Draw(cnv,sld); };
+
+    /**
+     * Gets the memory used by the view (the tiles are in the cache of the slides)
+     * \return Bytes
+     */
+    Uint64 MemoryUse(void);
+
+ private:
+    // Changes the level keeping the point at the center of the view, and shows the view
+    void SetLevel(int l,Canvas &cnv,PDFSlides &sld);
+    // Keeps the view over the zoomed slide, centering the slide if it is smaller than the view
+    void Clamp(void);
+    // Composes the view with the tiles, the highlights and the traces, and shows it
+    void Draw(Canvas &cnv,PDFSlides &sld);
+    // Puts in the view the area of a tile that has not arrived yet, scaling up the slide as it is shown
+    void Placeholder(SDL_Surface *page,int tx,int ty,SDL_Rect d);
+
+    int level;
+    // Upper-left corner of the view, in pixels of the zoomed slide
+    int ox,oy;
+    // Where the slide is shown whole, and the size of the view
+    SDL_Rect slide;
+    int vw,vh;
+    SDL_Surface *view;
+    // Where the areas of the missing tiles are scaled up, in the format of the slides
+    SDL_Surface *scaled;
+    bool dragging;
+    int drag_x,drag_y;
+};
+
+#endif